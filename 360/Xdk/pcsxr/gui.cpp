@@ -196,6 +196,7 @@ protected:
 				ShowMessageBoxEx(NULL,NULL,msgtype,xboxConfig.Infomsg, 1, (LPCWSTR*)L"OK",NULL,  XUI_MB_CENTER_ON_PARENT, NULL);
 				//bHandled = TRUE;
 				//return xex
+				 McdShutdown();
 				 XLaunchNewImage ("", NULL);
 			}
 			
@@ -329,6 +330,7 @@ protected:
 
 	    if (hObjPressed == ExitBtn) {
 
+            McdShutdown();	// pending saves go to the card first
             XLaunchNewImage ("", NULL);
 
 		}
@@ -496,7 +498,9 @@ protected:
 		RegionList.SetCurSelVisible(xboxConfig.region);
 
 		xuiGameImg.SetImagePath(&xboxConfig.CoverPath[0]);
-		
+
+		// the console may be switched off from here
+		McdFlush();
 
 		return S_OK;
 	}
@@ -802,7 +806,11 @@ protected:
 	{
 		if( pGetSourceTextData->bItemData && pGetSourceTextData->iItem >= 0 )
 		{
-			pGetSourceTextData->szText = fileBrowser->At(pGetSourceTextData->iItem);
+			// coluna 1: ID e região do cache de discos (vazio se a imagem nunca foi aberta)
+			if( pGetSourceTextData->iData == 1 )
+				pGetSourceTextData->szText = fileBrowser->GameInfo(pGetSourceTextData->iItem);
+			else
+				pGetSourceTextData->szText = fileBrowser->At(pGetSourceTextData->iItem);
 			bHandled = TRUE;
 		}
 		return S_OK;
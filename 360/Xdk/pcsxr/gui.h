@@ -33,6 +33,8 @@ extern void ApplySettings(const char* path);
 
 
 extern "C" void RemoveSound();
+extern "C" int  SoundGetClock(unsigned long * pulSamples);
+extern "C" int  SoundGetStats(unsigned long * pulFill, unsigned long * pulUnderruns, unsigned long * pulDropped);
 extern "C" boolean use_vm;
 
 extern void SaveStatePcsx(int n);
@@ -52,9 +54,12 @@ extern bool     linearfilter;
 extern "C" int  UseFrameLimit;
 extern "C" int  darkforcesfix;
 extern "C" BOOL spuirq;
+extern "C" BOOL sputhread;
 
 
 extern "C" void gpuDmaThreadInit();
+extern "C" void McdFlush();
+extern "C" void McdShutdown();
 extern "C" void POKOPOM_Init();
 
 
@@ -85,6 +90,10 @@ public:
 	bool UseInterpreter;  // 0 = Dynarec (padrão), 1 = Interpreter (Legacy)
 	bool DisableSpuIrq;  // 0 = SPU IRQ ON (default/mais compatível), 1 = SPU IRQ OFF
 	bool UseThreadedGpu;
+	bool UseThreadedSpu;  // 1 = SPU na thread com fila de comandos, 0 = thread própria do plugin (padrão)
+	int  CdReadAhead;     // setores lidos à frente da imagem pela thread de i/o (0 = desligado)
+	int  CdFastLoad;      // divisor dos tempos do cd fora de streaming XA/CDDA (1 = desligado)
+	bool UseBootCache;    // snapshot do boot por jogo/BIOS, pula o loader da BIOS nos boots seguintes
 	bool DisableFrameLimiter;
 	bool DisableFrameSkip;
 	bool UseParasiteEveFix;
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <iostream>
 #include "misc.h"
+#include "discinfo.h"
 
 class FileBrowserProvider {
 protected:
@@ -17,6 +18,7 @@ protected:
 		std::wstring filename;
 		std::wstring displayname;
 		std::wstring gamecover;
+		std::wstring gameinfo;
 		bool isDir;
 		
 	};
@@ -65,6 +67,26 @@ public:
 
 
 
+	// ID e região do cache de discos (discinfo.c), só imagens já abertas uma vez;
+	// o tamanho e a data vêm da listagem, a imagem não é aberta
+	void SetGameInfo(_FILE_INFO &finfo, const WIN32_FIND_DATA &ffd) {
+		std::string path;
+		DiscStamp st;
+		const DiscInfo *di;
+
+		get_string(finfo.filename, path);
+		st.sizeLo = ffd.nFileSizeLow;
+		st.sizeHi = ffd.nFileSizeHigh;
+		st.timeLo = ffd.ftLastWriteTime.dwLowDateTime;
+		st.timeHi = ffd.ftLastWriteTime.dwHighDateTime;
+
+		di = DiscInfoPeek(path.c_str(), &st);
+		if (di != NULL && (di->flags & DISCINFO_BOOT)) {
+			std::string info = std::string(di->id) + (di->pal ? "  PAL" : "  NTSC");
+			get_wstring(info, finfo.gameinfo);
+		}
+	}
+
 	void AddParentEntry(std::wstring currentDir) {
 		_FILE_INFO finfo;
 		wchar_t lastLetter = currentDir[currentDir.length() - 1];
@@ -189,6 +211,7 @@ public:
 				else
 				finfo.gamecover = L"file://game:/media/PsxSkin.xzp#media\\psx.png";
 
+				SetGameInfo(finfo, ffd);
 			}
 
 
@@ -291,6 +314,7 @@ public:
 				else
 				finfo.gamecover = L"file://game:/media/PsxSkin.xzp#media\\psx.png";
 
+				SetGameInfo(finfo, ffd);
 			}
 
 
@@ -363,6 +387,14 @@ public:
 		}
 	}
 
+	LPCWSTR GameInfo(unsigned int i) {
+		if (i >= 0 && i < Size()) {
+			return this->fileList[i].gameinfo.c_str();
+		} else {
+			return L"";
+		}
+	}
+
 	LPCWSTR Filename(unsigned int i) {
 		if (i >= 0 && i < Size()) {
 			return this->fileList[i].filename.c_str();
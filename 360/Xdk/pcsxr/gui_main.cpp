@@ -4,9 +4,12 @@
 #include <stdarg.h>
 #include "psxcommon.h"
 #include "cdriso.h"
+#include "discinfo.h"
+#include "bootcache.h"
 #include "cdrom.h"
 #include "r3000a.h"
 #include "gpu.h"
+#include "spu.h"
 #include "../../../libpcsxcore/misc.h"
 #include "../../../libpcsxcore/cdrom.h"
 #include "sys\Mount.h"
@@ -20,6 +23,8 @@
 extern "C" {
 #include "../../../plugins/xbox_soft/fps.h"
 }
+#include "../../../plugins/xbox_soft/gpucap.h"
+#include "../../../plugins/dfsound/spucap.h"
 
 std::string gameprofile;
 
@@ -80,6 +85,42 @@ DWORD * InGameThread() {
 			Sleep(200); // Debounce
 		}
 
+		// Captura do stream da GPU: LB + RB + LEFT_THUMB (L3)
+		// Grava em game:\gpucaps\<id>_<n>.gpc, reproduzir com tools/gpureplay
+		if (InputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_SHOULDER && 
+			InputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_SHOULDER &&
+			InputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_THUMB) {
+			if (GPUcaptureActive()) {
+				OutputDebugStringA("GPU capture stop");
+				GPUcaptureStop();
+			} else {
+				static int capture_num = 0;
+				char capture_path[MAX_PATH];
+				sprintf(capture_path, "game:\\gpucaps\\%s_%03d.gpc", CdromId[0] ? CdromId : "unknown", capture_num++);
+				OutputDebugStringA("GPU capture start");
+				GPUcaptureStart(capture_path);
+			}
+			Sleep(500); // Debounce
+		}
+
+		// Captura do stream da SPU: LB + RB + RIGHT_THUMB (R3)
+		// Grava em game:\spucaps\<id>_<n>.spc, renderizar com tools/spubench
+		if (InputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_SHOULDER && 
+			InputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_SHOULDER &&
+			InputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_THUMB) {
+			if (SPUcaptureActive()) {
+				OutputDebugStringA("SPU capture stop");
+				SPUcaptureStop();
+			} else {
+				static int spu_capture_num = 0;
+				char capture_path[MAX_PATH];
+				sprintf(capture_path, "game:\\spucaps\\%s_%03d.spc", CdromId[0] ? CdromId : "unknown", spu_capture_num++);
+				OutputDebugStringA("SPU capture start");
+				SPUcaptureStart(capture_path);
+			}
+			Sleep(500); // Debounce
+		}
+
 		Sleep(50);
 	}
 	return NULL;
@@ -276,6 +317,10 @@ void SaveGameProfile(void) {
 	fprintf(fp, "# Game ID: %s\n", game_id);
 	fprintf(fp, "UseInterpreter=%d\n", xboxConfig.UseInterpreter);
 	fprintf(fp, "UseThreadedGpu=%d\n", xboxConfig.UseThreadedGpu);
+	fprintf(fp, "UseThreadedSpu=%d\n", xboxConfig.UseThreadedSpu);
+	fprintf(fp, "CdReadAhead=%d\n", xboxConfig.CdReadAhead);
+	fprintf(fp, "CdFastLoad=%d\n", xboxConfig.CdFastLoad);
+	fprintf(fp, "UseBootCache=%d\n", xboxConfig.UseBootCache);
 	fprintf(fp, "DisableSpuIrq=%d\n", xboxConfig.DisableSpuIrq);
 	fprintf(fp, "DisableFrameLimiter=%d\n", xboxConfig.DisableFrameLimiter);
 	fprintf(fp, "DisableFrameSkip=%d\n", xboxConfig.DisableFrameSkip);
@@ -329,6 +374,10 @@ void LoadGameProfile(void) {
 		// Compatibilidade com arquivos antigos (UseDynarec)
 		else if (strcmp(key, "UseDynarec") == 0) xboxConfig.UseInterpreter = !atoi(value);  // Invertido: UseDynarec=1 -> UseInterpreter=0
 		else if (strcmp(key, "UseThreadedGpu") == 0) xboxConfig.UseThreadedGpu = atoi(value);
+		else if (strcmp(key, "UseThreadedSpu") == 0) xboxConfig.UseThreadedSpu = atoi(value);
+		else if (strcmp(key, "CdReadAhead") == 0) xboxConfig.CdReadAhead = atoi(value);
+		else if (strcmp(key, "CdFastLoad") == 0) xboxConfig.CdFastLoad = atoi(value);
+		else if (strcmp(key, "UseBootCache") == 0) xboxConfig.UseBootCache = atoi(value);
 		else if (strcmp(key, "DisableSpuIrq") == 0) xboxConfig.DisableSpuIrq = atoi(value);
 		else if (strcmp(key, "DisableFrameLimiter") == 0) xboxConfig.DisableFrameLimiter = atoi(value);
 		else if (strcmp(key, "DisableFrameSkip") == 0) xboxConfig.DisableFrameSkip = atoi(value);
@@ -350,6 +399,10 @@ void ApplySettings(const char* path) {
 	Config.Cpu        = xboxConfig.UseInterpreter ? CPU_INTERPRETER : CPU_DYNAREC;  // 0 = Dynarec (padrão), 1 = Interpreter
 	Config.RCntFix    = xboxConfig.UseParasiteEveFix;
 	spuirq            = !xboxConfig.DisableSpuIrq;  // Invert: Disable=0 -> spuirq=1 (ON), Disable=1 -> spuirq=0 (OFF)
+	sputhread         = xboxConfig.UseThreadedSpu;  // SPU na thread da fila (SPUasync), senão a thread própria do plugin
+	cdrIsoSetReadAhead(xboxConfig.CdReadAhead);     // janela do read-ahead da imagem (setores)
+	Config.CdFastLoad = (xboxConfig.CdFastLoad > 1 && xboxConfig.CdFastLoad <= 16) ? xboxConfig.CdFastLoad : 1; // divisor dos tempos de seek/leitura fora de streaming
+	BootCacheInit(xboxConfig.UseBootCache ? "game:\\bootcache\\" : NULL); // só vale no fast boot (sem HLE e sem slow boot)
 	
 	// Frame Limiter: Invertido - unchecked = ativo (padrão), checked = desativado
 	DebugLog("[ApplySettings] DisableFrameLimiter=%d, DisableFrameSkip=%d", xboxConfig.DisableFrameLimiter, xboxConfig.DisableFrameSkip);
@@ -371,6 +424,7 @@ void ApplySettings(const char* path) {
 		DebugLog("[ApplySettings] FrameSkip DESATIVADO");
 	} else {
 		UseFrameSkip = 0;
+		s_adaptive_skip_enabled = 1;   // Frame skip preditivo (fps.c AutoFrameSkip)
 		DebugLog("[ApplySettings] FrameSkip ATIVO/Adaptativo");
 	}
 	
@@ -396,6 +450,10 @@ void LoadSettings() {
 	// Inicializar com valores padrão primeiro
 	xboxConfig.UseInterpreter = 0;       // 0 = Dynarec (padrão), 1 = Interpreter
 	xboxConfig.UseThreadedGpu = 0;       // Threaded GPU desativado
+	xboxConfig.UseThreadedSpu = 0;       // SPU na thread com fila de comandos desativada
+	xboxConfig.CdReadAhead = 64;         // 64 setores (~0.4 s em velocidade dupla) lidos à frente
+	xboxConfig.CdFastLoad = 1;           // 1 = tempos reais do drive, 2..16 = loading mais rápido (sem XA/CDDA)
+	xboxConfig.UseBootCache = 0;         // Boot cache desativado
 	xboxConfig.DisableSpuIrq = 0;        // 0 = SPU IRQ ON (padrão/mais compatível), 1 = SPU IRQ OFF
 	xboxConfig.DisableFrameLimiter = 0;  // Frame limiter ATIVO (0 = não desativa)
 	xboxConfig.DisableFrameSkip = 0;     // Frame skip ATIVO (0 = não desativa)
@@ -482,11 +540,17 @@ void InitPcsx() {
 	CreateDirectory("game:\\gameprofile\\",          NULL);
 	CreateDirectory("game:\\covers\\",               NULL);
 	CreateDirectory("game:\\gameguides\\",           NULL);
+	CreateDirectory("game:\\gpucaps\\",              NULL);
+	CreateDirectory("game:\\bootcache\\",            NULL);
+	CreateDirectory("game:\\spucaps\\",              NULL);
 	//CreateDirectory("game:\\gameshader\\",           NULL);
 	CreateDirectory("game:\\ROMS\\",           NULL);
 	CreateDirectory("game:\\BIOS\\",           NULL);
 	CreateDirectory(xboxConfig.saveStateDir.c_str(), NULL);
 
+	// trilhas, ID e executável de cada imagem já aberta (lista de jogos e boot rápido)
+	DiscInfoInit("game:\\discinfo.dat");
+
 	Config.PsxOut                  = 1;
 	Config.HLE                     = 0;
     Config.Xa                      = 0;  //XA enabled
@@ -544,10 +608,15 @@ void DoPcsx(std::string sgame){
 		ret = GPU_open(NULL);
 	if (ret < 0) { SysMessage (_("Error Opening GPU Plugin (%d)"), ret); return; }
 		ret = SPU_open(NULL);
+	pAudioClock = SoundGetClock;   // FrameCap segue o relogio do XAudio2
+	Profiler_SetAudioStats(SoundGetStats);   // nivel do anel de audio no log do profiler
+	Profiler_SetCdStats(cdrIsoGetStats);     // acertos/espera do read-ahead do cdriso
 	
 	SPU_registerCallback(SPUirq);
 	
 	if (ret < 0) { SysMessage (_("Error Opening SPU Plugin (%d)"), ret); return; }
+		spuThreadEnable(xboxConfig.UseThreadedSpu);
+		spuThreadInit();
 		ret = PAD1_open(NULL);
 	if (ret < 0) { SysMessage (_("Error Opening PAD1 Plugin (%d)"), ret); return; }
 		PAD1_registerVibration(GPU_visualVibration);
@@ -140,13 +140,13 @@ long PEOPS_GPUopen(unsigned long *, char *, char *);
 long PEOPS_GPUinit(void);
 long PEOPS_GPUshutdown(void);
 long PEOPS_GPUclose(void);
-void PEOPS_GPUwriteStatus(unsigned long);
-void PEOPS_GPUwriteData(unsigned long);
-void PEOPS_GPUwriteDataMem(unsigned long *, int);
-unsigned long PEOPS_GPUreadStatus(void);
-unsigned long PEOPS_GPUreadData(void);
-void PEOPS_GPUreadDataMem(unsigned long *, int);
-long PEOPS_GPUdmaChain(unsigned long *,unsigned long);
+void PEOPS_GPUwriteStatus(uint32_t);
+void PEOPS_GPUwriteData(uint32_t);
+void PEOPS_GPUwriteDataMem(uint32_t *, int);
+uint32_t PEOPS_GPUreadStatus(void);
+uint32_t PEOPS_GPUreadData(void);
+void PEOPS_GPUreadDataMem(uint32_t *, int);
+long PEOPS_GPUdmaChain(uint32_t *,uint32_t);
 void PEOPS_GPUupdateLace(void);
 void PEOPS_GPUdisplayText(char *);
 long PEOPS_GPUfreeze(unsigned long,GPUFreeze_t *);
@@ -6,6 +6,7 @@
 #include "r3000a.h"
 #include "xbPlugins.h"
 #include "gpu.h"
+#include "spu.h"
 
 
 // Init mem and plugins
@@ -129,6 +130,7 @@ void SysClose(){
 
 	// shutdown gpu 1st
 	gpuDmaThreadShutdown();
+	spuThreadShutdown();
 
 	EmuShutdown();
 	ReleasePlugins();
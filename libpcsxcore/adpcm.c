@@ -0,0 +1,205 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* 4 bit ADPCM (BRR) block decoder shared by the SPU voices and CD-XA audio.
+*
+* Decoding is split in two steps: the nibble expansion ((nibble << 12) >>
+* shift) has no dependency between samples and is done 8 samples at a
+* time with SIMD (VMX128 on the 360, SSE2 on host builds); the 2 tap IIR
+* filter is a short serial tail over the 28 expanded samples. Filter 0
+* has no feedback, its output is the expansion itself.
+*/
+
+#include <string.h>
+
+#include "adpcm.h"
+
+#if defined(_XBOX)
+#include <xtl.h>
+#define ADPCM_VMX128
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ADPCM_SSE2
+#endif
+
+// filter coefficients, 1.6 fixed point (XA uses the first four)
+static const int ADPCM_F[5][2] = {
+	{   0,   0 },
+	{  60,   0 },
+	{ 115, -52 },
+	{  98, -55 },
+	{ 122, -60 }
+};
+
+//============================================
+//===  SERIAL FILTER TAIL
+//============================================
+
+// x: 28 expanded samples. The two products are rounded down one by one,
+// as the SPU decoder always did.
+static __inline void ADPCM_Filter(int *dst, const int *x, int filter, int *s_1, int *s_2) {
+	const int f0 = ADPCM_F[filter][0];
+	const int f1 = ADPCM_F[filter][1];
+	int y1 = *s_1, y2 = *s_2, y, i;
+
+	if (filter == 0) {
+		memcpy(dst, x, ADPCM_BLOCK_SAMPLES * sizeof(int));
+		*s_1 = x[27];
+		*s_2 = x[26];
+		return;
+	}
+
+	for (i = 0; i < ADPCM_BLOCK_SAMPLES; i++) {
+		y = x[i] + ((y1 * f0) >> 6) + ((y2 * f1) >> 6);
+		if (y > 32767) y = 32767;
+		else if (y < -32768) y = -32768;
+		dst[i] = y;
+		y2 = y1;
+		y1 = y;
+	}
+
+	*s_1 = y1;
+	*s_2 = y2;
+}
+
+void ADPCM_FilterBlock(int *dst, const int *x, int filter, int *s_1, int *s_2) {
+	ADPCM_Filter(dst, x, filter, s_1, s_2);
+}
+
+//============================================
+//===  SCALAR REFERENCE
+//============================================
+
+void ADPCM_DecodeBlock_C(int *dst, const unsigned char *block, int shift, int filter,
+						 int *s_1, int *s_2) {
+	int x[ADPCM_BLOCK_SAMPLES];
+	int i, d, s;
+
+	for (i = 0; i < ADPCM_BLOCK_SAMPLES / 2; i++) {
+		d = block[2 + i];
+		s = (d & 0x0f) << 12; if (s & 0x8000) s |= 0xffff0000;
+		x[i * 2 + 0] = s >> shift;
+		s = (d & 0xf0) << 8;  if (s & 0x8000) s |= 0xffff0000;
+		x[i * 2 + 1] = s >> shift;
+	}
+
+	ADPCM_Filter(dst, x, filter, s_1, s_2);
+}
+
+//============================================
+//===  VMX128 (xbox 360, big endian)
+//============================================
+
+#if defined(ADPCM_VMX128)
+
+static const __declspec(align(16)) unsigned char vNibMask[16] = {
+	0xf0,0xf0,0xf0,0xf0, 0xf0,0xf0,0xf0,0xf0, 0xf0,0xf0,0xf0,0xf0, 0xf0,0xf0,0xf0,0xf0
+};
+
+// unaligned load (lvlx/lvrx pair)
+#define VLOADU(p)	__vor(__lvlx((void *)(p), 0), __lvrx((void *)(p), 16))
+
+// 8 nibbles (one per byte, in the top half) -> 8 words
+#define VEXPAND8(n, off) { \
+	h = __vsrah(__vmrghb((n), zero), cnt); \
+	__stvx(__vupkhsh(h), x, (off) * 4); \
+	__stvx(__vupklsh(h), x, (off) * 4 + 16); \
+}
+
+void ADPCM_DecodeBlock(int *dst, const unsigned char *block, int shift, int filter,
+					   int *s_1, int *s_2) {
+	__declspec(align(16)) int x[32];
+	__declspec(align(16)) short sh[8];
+	__vector4 zero = __vspltisw(0);
+	__vector4 mask = __lvx(vNibMask, 0);
+	__vector4 v, lo, hi, n0, n1, h, cnt;
+
+	sh[0] = (short)shift;
+	cnt = __vsplth(__lvx(sh, 0), 0);
+
+	// whole block incl. header: nibbles 0..3 of x[] are garbage
+	v  = VLOADU(block);
+	lo = __vand(__vslb(v, __vspltisb(4)), mask);	// low nibbles moved up
+	hi = __vand(v, mask);
+	n0 = __vmrghb(lo, hi);							// nibbles 0..15
+	n1 = __vmrglb(lo, hi);							// nibbles 16..31
+
+	VEXPAND8(n0, 0);
+	VEXPAND8(__vsldoi(n0, n0, 8), 8);
+	VEXPAND8(n1, 16);
+	VEXPAND8(__vsldoi(n1, n1, 8), 24);
+
+	ADPCM_Filter(dst, x + 4, filter, s_1, s_2);
+}
+
+const char *ADPCM_KernelName(void) { return "vmx128"; }
+
+//============================================
+//===  SSE2 (little endian hosts)
+//============================================
+
+#elif defined(ADPCM_SSE2)
+
+// 8 nibbles (one per byte, in the top half) -> 8 words
+#define SEXPAND8(n, off) { \
+	h = _mm_sra_epi16(_mm_unpacklo_epi8(zero, (n)), cnt); \
+	_mm_storeu_si128((__m128i *)(x + (off)),     _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16)); \
+	_mm_storeu_si128((__m128i *)(x + (off) + 4), _mm_srai_epi32(_mm_unpackhi_epi16(h, h), 16)); \
+}
+
+void ADPCM_DecodeBlock(int *dst, const unsigned char *block, int shift, int filter,
+					   int *s_1, int *s_2) {
+	int x[32];
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi8((char)0xf0);
+	const __m128i cnt  = _mm_cvtsi32_si128(shift);
+	__m128i v, lo, hi, n0, n1, h;
+
+	// whole block incl. header: nibbles 0..3 of x[] are garbage
+	v  = _mm_loadu_si128((const __m128i *)block);
+	lo = _mm_and_si128(_mm_slli_epi16(v, 4), mask);	// low nibbles moved up
+	hi = _mm_and_si128(v, mask);
+	n0 = _mm_unpacklo_epi8(lo, hi);					// nibbles 0..15
+	n1 = _mm_unpackhi_epi8(lo, hi);					// nibbles 16..31
+
+	SEXPAND8(n0, 0);
+	SEXPAND8(_mm_srli_si128(n0, 8), 8);
+	SEXPAND8(n1, 16);
+	SEXPAND8(_mm_srli_si128(n1, 8), 24);
+
+	ADPCM_Filter(dst, x + 4, filter, s_1, s_2);
+}
+
+const char *ADPCM_KernelName(void) { return "sse2"; }
+
+//============================================
+//===  NO SIMD AVAILABLE
+//============================================
+
+#else
+
+void ADPCM_DecodeBlock(int *dst, const unsigned char *block, int shift, int filter,
+					   int *s_1, int *s_2) {
+	ADPCM_DecodeBlock_C(dst, block, shift, filter, s_1, s_2);
+}
+
+const char *ADPCM_KernelName(void) { return "scalar"; }
+
+#endif
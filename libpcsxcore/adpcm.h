@@ -0,0 +1,57 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* 4 bit ADPCM (BRR) block decoder shared by the SPU voices (dfsound) and
+* the CD-XA audio decoder (decode_xa.c).
+*/
+
+#ifndef __ADPCM_H__
+#define __ADPCM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADPCM_BLOCK_SAMPLES	28
+
+// Decodes one block into 28 samples (clamped to 16 bit, returned as int).
+//  block   16 byte SPU style block, bytes 2..15 hold the 28 nibbles, low
+//          nibble first. The header bytes 0..1 are not read: the caller
+//          passes shift (0..15) and filter (0..4) already parsed, so XA
+//          sound units can be gathered into the same layout.
+//  s_1/s_2 last two output samples, read and updated (filter history)
+void ADPCM_DecodeBlock(int *dst, const unsigned char *block, int shift, int filter,
+					   int *s_1, int *s_2);
+
+// The filter alone, for decoders that expand the nibbles themselves
+// (decode_xa.c): x holds the 28 samples (nibble << 12) >> shift.
+void ADPCM_FilterBlock(int *dst, const int *x, int filter, int *s_1, int *s_2);
+
+// scalar reference, always compiled (verification / fallback)
+void ADPCM_DecodeBlock_C(int *dst, const unsigned char *block, int shift, int filter,
+						 int *s_1, int *s_2);
+
+// name of the kernel selected at compile time ("vmx128", "sse2", ...)
+const char *ADPCM_KernelName(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* Boot snapshot cache, see bootcache.h for the file layout.
+*
+* The snapshot is only good for the exact setup it was taken with: the
+* key holds the BIOS crc, the image stamp, the game id, the executable's
+* entry point and the core version, and the savestate inside carries its
+* own version check. Anything different is a miss and the boot that
+* follows writes a new snapshot over the old one. Files are written as
+* .tmp and renamed, a snapshot is either complete or not there.
+*/
+
+#include "bootcache.h"
+#include "misc.h"
+#include "cdriso.h"
+#include "ppf.h"
+
+#if defined(_XBOX)
+#include <xtl.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+static char bcDir[MAXPATHLEN] = "";
+
+void BootCacheInit(const char *dir) {
+	if (dir != NULL) {
+		strncpy(bcDir, dir, MAXPATHLEN - 1);
+		bcDir[MAXPATHLEN - 1] = '\0';
+	}
+	else bcDir[0] = '\0';
+}
+
+static int BootKeyMake(BootKey *k) {
+	EXE_HEADER head;
+
+	memset(k, 0, sizeof(BootKey));
+
+	if (bcDir[0] == '\0' || Config.HLE || CdromId[0] == '\0' || !cdrIsoActive())
+		return -1;
+	if (DiscInfoStamp(GetIsoFile(), &k->image) != 0) return -1;
+	if (GetCdromExeHeader(&head) != 0) return -1;
+
+	memcpy(k->magic, BOOTCACHE_MAGIC, 4);
+	k->version = BOOTCACHE_VERSION;
+	strncpy(k->core, PACKAGE_VERSION, sizeof(k->core) - 1);
+	k->regs = sizeof(psxRegisters);
+	k->bios = (u32)crc32(0L, (const Bytef *)psxR_2, 0x80000);
+	memcpy(k->id, CdromId, sizeof(k->id));
+	k->psxType = Config.PsxType;
+	k->entry = SWAP32(head.pc0);
+	k->patch = PatchCrc();
+
+	return 0;
+}
+
+static int BootCacheRestore(const char *file, const BootKey *k) {
+	BootKey fk;
+	gzFile f;
+	int ret = -1;
+
+	f = gzopen(file, "rb");
+	if (f == NULL) return -1;
+
+	if (gzread(f, &fk, sizeof(fk)) == sizeof(fk) && memcmp(&fk, k, sizeof(BootKey)) == 0)
+		ret = LoadStateGz(f);
+
+	gzclose(f);
+	return ret;
+}
+
+static int BootCacheStore(const char *file, const BootKey *k) {
+	char tmp[MAXPATHLEN + 4];
+	gzFile f;
+	int ok;
+
+	sprintf(tmp, "%s.tmp", file);
+
+	f = gzopen(tmp, "wb");
+	if (f == NULL) return -1;
+
+	ok = gzwrite(f, (void *)k, sizeof(BootKey)) == sizeof(BootKey) && SaveStateGz(f) == 0;
+	if (gzclose(f) != Z_OK) ok = 0;
+
+	if (ok) {
+#if defined(_XBOX) || defined(_WIN32)
+		DeleteFileA(file);
+		ok = MoveFileA(tmp, file) ? 1 : 0;
+#else
+		ok = rename(tmp, file) == 0;
+#endif
+	}
+	if (!ok) remove(tmp);
+
+	return ok ? 0 : -1;
+}
+
+int BootCacheBoot(void) {
+	BootKey k;
+	char file[MAXPATHLEN + 32];
+	u32 start;
+
+	if (BootKeyMake(&k) != 0) return -1;
+
+	sprintf(file, "%s%s_%08x.boot", bcDir, k.id, k.bios);
+
+	if (BootCacheRestore(file, &k) == 0) {
+		SysPrintf(_("Boot snapshot %s restored\n"), file);
+		return 0;
+	}
+
+	// the BIOS loads the game as usual, up to its first instruction
+	start = psxRegs.cycle;
+	while (psxRegs.pc != k.entry) {
+		psxCpu->ExecuteBlock();
+
+		// a loader that never gets there: go on from wherever it is
+		if (psxRegs.cycle - start > BOOTCACHE_CYCLES) return -1;
+	}
+
+	if (BootCacheStore(file, &k) == 0)
+		SysPrintf(_("Boot snapshot %s saved\n"), file);
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* Boot snapshot cache: a savestate taken on the first instruction of the
+* game executable, after the BIOS has loaded it, one file per game and
+* BIOS (<dir><CdromId>_<bios crc>.boot). Later boots of the same disc
+* image restore it instead of running the BIOS loader again.
+*
+* file layout (gzip stream, native byte order):
+*  BootKey  key               all of it must match the running setup
+*  ...      savestate         SaveStateGz
+*/
+
+#ifndef __BOOTCACHE_H__
+#define __BOOTCACHE_H__
+
+#include "psxcommon.h"
+#include "discinfo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOTCACHE_MAGIC		"PBOT"
+// bump with changes that make the machine at the entry point differ
+// (boot timing, hardware init) without a savestate version change
+#define BOOTCACHE_VERSION	2
+// emulated cycles the BIOS gets to reach the entry point
+#define BOOTCACHE_CYCLES	(PSXCLK * 30)
+
+typedef struct {
+	char magic[4];
+	u32 version;			// BOOTCACHE_VERSION
+	char core[32];			// PACKAGE_VERSION
+	u32 regs;				// sizeof(psxRegisters)
+	u32 bios;				// crc32 of the BIOS image
+	DiscStamp image;		// disc image size and modification time
+	char id[10];			// CdromId
+	u8 psxType;
+	u8 pad;
+	u32 entry;				// pc0 of the boot executable
+	u32 patch;				// PatchCrc of the ppf/sbi overlay, 0 without
+} BootKey;
+
+// directory for the snapshots, with the trailing separator; NULL or ""
+// turns the cache off
+void BootCacheInit(const char *dir);
+
+// fast boot (LoadCdrom without HLE and slow boot): restores the snapshot
+// of the disc in the drive, or lets the BIOS run up to the entry point
+// and takes one. 0 when the machine is at the entry point, -1 when the
+// BIOS is left to load the game on its own.
+int BootCacheBoot(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -22,6 +22,8 @@
 #include "plugins.h"
 #include "cdrom.h"
 #include "cdriso.h"
+#include "cdz.h"
+#include "discinfo.h"
 
 #ifdef _XBOX
 #include <xtl.h>
@@ -37,8 +39,18 @@
 #endif
 #endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ISO_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 static FILE *cdHandle = NULL;
 static FILE *subHandle = NULL;
+static CdzFile *cdzImage = NULL;	// cdHandle is a compressed image (cdz.c)
+static char subFile[MAXPATHLEN];
+static char sheetFile[MAXPATHLEN];	// sheet the track table came from, "" none
 
 static boolean subChanMixed = FALSE;
 static boolean subChanRaw = FALSE;
@@ -116,6 +128,25 @@ __inline static void tok2msf(char *time, char *msf) {
 	}
 }
 
+// size of the (uncompressed) image
+static long IsoSize(void) {
+	if (cdzImage != NULL) return CdzSize(cdzImage);
+
+	fseek(cdHandle, 0, SEEK_END);
+	return ftell(cdHandle);
+}
+
+// len bytes of the (uncompressed) image from offset
+static void IsoRead(void *buf, u32 offset, u32 len) {
+	if (cdzImage != NULL) {
+		CdzRead(cdzImage, buf, offset, len);
+		return;
+	}
+
+	fseek(cdHandle, offset, SEEK_SET);
+	fread(buf, 1, len, cdHandle);
+}
+
 // this function tries to get the .toc file of the given .bin
 // the necessary data is put into the ti (trackinformation)-array
 static int parsetoc(const char *isofile) {
@@ -213,6 +244,7 @@ static int parsetoc(const char *isofile) {
 
 	fclose(fi);
 
+	strcpy(sheetFile, tocname);
 	return 0;
 }
 
@@ -301,11 +333,11 @@ static int parsecue(const char *isofile) {
 
 	// Fill out the last track's end based on size
 	if (numtracks >= 1) {
-		fseek(cdHandle, 0, SEEK_END);
-		t = ftell(cdHandle) / 2352 - msf2sec(ti[numtracks].start) + 2 * 75;
+		t = IsoSize() / 2352 - msf2sec(ti[numtracks].start) + 2 * 75;
 		sec2msf(t, ti[numtracks].length);
 	}
 
+	strcpy(sheetFile, cuename);
 	return 0;
 }
 
@@ -359,11 +391,11 @@ static int parseccd(const char *isofile) {
 
 	// Fill out the last track's end based on size
 	if (numtracks >= 1) {
-		fseek(cdHandle, 0, SEEK_END);
-		t = ftell(cdHandle) / 2352 - msf2sec(ti[numtracks].start) + 2 * 75;
+		t = IsoSize() / 2352 - msf2sec(ti[numtracks].start) + 2 * 75;
 		sec2msf(t, ti[numtracks].length);
 	}
 
+	strcpy(sheetFile, ccdname);
 	return 0;
 }
 
@@ -463,15 +495,17 @@ static int parsemds(const char *isofile) {
 	}
 
 	fclose(fi);
+
+	strcpy(sheetFile, mdsname);
 	return 0;
 }
 
 // this function tries to get the .sub file of the given .img
 static int opensubfile(const char *isoname) {
-	char		subname[MAXPATHLEN];
+	char		*subname = subFile;
 
 	// copy name of the iso and change extension from .img to .sub
-	strncpy(subname, isoname, sizeof(subname));
+	strncpy(subname, isoname, MAXPATHLEN);
 	subname[MAXPATHLEN - 1] = '\0';
 	if (strlen(subname) >= 4) {
 		strcpy(subname + strlen(subname) - 4, ".sub");
@@ -488,12 +522,391 @@ static int opensubfile(const char *isoname) {
 	return 0;
 }
 
+//============================================
+//===  CDDA
+//============================================
+
+/*
+* Audio frames go from the image (or the read-ahead ring) straight into
+* the caller's buffer. Big endian images (cdrdao .toc) are swapped in
+* the same pass, 16 bytes at a time where the host has vectors (VMX128
+* on the 360, SSE2 elsewhere). 2352 bytes are 147 vectors.
+*/
+
+#if defined(_XBOX)
+#define CDDA_VMX128
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CDDA_SSE2
+#endif
+
+#ifdef CDDA_VMX128
+static const __declspec(align(16)) unsigned char vSwap16[16] = {
+	1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14
+};
+#endif
+
+// one frame of audio, dst may be src
+static void CddaCopy(u8 *dst, const u8 *src, int swap) {
+	int i;
+
+	if (!swap) {
+		if (dst != src) memcpy(dst, src, CD_FRAMESIZE_RAW);
+		return;
+	}
+
+#if defined(CDDA_VMX128)
+	{
+		__vector4 perm = __lvx(vSwap16, 0);
+		__vector4 v;
+
+		for (i = 0; i < CD_FRAMESIZE_RAW; i += 16) {
+			v = __vor(__lvlx((void *)(src + i), 0), __lvrx((void *)(src + i), 16));
+			v = __vperm(v, v, perm);
+			__stvlx(v, dst + i, 0);
+			__stvrx(v, dst + i, 16);
+		}
+	}
+#elif defined(CDDA_SSE2)
+	{
+		__m128i v;
+
+		for (i = 0; i < CD_FRAMESIZE_RAW; i += 16) {
+			v = _mm_loadu_si128((const __m128i *)(src + i));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			_mm_storeu_si128((__m128i *)(dst + i), v);
+		}
+	}
+#else
+	{
+		u8 tmp;
+
+		for (i = 0; i < CD_FRAMESIZE_RAW; i += 2) {
+			tmp = src[i];
+			dst[i] = src[i + 1];
+			dst[i + 1] = tmp;
+		}
+	}
+#endif
+}
+
+//============================================
+//===  READ-AHEAD
+//============================================
+
+/*
+* Sequential reads (the drive playing through a file, fmv, xa, cdda) are
+* served from a ring of sectors that an i/o thread fills ahead of the
+* drive. ISOreadTrack sees the sector progression of cdrReadInterrupt:
+* after RA_TRIGGER reads in a row the thread is asked for the next
+* ra_sectors sectors, read in chunks of RA_CHUNK sectors (one fseek and
+* one fread on its own file handles, chunk aligned in the image). A hit
+* is a copy from the ring, a chunk that is still on its way is waited
+* for (stall time), anything else is read directly as before.
+*
+* Audio playback is the longest sequential read there is: while the
+* drive plays CDDA the window grows to RA_MAX_SECTORS (3 seconds) and
+* ISOreadCDDA copies the frame out of the ring itself, so cdbuffer and
+* subbuffer keep the sector cdrom.c read last.
+*
+* Chunks carry a sequence number that is odd while the thread fills
+* them, the emu thread copies and checks it did not change.
+*/
+
+#if defined(_XBOX) || defined(_WIN32)
+#define ISO_READAHEAD
+#endif
+
+#ifdef ISO_READAHEAD
+
+#ifndef _XBOX
+#define __lwsync()		MemoryBarrier()
+#endif
+
+#define RA_CHUNK		16			// sectors per read of the i/o thread
+#define RA_CHUNKS		16			// ring size in chunks
+#define RA_MAX_SECTORS	((RA_CHUNKS - 2) * RA_CHUNK)
+#define RA_TRIGGER		2			// reads in a row before prefetching
+#define RA_WAIT_MS		500			// longest wait for a chunk, then read directly
+
+typedef struct {
+	volatile u32 seq;				// odd while being filled
+	volatile s32 sector;			// first sector, -1 empty
+	volatile u32 count;				// sectors read (short at the end of the image)
+} RaChunk;
+
+static HANDLE raHandle = NULL;
+static HANDLE raEvent = NULL;
+static volatile u32 ra_exit = 0;
+static volatile __declspec(align(128)) s32 ra_want = -1;	// first sector of the window, -1 idle
+
+static RaChunk ra_chunk[RA_CHUNKS];
+static u8 *ra_buf = NULL;			// RA_CHUNKS * RA_CHUNK sectors of ra_stride bytes
+static u8 *ra_sub = NULL;			// same for the .sub file
+static u32 ra_stride;
+static FILE *ra_cd = NULL;			// own handles, the emu keeps seeking cdHandle
+static FILE *ra_subf = NULL;
+
+static int ra_sectors = 64;			// window, 0 = off
+static volatile s32 ra_window = 64;	// window the thread fills: ra_sectors or audio
+static s32 ra_next = -1;			// emu side: sector a sequential read would ask for
+static u32 ra_run = 0;				// reads in a row, this one included
+static u32 ra_failed = 0;			// no buffers/handles for this image
+
+// stats, read by the profiler (cdrIsoGetStats)
+static u32 ra_hits = 0;
+static u32 ra_misses = 0;
+static u32 ra_stall_us = 0;
+
+static __inline RaChunk *RaChunkOf(s32 sector) {
+	return &ra_chunk[(sector / RA_CHUNK) % RA_CHUNKS];
+}
+
+static void RaFill(RaChunk *k, s32 first) {
+	u32 slot = (u32)(k - ra_chunk) * RA_CHUNK;
+	size_t n = 0;
+
+	k->seq++;
+	__lwsync();
+	k->sector = -1;
+
+	if (fseek(ra_cd, first * ra_stride, SEEK_SET) == 0)
+		n = fread(ra_buf + slot * ra_stride, ra_stride, RA_CHUNK, ra_cd);
+
+	if (ra_subf != NULL && n) {
+		fseek(ra_subf, first * SUB_FRAMESIZE, SEEK_SET);
+		fread(ra_sub + slot * SUB_FRAMESIZE, SUB_FRAMESIZE, n, ra_subf);
+	}
+
+	k->count = (u32)n;
+	k->sector = first;
+	__lwsync();
+	k->seq++;
+}
+
+static void raThread() {
+	RaChunk *k;
+	s32 want, window, c;
+
+	while (!ra_exit) {
+		WaitForSingleObject(raEvent, INFINITE);
+
+		// first chunk of the window that is not loaded, until it is complete
+		// or the emu has gone somewhere else
+		while (!ra_exit && (want = ra_want) >= 0) {
+			window = ra_window;
+			for (c = want - want % RA_CHUNK; c < want + window; c += RA_CHUNK) {
+				k = RaChunkOf(c);
+				if (k->sector != c) break;
+			}
+			if (c >= want + window) break;
+
+			RaFill(k, c);
+		}
+	}
+
+	ExitThread(0);
+}
+
+// stops the thread and forgets the access pattern (image open/close)
+static void RaStop() {
+	ra_want = -1;
+	ra_next = -1;
+	ra_run = 0;
+	ra_failed = 0;
+
+	if (!raHandle) return;
+
+	ra_exit = 1;
+	SetEvent(raEvent);
+	WaitForSingleObject(raHandle, INFINITE);
+	CloseHandle(raHandle);
+	CloseHandle(raEvent);
+	raHandle = NULL;
+	raEvent = NULL;
+
+	if (ra_cd) fclose(ra_cd);
+	if (ra_subf) fclose(ra_subf);
+	ra_cd = ra_subf = NULL;
+	free(ra_buf);
+	free(ra_sub);
+	ra_buf = ra_sub = NULL;
+}
+
+static int RaStart() {
+	int i;
+
+	// compressed: the hunk cache reads ahead already, the thread has no
+	// reader of its own
+	if (cdzImage != NULL) {
+		ra_failed = 1;
+		return 0;
+	}
+
+	if (subChanMixed) ra_stride = CD_FRAMESIZE_RAW + SUB_FRAMESIZE;
+	else if (isMode1ISO) ra_stride = MODE1_DATA_SIZE;
+	else ra_stride = CD_FRAMESIZE_RAW;
+
+	ra_cd = fopen(GetIsoFile(), "rb");
+	ra_buf = (u8 *)malloc(RA_CHUNKS * RA_CHUNK * ra_stride);
+	if (subHandle != NULL) {
+		ra_subf = fopen(subFile, "rb");
+		ra_sub = (u8 *)malloc(RA_CHUNKS * RA_CHUNK * SUB_FRAMESIZE);
+	}
+	if (!ra_cd || !ra_buf || (subHandle != NULL && (!ra_subf || !ra_sub))) {
+		if (ra_cd) fclose(ra_cd);
+		if (ra_subf) fclose(ra_subf);
+		ra_cd = ra_subf = NULL;
+		free(ra_buf);
+		free(ra_sub);
+		ra_buf = ra_sub = NULL;
+		ra_failed = 1;
+		return 0;
+	}
+	setvbuf(ra_cd, NULL, _IONBF, 0);
+	if (ra_subf) setvbuf(ra_subf, NULL, _IONBF, 0);
+
+	for (i = 0; i < RA_CHUNKS; i++) {
+		ra_chunk[i].seq = 0;
+		ra_chunk[i].sector = -1;
+		ra_chunk[i].count = 0;
+	}
+	ra_want = -1;
+	ra_exit = 0;
+
+	raEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	raHandle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)raThread, NULL, CREATE_SUSPENDED, NULL);
+#ifdef _XBOX
+	XSetThreadProcessor(raHandle, 5);
+#endif
+	ResumeThread(raHandle);
+	return 1;
+}
+
+static u32 RaMicroseconds(LARGE_INTEGER *t0) {
+	LARGE_INTEGER t, f;
+
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&f);
+	return (u32)((t.QuadPart - t0->QuadPart) * 1000000 / f.QuadPart);
+}
+
+// copies the sector from the ring into cdbuffer/subbuffer laid out like
+// the direct read, or only its audio into pcm (swapped for big endian
+// images), 0 if it has to be read directly
+static int RaRead(s32 sector, u8 *pcm) {
+	RaChunk *k;
+	s32 first, last;
+	u32 seq, idx, slot, waited = 0;
+	LARGE_INTEGER t0;
+
+	if (ra_sectors <= 0 || ra_failed || sector < 0) return 0;
+	if (pcm != NULL && isMode1ISO) return 0;
+
+	// sequential?
+	if (sector == ra_next) ra_run++;
+	else ra_run = 1;
+	ra_next = sector + 1;
+
+	if (ra_run < RA_TRIGGER) {
+		ra_want = -1;		// random access, let the thread rest
+		return 0;
+	}
+
+	if (!raHandle && !RaStart()) return 0;
+
+	first = sector - sector % RA_CHUNK;
+	idx = sector - first;
+	k = RaChunkOf(sector);
+
+	// wake the thread when the window has a hole
+	ra_window = pcm != NULL ? RA_MAX_SECTORS : ra_sectors;
+	last = sector + ra_window - 1;
+	ra_want = sector;
+	if (k->sector != first || RaChunkOf(last)->sector != last - last % RA_CHUNK)
+		SetEvent(raEvent);
+
+	for (;;) {
+		seq = k->seq;
+		__lwsync();
+		if (!(seq & 1) && k->sector == first) {
+			if (idx >= k->count) break;		// past the end of the image
+
+			slot = (u32)(k - ra_chunk) * RA_CHUNK + idx;
+			if (pcm != NULL) {
+				CddaCopy(pcm, ra_buf + slot * ra_stride, cddaBigEndian);
+			}
+			else if (subChanMixed) {
+				memcpy(cdbuffer, ra_buf + slot * ra_stride, CD_FRAMESIZE_RAW);
+				memcpy(subbuffer, ra_buf + slot * ra_stride + CD_FRAMESIZE_RAW, SUB_FRAMESIZE);
+			}
+			else {
+				memcpy(isMode1ISO ? cdbuffer + 12 : cdbuffer, ra_buf + slot * ra_stride, ra_stride);
+				if (ra_sub != NULL) memcpy(subbuffer, ra_sub + slot * SUB_FRAMESIZE, SUB_FRAMESIZE);
+			}
+
+			__lwsync();
+			if (k->seq == seq) {
+				ra_hits++;
+				if (waited) ra_stall_us += RaMicroseconds(&t0);
+				return 1;
+			}
+		}
+
+		// not there yet: the thread has it in the window, wait for it
+		if (!waited) {
+			QueryPerformanceCounter(&t0);
+			waited = 1;
+		}
+		else if (RaMicroseconds(&t0) > RA_WAIT_MS * 1000) {
+			break;
+		}
+		Sleep(0);
+	}
+
+	ra_misses++;
+	if (waited) ra_stall_us += RaMicroseconds(&t0);
+	return 0;
+}
+
+#else
+
+#define RaStop()
+#define RaRead(sector, pcm)	0
+
+#endif
+
+void cdrIsoSetReadAhead(int sectors) {
+#ifdef ISO_READAHEAD
+	if (sectors < 0) sectors = 0;
+	if (sectors > RA_MAX_SECTORS) sectors = RA_MAX_SECTORS;
+
+	RaStop();
+	ra_sectors = sectors;
+#endif
+}
+
+int cdrIsoGetStats(unsigned long *hits, unsigned long *misses, unsigned long *stall_us) {
+#ifdef ISO_READAHEAD
+	*hits = ra_hits;
+	*misses = ra_misses;
+	*stall_us = ra_stall_us;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
 long CALLBACK ISOinit(void) {
 
 	return 0; // do nothing
 }
 
 static long CALLBACK ISOshutdown(void) {
+	RaStop();
+	DiscInfoClose();
+	CdzClose(cdzImage);
+	cdzImage = NULL;
 	if (cdHandle != NULL) {
 		fclose(cdHandle);
 		cdHandle = NULL;
@@ -517,9 +930,49 @@ static void PrintTracks(void) {
 	}
 }
 
+// track table and layout from/to the metadata cache (discinfo.c)
+static void LayoutLoad(const DiscInfo *di) {
+	int i;
+
+	memset(&ti, 0, sizeof(ti));
+	numtracks = di->numtracks;
+	for (i = 1; i <= numtracks; i++) {
+		ti[i].type = di->track[i].type;
+		memcpy(ti[i].start, di->track[i].start, 3);
+		memcpy(ti[i].length, di->track[i].length, 3);
+	}
+
+	subChanMixed = (di->flags & DISCINFO_SUBMIXED) ? TRUE : FALSE;
+	subChanRaw = (di->flags & DISCINFO_SUBRAW) ? TRUE : FALSE;
+	isMode1ISO = (di->flags & DISCINFO_MODE1) ? TRUE : FALSE;
+	cddaBigEndian = (di->flags & DISCINFO_CDDABE) ? TRUE : FALSE;
+}
+
+static void LayoutStore(DiscInfo *di) {
+	int i;
+
+	memset(di->track, 0, sizeof(di->track));
+	di->numtracks = numtracks;
+	for (i = 1; i <= numtracks; i++) {
+		di->track[i].type = ti[i].type;
+		memcpy(di->track[i].start, ti[i].start, 3);
+		memcpy(di->track[i].length, ti[i].length, 3);
+	}
+
+	di->flags &= ~(DISCINFO_SUBMIXED | DISCINFO_SUBRAW | DISCINFO_MODE1 | DISCINFO_CDDABE);
+	if (subChanMixed) di->flags |= DISCINFO_SUBMIXED;
+	if (subChanRaw) di->flags |= DISCINFO_SUBRAW;
+	if (isMode1ISO) di->flags |= DISCINFO_MODE1;
+	if (cddaBigEndian) di->flags |= DISCINFO_CDDABE;
+	di->flags |= DISCINFO_LAYOUT;
+
+	DiscInfoSetSheet(di, GetIsoFile(), sheetFile);
+}
+
 // This function is invoked by the front-end when opening an ISO
 // file for playback
 static long CALLBACK ISOopen(void) {
+	DiscInfo *di;
 	u32 modeTest = 0;
 
 	if (cdHandle != NULL) {
@@ -533,12 +986,28 @@ static long CALLBACK ISOopen(void) {
 
 	SysPrintf(_("Loaded CD Image: %s"), GetIsoFile());
 
+	RaStop();
+
+	cdzImage = CdzOpen(cdHandle);
+	if (cdzImage != NULL) {
+		SysPrintf("[cdz]");
+	}
+
 	cddaBigEndian = FALSE;
 	subChanMixed = FALSE;
 	subChanRaw = FALSE;
 	isMode1ISO = FALSE;
-
-	if (parseccd(GetIsoFile()) == 0) {
+	sheetFile[0] = '\0';
+
+	// a sheet parsed before and unchanged since: no parsing. Images
+	// without a sheet are not cached, a sheet added later would be missed
+	// and the mode1 guess is a single read anyway.
+	di = DiscInfoOpen(GetIsoFile());
+	if (di != NULL && (di->flags & DISCINFO_LAYOUT) && DiscInfoSheetValid(di, GetIsoFile())) {
+		LayoutLoad(di);
+		SysPrintf("[cached]");
+	}
+	else if (parseccd(GetIsoFile()) == 0) {
 		SysPrintf("[+ccd]");
 	}
 	else if (parsemds(GetIsoFile()) == 0) {
@@ -551,13 +1020,15 @@ static long CALLBACK ISOopen(void) {
 		SysPrintf("[+toc]");
 	} else {
 		//guess whether it is mode1/2048
-		fseek(cdHandle, 0, SEEK_END);
-		if(ftell(cdHandle) % 2048 == 0) {
-			fseek(cdHandle, 0, SEEK_SET);
-			fread(&modeTest, 4, 1, cdHandle);
+		if(IsoSize() % 2048 == 0) {
+			IsoRead(&modeTest, 0, 4);
 			if(SWAP32(modeTest)!=0xffffff00) isMode1ISO = TRUE;
 		}
-		fseek(cdHandle, 0, SEEK_SET);
+	}
+
+	if (di != NULL && sheetFile[0] != '\0') {
+		LayoutStore(di);
+		DiscInfoSave();
 	}
 
 	if (!subChanMixed && opensubfile(GetIsoFile()) == 0) {
@@ -572,6 +1043,10 @@ static long CALLBACK ISOopen(void) {
 }
 
 static long CALLBACK ISOclose(void) {
+	RaStop();
+	DiscInfoClose();
+	CdzClose(cdzImage);
+	cdzImage = NULL;
 	if (cdHandle != NULL) {
 		fclose(cdHandle);
 		cdHandle = NULL;
@@ -608,15 +1083,12 @@ static long CALLBACK ISOgetTN(unsigned char *buffer) {
 //  byte 2 - minute
 static long CALLBACK ISOgetTD(unsigned char track, unsigned char *buffer) {
 	if( track == 0 ) {
-		unsigned int pos, size;
+		unsigned int size;
 		unsigned char time[3];
 
 		// Vib Ribbon: return size of CD
 		// - ex. 20 min, 22 sec, 66 fra
-		pos = ftell( cdHandle );
-		fseek( cdHandle, 0, SEEK_END );
-		size = ftell( cdHandle );
-		fseek( cdHandle, pos, SEEK_SET );
+		size = IsoSize();
 
 		// relative -> absolute time (+2 seconds)
 		size += 150 * 2352;
@@ -660,39 +1132,44 @@ static void DecodeRawSubData(void) {
 // time: byte 0 - minute; byte 1 - second; byte 2 - frame
 // uses bcd format
 static long CALLBACK ISOreadTrack(unsigned char *time) {
+	s32 sector;
+
 	if (cdHandle == NULL) {
 		return -1;
 	}
 
-	if (subChanMixed) {
-		fseek(cdHandle, MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2])) * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE), SEEK_SET);
-		fread(cdbuffer, 1, CD_FRAMESIZE_RAW, cdHandle);
-		fread(subbuffer, 1, SUB_FRAMESIZE, cdHandle);
+	sector = MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2]));
 
-		if (subChanRaw) DecodeRawSubData();
+	if (RaRead(sector, NULL)) {
+		// from the read-ahead ring, laid out like below
+	}
+	else if (subChanMixed) {
+		IsoRead(cdbuffer, sector * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE), CD_FRAMESIZE_RAW);
+		IsoRead(subbuffer, sector * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE) + CD_FRAMESIZE_RAW, SUB_FRAMESIZE);
 	}
 	else {
 		if(isMode1ISO) {
-			fseek(cdHandle, MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2])) * MODE1_DATA_SIZE, SEEK_SET);
-			fread(cdbuffer + 12, 1, MODE1_DATA_SIZE, cdHandle);
-			memset(cdbuffer, 0, 12); //not really necessary, fake mode 2 header
-			cdbuffer[0] = (time[0]);
-			cdbuffer[1] = (time[1]);
-			cdbuffer[2] = (time[2]);
-			cdbuffer[3] = 1; //mode 1
+			IsoRead(cdbuffer + 12, sector * MODE1_DATA_SIZE, MODE1_DATA_SIZE);
 		} else {
-			fseek(cdHandle, MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2])) * CD_FRAMESIZE_RAW, SEEK_SET);
-			fread(cdbuffer, 1, CD_FRAMESIZE_RAW, cdHandle);
+			IsoRead(cdbuffer, sector * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
 		}
 
 		if (subHandle != NULL) {
-			fseek(subHandle, MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2])) * SUB_FRAMESIZE, SEEK_SET);
+			fseek(subHandle, sector * SUB_FRAMESIZE, SEEK_SET);
 			fread(subbuffer, 1, SUB_FRAMESIZE, subHandle);
-
-			if (subChanRaw) DecodeRawSubData();
 		}
 	}
 
+	if (!subChanMixed && isMode1ISO) {
+		memset(cdbuffer, 0, 12); //not really necessary, fake mode 2 header
+		cdbuffer[0] = (time[0]);
+		cdbuffer[1] = (time[1]);
+		cdbuffer[2] = (time[2]);
+		cdbuffer[3] = 1; //mode 1
+	}
+
+	if (subChanRaw && (subChanMixed || subHandle != NULL)) DecodeRawSubData();
+
 	return 0;
 }
 
@@ -749,32 +1226,23 @@ static long CALLBACK ISOgetStatus(struct CdrStat *stat) {
 // read CDDA sector into buffer
 long CALLBACK ISOreadCDDA(unsigned char m, unsigned char s, unsigned char f, unsigned char *buffer) {
 	unsigned char msf[3] = {m, s, f};
-	unsigned char *p;
+	s32 sector;
 
 	cddaCurPos = msf2sec(msf);
 
-	msf[0] = itob(msf[0]);
-	msf[1] = itob(msf[1]);
-	msf[2] = itob(msf[2]);
-
-	if (ISOreadTrack(msf) != 0) return -1;
+	if (cdHandle == NULL) return -1;
 
-	p = ISOgetBuffer();
-	if (p == NULL) return -1;
+	sector = MSF2SECT(m, s, f);
 
-	memcpy(buffer, p - 12, CD_FRAMESIZE_RAW); // copy from the beginning of the sector
+	if (RaRead(sector, buffer)) return 0;
 
-	if (cddaBigEndian) {
-		int i;
-		unsigned char tmp;
+	memset(buffer, 0, CD_FRAMESIZE_RAW);
+	if (isMode1ISO || sector < 0) return -1;	// no audio in a 2048 byte image
 
-		for (i = 0; i < CD_FRAMESIZE_RAW / 2; i++) {
-			tmp = buffer[i * 2];
-			buffer[i * 2] = buffer[i * 2 + 1];
-			buffer[i * 2 + 1] = tmp;
-		}
-	}
+	if (subChanMixed) IsoRead(buffer, sector * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE), CD_FRAMESIZE_RAW);
+	else IsoRead(buffer, sector * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
 
+	CddaCopy(buffer, buffer, cddaBigEndian);
 	return 0;
 }
 
@@ -802,6 +1270,197 @@ void cdrIsoInit(void) {
 	numtracks = 0;
 }
 
+//============================================
+//===  MEMORY MAPPED IMAGE
+//============================================
+
+/*
+* cdrIsoMapInit: same image formats and toc parsing as above, but the
+* data file (and the .sub file) are mapped and CDR_getBuffer and
+* CDR_getBufferSub return pointers into the mapping, no copy and no
+* syscall per sector. The mapping is private and writable so ppf
+* patching in place (misc.c) still works, untouched pages stay shared
+* with the page cache.
+*
+* Streaming (MAP_TRIGGER sequential reads) sets MADV_SEQUENTIAL and asks
+* for the next MAP_AHEAD sectors with MADV_WILLNEED, a jump goes back to
+* MADV_NORMAL. Compressed images, 2048 byte images (the mode 2 header
+* has to be faked), raw subchannel data and sectors outside the mapping
+* go through ISOreadTrack.
+*/
+
+#ifdef ISO_MMAP
+
+#define MAP_TRIGGER		2			// reads in a row before the sequential hint
+#define MAP_AHEAD		128			// sectors, also the WILLNEED step
+
+static u8 *map_cd = NULL;
+static size_t map_cd_size = 0;
+static u8 *map_sub = NULL;
+static size_t map_sub_size = 0;
+
+static u8 *map_sector = NULL;		// current sector in the mapping, NULL: cdbuffer
+static u8 *map_subq = NULL;			// same for the subchannel
+static s32 map_next = -1;
+static u32 map_run = 0;			// reads in a row, this one included
+static s32 map_willneed = -1;		// sector the last WILLNEED window starts at
+static int map_seq = 0;
+
+static u8 *MapFile(FILE *f, size_t *size) {
+	struct stat st;
+	void *p;
+
+	if (f == NULL || fstat(fileno(f), &st) != 0 || st.st_size <= 0) return NULL;
+
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+	if (p == MAP_FAILED) return NULL;
+
+	*size = st.st_size;
+	return (u8 *)p;
+}
+
+static void MapUnmap(void) {
+	if (map_cd) munmap(map_cd, map_cd_size);
+	if (map_sub) munmap(map_sub, map_sub_size);
+	map_cd = map_sub = NULL;
+	map_cd_size = map_sub_size = 0;
+	map_sector = map_subq = NULL;
+	map_next = -1;
+	map_run = 0;
+	map_willneed = -1;
+	map_seq = 0;
+}
+
+static void MapAdvise(s32 sector, u32 stride) {
+	long page = sysconf(_SC_PAGESIZE);
+	size_t a, b;
+
+	if (sector == map_next) map_run++;
+	else map_run = 1;
+	map_next = sector + 1;
+
+	if (map_run < MAP_TRIGGER) {
+		if (map_seq) {
+			madvise(map_cd, map_cd_size, MADV_NORMAL);
+			map_seq = 0;
+			map_willneed = -1;
+		}
+		return;
+	}
+
+	if (!map_seq) {
+		madvise(map_cd, map_cd_size, MADV_SEQUENTIAL);
+		map_seq = 1;
+	}
+
+	// next window once the drive is half way through the last one
+	if (map_willneed < 0 || sector >= map_willneed + MAP_AHEAD / 2) {
+		a = ((size_t)sector * stride) & ~(size_t)(page - 1);
+		b = (size_t)(sector + MAP_AHEAD) * stride;
+		if (b > map_cd_size) b = map_cd_size;
+		if (a < b) madvise(map_cd + a, b - a, MADV_WILLNEED);
+		map_willneed = sector;
+	}
+}
+
+static long CALLBACK MapOpen(void) {
+	long ret;
+
+	if (cdHandle != NULL) {
+		return 0; // it's already open
+	}
+
+	ret = ISOopen();
+	if (ret != 0) return ret;
+
+	MapUnmap();
+	if (!isMode1ISO && cdzImage == NULL) {
+		map_cd = MapFile(cdHandle, &map_cd_size);
+		if (subHandle != NULL) map_sub = MapFile(subHandle, &map_sub_size);
+	}
+
+	return 0;
+}
+
+static long CALLBACK MapClose(void) {
+	MapUnmap();
+	return ISOclose();
+}
+
+static long CALLBACK MapShutdown(void) {
+	MapUnmap();
+	return ISOshutdown();
+}
+
+static long CALLBACK MapReadTrack(unsigned char *time) {
+	u32 stride = subChanMixed ? CD_FRAMESIZE_RAW + SUB_FRAMESIZE : CD_FRAMESIZE_RAW;
+	s32 sector = MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2]));
+	u8 *p;
+
+	map_sector = map_subq = NULL;
+
+	if (map_cd == NULL || sector < 0 || (size_t)(sector + 1) * stride > map_cd_size ||
+		(subHandle != NULL && (map_sub == NULL || (size_t)(sector + 1) * SUB_FRAMESIZE > map_sub_size))) {
+		return ISOreadTrack(time);
+	}
+
+	MapAdvise(sector, stride);
+
+	p = map_cd + (size_t)sector * stride;
+	map_sector = p;
+
+	if (subChanMixed) map_subq = p + CD_FRAMESIZE_RAW;
+	else if (map_sub != NULL) map_subq = map_sub + (size_t)sector * SUB_FRAMESIZE;
+
+	if (subChanRaw && map_subq != NULL) {
+		memcpy(subbuffer, map_subq, SUB_FRAMESIZE);
+		DecodeRawSubData();
+		map_subq = NULL;
+	}
+
+	return 0;
+}
+
+static long CALLBACK MapReadCDDA(unsigned char m, unsigned char s, unsigned char f, unsigned char *buffer) {
+	u32 stride = subChanMixed ? CD_FRAMESIZE_RAW + SUB_FRAMESIZE : CD_FRAMESIZE_RAW;
+	s32 sector = MSF2SECT(m, s, f);
+
+	if (map_cd == NULL || sector < 0 || (size_t)(sector + 1) * stride > map_cd_size) {
+		return ISOreadCDDA(m, s, f, buffer);
+	}
+
+	cddaCurPos = sector + 150;
+	MapAdvise(sector, stride);
+	CddaCopy(buffer, map_cd + (size_t)sector * stride, cddaBigEndian);
+	return 0;
+}
+
+static unsigned char * CALLBACK MapGetBuffer(void) {
+	return map_sector != NULL ? map_sector + 12 : cdbuffer + 12;
+}
+
+static unsigned char* CALLBACK MapGetBufferSub(void) {
+	if (map_subq != NULL) return map_subq;
+	return ISOgetBufferSub();
+}
+
+#endif
+
+// cdrIsoInit with the image mapped where the host can (else the same)
+void cdrIsoMapInit(void) {
+	cdrIsoInit();
+
+#ifdef ISO_MMAP
+	CDR_shutdown = MapShutdown;
+	CDR_open = MapOpen;
+	CDR_close = MapClose;
+	CDR_readTrack = MapReadTrack;
+	CDR_getBuffer = MapGetBuffer;
+	CDR_getBufferSub = MapGetBufferSub;
+	CDR_readCDDA = MapReadCDDA;
+#endif
+}
+
 int cdrIsoActive(void) {
 	return (cdHandle != NULL);
 }
@@ -26,8 +26,14 @@ extern "C" {
 #endif
 
 void cdrIsoInit(void);
+void cdrIsoMapInit(void);
 int cdrIsoActive(void);
 
+// read-ahead window in sectors (0 = off), stats for the profiler:
+// sequential reads served from memory / read directly, us waited
+void cdrIsoSetReadAhead(int sectors);
+int cdrIsoGetStats(unsigned long *hits, unsigned long *misses, unsigned long *stall_us);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,7 @@
 #include "cdrom.h"
 #include "ppf.h"
 #include "psxdma.h"
+#include "sio.h"
 
 cdrStruct cdr;
 
@@ -217,7 +218,7 @@ extern SPUregisterCallback SPU_registerCallback;
 		cdr.Play = FALSE; \
 		cdr.FastForward = 0; \
 		cdr.FastBackward = 0; \
-		SPU_registerCallback( SPUirq ); \
+		spuRegisterCallback( SPUirq ); \
 	} \
 }
 
@@ -268,12 +269,12 @@ void cdrDecodedBufferInterrupt()
 
 	// check dbuf IRQ still active
 	if( cdr.Play == 0 ) return;
-	if( (SPU_readRegister( H_SPUctrl ) & 0x40) == 0 ) return;
-	if( (SPU_readRegister( H_SPUirqAddr ) * 8) >= 0x800 ) return;
+	if( (spuReadRegister( H_SPUctrl ) & 0x40) == 0 ) return;
+	if( (spuReadRegister( H_SPUirqAddr ) * 8) >= 0x800 ) return;
 
 
 	// turn off plugin SPU IRQ decoded buffer handling
-	SPU_registerCallback( 0 );
+	spuRegisterCallback( 0 );
 
 
 	/*
@@ -312,6 +313,7 @@ void cdrLidSeekInterrupt()
 		if (stat.Status & STATUS_SHELLOPEN)
 		{
 			StopCdda();
+			McdFlush();	// saves before the disc goes away
 			cdr.DriveState = DRIVESTATE_LID_OPEN;
 			CDRLID_INT(0x800);
 		}
@@ -370,6 +372,76 @@ void cdrLidSeekInterrupt()
 	}
 }
 
+/*
+* CD timing
+*
+* A sector passes the head every cdReadTime at 1x, half that at 2x. A
+* seek from the current position (SetSectorPlay) to the target costs:
+*  - up to CD_SEEK_NEAR sectors: two sectors' time, the head waits for
+*    the sector to come around
+*  - further: a track jump growing with the log of the distance, up to
+*    CD_SEEK_FAR for the whole disc (real drives take longer, but that is
+*    the window Rockman X5, Medievil and Crusaders of Might and Magic
+*    are happy with)
+*  - a stopped motor spins up first (CD_SPINUP)
+*  - with real timing the total stays within CD_SEEK_FAR, the fixed seek
+*    time of before
+*
+* With real timing a ReadN/ReadS still starts after two sectors at most,
+* as before the seek model (Crusaders of Might and Magic wants it short).
+*
+* Fast load (Config.CdFastLoad = n > 1) divides seek and read delays by
+* n, but only while no audio streams: never while CDDA plays and not for
+* CD_STREAM_HOLD sectors after an XA audio sector went past, so movies
+* and streamed music keep the real rate.
+*/
+
+#define CD_SEEK_NEAR		8					// sectors
+#define CD_SEEK_FAR			(cdReadTime * 4)
+#define CD_SPINUP			(cdReadTime * 25)	// a third of a second
+#define CD_DISC_SECTORS		(80 * 60 * 75)
+#define CD_STREAM_HOLD		32					// sectors of real timing after xa audio
+
+static u32 cdStreamHold = 0;
+
+static u32 CdTimeScale(u32 cycles) {
+	if (Config.CdFastLoad > 1 && !cdr.Play && cdStreamHold == 0)
+		return cycles / Config.CdFastLoad;
+	return cycles;
+}
+
+// one sector at the current speed
+static u32 CdTimeRead(void) {
+	return CdTimeScale((cdr.Mode & MODE_SPEED) ? cdReadTime / 2 : cdReadTime);
+}
+
+// retry while the cpu has not taken the last irq yet
+static u32 CdTimeRetry(void) {
+	return CdTimeScale(cdReadTime / 2);
+}
+
+// from the current position to target (msf, binary)
+static u32 CdTimeSeek(const u8 *target) {
+	s32 d = MSF2SECT(target[0], target[1], target[2]) -
+			MSF2SECT(cdr.SetSectorPlay[0], cdr.SetSectorPlay[1], cdr.SetSectorPlay[2]);
+	u32 period = (cdr.Mode & MODE_SPEED) ? cdReadTime / 2 : cdReadTime;
+	u32 cycles;
+
+	if (d < 0) d = -d;
+
+	cycles = period * 2;
+	if (d > CD_SEEK_NEAR) {
+		cycles += (u32)((CD_SEEK_FAR - period * 2) *
+				  log(1.0 + d / 4500.0) / log(1.0 + CD_DISC_SECTORS / 4500.0));
+		if (cycles > CD_SEEK_FAR) cycles = CD_SEEK_FAR;
+	}
+
+	if (cdr.DriveState == DRIVESTATE_STOPPED) cycles += CD_SPINUP;
+	if (Config.CdFastLoad <= 1 && cycles > CD_SEEK_FAR) cycles = CD_SEEK_FAR;
+
+	return CdTimeScale(cycles);
+}
+
 static void Find_CurTrack(const u8 *time)
 {
 	int current, sect;
@@ -615,7 +687,7 @@ u8 temp[3];//////////////////////////////////////////////////////////
 	//		SPU_playCDDAchannel((short *)cdr.Transfer, CD_FRAMESIZE_RAW);
 
     if( cdr.Play && SPU_playCDDAchannel)
-		SPU_playCDDAchannel((short *)cdr.Transfer, CD_FRAMESIZE_RAW);
+		spuPlayCDDAchannel((short *)cdr.Transfer, CD_FRAMESIZE_RAW);
 
 //	}
 	CDRMISC_INT(cdReadTime);
@@ -690,7 +762,7 @@ void cdrPlayInterrupt()
 	if (Config.Cdda) memset( cdr.Transfer, 0, CD_FRAMESIZE_RAW );
 
 	if (SPU_playCDDAchannel)
-		SPU_playCDDAchannel((short *)cdr.Transfer, CD_FRAMESIZE_RAW);
+		spuPlayCDDAchannel((short *)cdr.Transfer, CD_FRAMESIZE_RAW);
 
 	cdr.SetSectorPlay[2]++;
 	if (cdr.SetSectorPlay[2] == 75) {
@@ -1016,7 +1088,8 @@ void cdrInterrupt() {
 	//		Rockman X5 = 0.5-4x
 	//		- fix capcom logo
 			
-			CDRMISC_INT(cdr.Seeked == SEEK_DONE ? 0x800 : cdReadTime * 4);
+			CDRMISC_INT(cdr.Seeked == SEEK_DONE ? 0x800 :
+				CdTimeSeek(cdr.SetlocPending ? cdr.SetSector : cdr.SetSectorPlay));
 			cdr.Seeked = SEEK_PENDING;
 			start_rotating = 1;
 			break; 
@@ -1095,6 +1168,12 @@ void cdrInterrupt() {
 
 		case CdlReadN:
 		case CdlReadS:
+			// seek time from where the head was; with real timing no longer
+			// than the old two sectors, games time their first sector on it
+			delay = CdTimeSeek(cdr.SetlocPending ? cdr.SetSector : cdr.SetSectorPlay);
+			if (Config.CdFastLoad <= 1 && delay > CdTimeRead() * 2)
+				delay = CdTimeRead() * 2;
+
 			if (cdr.SetlocPending) {
 				memcpy(cdr.SetSectorPlay, cdr.SetSector, 4);
 				cdr.SetlocPending = 0;
@@ -1133,14 +1212,12 @@ void cdrInterrupt() {
 
 				// Crusaders of Might and Magic - use short time
 				// - fix cutscene speech (startup)
-
-				// ??? - use more accurate seek time later
-				CDREAD_INT((cdr.Mode & 0x80) ? (cdReadTime) : cdReadTime * 2);
+				CDREAD_INT(delay);
 			} else {
 				cdr.StatP |= STATUS_READ;
 				cdr.StatP &= ~STATUS_SEEK;
 
-				CDREAD_INT((cdr.Mode & 0x80) ? (cdReadTime) : cdReadTime * 2);
+				CDREAD_INT(CdTimeRead() * 2);
 			}
 
 			cdr.Result[0] = cdr.StatP;
@@ -1196,47 +1273,20 @@ finish:
 #endif
 }
 
-#define ssat32_to_16(v) do { \
-	if (v < -32768) v = -32768; \
-	else if (v > 32767) v = 32767; \
-} while (0)
+static void cdrGetAttenuation(xa_atten_t *att)
+{
+	att->ll = cdr.AttenuatorLeftToLeft;
+	att->lr = cdr.AttenuatorLeftToRight;
+	att->rl = cdr.AttenuatorRightToLeft;
+	att->rr = cdr.AttenuatorRightToRight;
+}
 
 void cdrAttenuate(s16 *buf, int samples, int stereo)
 {
-	int i, l, r;
-	int ll = cdr.AttenuatorLeftToLeft;
-	int lr = cdr.AttenuatorLeftToRight;
-	int rl = cdr.AttenuatorRightToLeft;
-	int rr = cdr.AttenuatorRightToRight;
-
-	if (lr == 0 && rl == 0 && 0x78 <= ll && ll <= 0x88 && 0x78 <= rr && rr <= 0x88)
-		return;
-
-	if (!stereo && ll == 0x40 && lr == 0x40 && rl == 0x40 && rr == 0x40)
-		return;
+	xa_atten_t att;
 
-	if (stereo) {
-		for (i = 0; i < samples; i++) {
-			l = buf[i * 2];
-			r = buf[i * 2 + 1];
-			l = (l * ll + r * rl) >> 7;
-			r = (r * rr + l * lr) >> 7;
-			ssat32_to_16(l);
-			ssat32_to_16(r);
-			buf[i * 2] = l;
-			buf[i * 2 + 1] = r;
-		}
-	}
-	else {
-		for (i = 0; i < samples; i++) {
-			l = buf[i];
-			l = l * (ll + rl) >> 7;
-			//r = r * (rr + lr) >> 7;
-			ssat32_to_16(l);
-			//ssat32_to_16(r);
-			buf[i] = l;
-		}
-	}
+	cdrGetAttenuation(&att);
+	xa_attenuate(buf, samples, stereo, &att);
 }
 
 void cdrReadInterrupt() {
@@ -1268,7 +1318,7 @@ if(use_vm){
 		// HACK: with BIAS 2, emulated CPU is often slower than real thing,
 		// game may be unfinished with prev data read, so reschedule
 		// (Brave Fencer Musashi)
-		CDREAD_INT(cdReadTime / 2);
+		CDREAD_INT(CdTimeRetry());
 		cdr.ReadRescheduled = 1;
 		return;
 	}
@@ -1294,7 +1344,7 @@ if(use_vm){
 		memset(cdr.Transfer, 0, DATA_SIZE);
 		cdr.Stat = DiskError;
 		cdr.Result[0] |= STATUS_ERROR;
-		CDREAD_INT((cdr.Mode & 0x80) ? (cdReadTime / 2) : cdReadTime);
+		CDREAD_INT(CdTimeRead());
 		return;
 	}
 
@@ -1315,10 +1365,13 @@ if(use_vm){
 		if((cdr.Transfer[4 + 2] & 0x4) &&
 			 (cdr.Transfer[4 + 1] == cdr.Channel) &&
 			 (cdr.Transfer[4 + 0] == cdr.File)) {
-			int ret = xa_decode_sector(&cdr.Xa, cdr.Transfer+4, cdr.FirstSector);
+			xa_atten_t att;
+			int ret;
+
+			cdrGetAttenuation(&att);
+			ret = xa_decode_sector_att(&cdr.Xa, cdr.Transfer+4, cdr.FirstSector, &att);
 			if (!ret) {
-				cdrAttenuate(cdr.Xa.pcm, cdr.Xa.nsamples, cdr.Xa.stereo);
-				SPU_playADPCMchannel(&cdr.Xa);
+				spuPlayADPCMchannel(&cdr.Xa);
 				cdr.FirstSector = 0;
 			}
 			else cdr.FirstSector = -1;
@@ -1338,7 +1391,11 @@ if(use_vm){
 	cdr.Readed = 0;
 	cdr.ReadRescheduled = 0;
 
-	CDREAD_INT((cdr.Mode & MODE_SPEED) ? (cdReadTime / 2) : cdReadTime);
+	// xa audio keeps the real rate for a while (fast load)
+	if ((cdr.Mode & MODE_STRSND) && (cdr.Transfer[4 + 2] & 0x4)) cdStreamHold = CD_STREAM_HOLD;
+	else if (cdStreamHold) cdStreamHold--;
+
+	CDREAD_INT(CdTimeRead());
 
 	/*
 	Croc 2: $40 - only FORM1 (*)
@@ -1730,6 +1787,7 @@ void cdrReset() {
 	cdr.Stat = NoIntr;
 	cdr.DriveState = DRIVESTATE_STANDBY;
 	cdr.StatP = STATUS_ROTATING;
+	cdStreamHold = 0;
 
 	// BIOS player - default values
 	cdr.AttenuatorLeftToLeft = 0x80;
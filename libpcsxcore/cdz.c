@@ -0,0 +1,216 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* CDZ reader, see cdz.h for the layout.
+*
+* A read finds its hunk from the offset (one division), the hunk comes
+* from a small lru cache of decompressed hunks or is read in one piece
+* and inflated into the least recently used entry. Sequential sector
+* reads hit the cache for the rest of the hunk, cdda and random access
+* cost at most one hunk.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "cdz.h"
+
+typedef struct {
+	int hunk;				// -1 empty
+	unsigned int used;		// lru stamp
+	unsigned int len;
+	unsigned char *data;
+} CdzEntry;
+
+struct CdzFile {
+	FILE *f;
+	unsigned int hunk_bytes;
+	unsigned int image_bytes;
+	unsigned int hunks;
+	unsigned int *offset;
+	unsigned char *packed;	// compressed hunk as read
+	unsigned int tick;
+	unsigned int hits, misses;
+	CdzEntry cache[CDZ_CACHE_HUNKS];
+};
+
+static unsigned int Get32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// whole sectors of one of the image layouts
+static int CdzHunkSize(unsigned int bytes) {
+	static const unsigned int sector[3] = { 2048, 2352, 2448 };
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (bytes % sector[i] == 0 && bytes / sector[i] >= 1 && bytes / sector[i] <= CDZ_MAX_HUNK_SECTORS)
+			return 1;
+	}
+	return 0;
+}
+
+CdzFile *CdzOpen(FILE *f) {
+	unsigned char h[CDZ_HEADER_BYTES];
+	unsigned char *idx;
+	CdzFile *cdz;
+	unsigned int i, data;
+	long size;
+
+	if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < CDZ_HEADER_BYTES ||
+		fseek(f, 0, SEEK_SET) != 0 || fread(h, 1, CDZ_HEADER_BYTES, f) != CDZ_HEADER_BYTES ||
+		memcmp(h, CDZ_MAGIC, 8) != 0 || Get32(h + 8) != CDZ_VERSION) {
+		return NULL;
+	}
+
+	cdz = (CdzFile *)calloc(1, sizeof(CdzFile));
+	if (cdz == NULL) return NULL;
+
+	cdz->f = f;
+	cdz->hunk_bytes = Get32(h + 12);
+	cdz->image_bytes = Get32(h + 16);
+	cdz->hunks = Get32(h + 20);
+
+	// sizes first, the index is allocated from them
+	if (!CdzHunkSize(cdz->hunk_bytes) || cdz->image_bytes > CDZ_MAX_IMAGE ||
+		cdz->hunks != (cdz->image_bytes + cdz->hunk_bytes - 1) / cdz->hunk_bytes ||
+		(unsigned long)size - CDZ_HEADER_BYTES < (cdz->hunks + 1) * 4UL) {
+		free(cdz);
+		return NULL;
+	}
+
+	cdz->offset = (unsigned int *)malloc((cdz->hunks + 1) * sizeof(unsigned int));
+	idx = (unsigned char *)malloc((cdz->hunks + 1) * 4);
+	cdz->packed = (unsigned char *)malloc(cdz->hunk_bytes);
+	if (cdz->offset == NULL || idx == NULL || cdz->packed == NULL ||
+		fread(idx, 4, cdz->hunks + 1, f) != cdz->hunks + 1) {
+		free(idx);
+		CdzClose(cdz);
+		return NULL;
+	}
+
+	for (i = 0; i <= cdz->hunks; i++) cdz->offset[i] = Get32(idx + i * 4);
+	free(idx);
+
+	// hunks after the index, in order, inside the file
+	data = CDZ_HEADER_BYTES + (cdz->hunks + 1) * 4;
+	for (i = 0; i <= cdz->hunks; i++) {
+		if (cdz->offset[i] < (i ? cdz->offset[i - 1] : data) || cdz->offset[i] > (unsigned long)size) {
+			CdzClose(cdz);
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < CDZ_CACHE_HUNKS; i++) {
+		cdz->cache[i].hunk = -1;
+		cdz->cache[i].data = (unsigned char *)malloc(cdz->hunk_bytes);
+		if (cdz->cache[i].data == NULL) {
+			CdzClose(cdz);
+			return NULL;
+		}
+	}
+
+	return cdz;
+}
+
+void CdzClose(CdzFile *cdz) {
+	int i;
+
+	if (cdz == NULL) return;
+
+	for (i = 0; i < CDZ_CACHE_HUNKS; i++) free(cdz->cache[i].data);
+	free(cdz->offset);
+	free(cdz->packed);
+	free(cdz);
+}
+
+unsigned int CdzSize(const CdzFile *cdz) {
+	return cdz->image_bytes;
+}
+
+void CdzGetStats(const CdzFile *cdz, unsigned int *hits, unsigned int *misses) {
+	*hits = cdz->hits;
+	*misses = cdz->misses;
+}
+
+// hunk from the cache, loaded into the lru entry on a miss
+static CdzEntry *CdzHunk(CdzFile *cdz, unsigned int hunk) {
+	CdzEntry *e, *lru = &cdz->cache[0];
+	unsigned int raw, packed;
+	uLongf out;
+	int i;
+
+	for (i = 0; i < CDZ_CACHE_HUNKS; i++) {
+		e = &cdz->cache[i];
+		if (e->hunk == (int)hunk) {
+			e->used = ++cdz->tick;
+			cdz->hits++;
+			return e;
+		}
+		if (e->used < lru->used || e->hunk < 0) lru = e;
+	}
+
+	e = lru;
+	e->hunk = -1;
+	cdz->misses++;
+
+	raw = cdz->image_bytes - hunk * cdz->hunk_bytes;
+	if (raw > cdz->hunk_bytes) raw = cdz->hunk_bytes;
+	packed = cdz->offset[hunk + 1] - cdz->offset[hunk];
+	if (packed > raw || fseek(cdz->f, cdz->offset[hunk], SEEK_SET) != 0) return NULL;
+
+	if (packed == raw) {
+		if (fread(e->data, 1, raw, cdz->f) != raw) return NULL;
+	}
+	else {
+		out = raw;
+		if (fread(cdz->packed, 1, packed, cdz->f) != packed ||
+			uncompress(e->data, &out, cdz->packed, packed) != Z_OK || out != raw) return NULL;
+	}
+
+	e->hunk = hunk;
+	e->len = raw;
+	e->used = ++cdz->tick;
+	return e;
+}
+
+unsigned int CdzRead(CdzFile *cdz, void *buf, unsigned int offset, unsigned int len) {
+	unsigned char *dst = (unsigned char *)buf;
+	unsigned int done = 0, pos, n;
+	CdzEntry *e;
+
+	if (offset >= cdz->image_bytes) return 0;
+	if (len > cdz->image_bytes - offset) len = cdz->image_bytes - offset;
+
+	// a sector spans at most two hunks
+	while (done < len) {
+		e = CdzHunk(cdz, (offset + done) / cdz->hunk_bytes);
+		if (e == NULL) break;
+
+		pos = (offset + done) % cdz->hunk_bytes;
+		n = e->len - pos;
+		if (n > len - done) n = len - done;
+		memcpy(dst + done, e->data + pos, n);
+		done += n;
+	}
+
+	return done;
+}
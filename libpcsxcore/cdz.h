@@ -0,0 +1,77 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* CDZ: a disc image (.bin/.img/.iso, any sector layout) cut in hunks of
+* fixed size that are deflated one by one, read by the iso plugin
+* (cdriso.c) and written by tools/cdzpack. The .cue/.toc/.ccd/.sub files
+* keep their names next to the .cdz.
+*
+* file layout, every integer little endian:
+*  char   magic[8]            "PCSXCDZ\0"
+*  u32    version             CDZ_VERSION
+*  u32    hunk_bytes          bytes of the image per hunk, whole sectors of
+*                             2048, 2352 or 2448 bytes
+*  u32    image_bytes         size of the image, at most CDZ_MAX_IMAGE
+*  u32    hunks               (image_bytes + hunk_bytes - 1) / hunk_bytes
+*  u32    offset[hunks + 1]   file offset of every hunk, the last one is
+*                             the end of the data; a hunk as long as its
+*                             image bytes is stored, else it is deflated
+*                             (zlib stream)
+*  hunk data
+*/
+
+#ifndef __CDZ_H__
+#define __CDZ_H__
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CDZ_MAGIC			"PCSXCDZ"
+#define CDZ_VERSION			1
+#define CDZ_HEADER_BYTES	24
+#define CDZ_HUNK_SECTORS	16		// converter default, hunk = 16 image sectors
+#define CDZ_MAX_HUNK_SECTORS	256
+#define CDZ_MAX_IMAGE		(99 * 60 * 75 * 2448)	// 99 minutes with subchannel
+#define CDZ_CACHE_HUNKS		8		// decompressed hunks kept (lru)
+
+typedef struct CdzFile CdzFile;
+
+// reads the index of an open image, NULL if it is not a cdz file; the
+// FILE stays owned by the caller and must outlive the CdzFile
+CdzFile *CdzOpen(FILE *f);
+void CdzClose(CdzFile *cdz);
+
+// size of the uncompressed image
+unsigned int CdzSize(const CdzFile *cdz);
+
+// len bytes of the image from offset, returns the bytes read (short at
+// the end of the image or on a damaged hunk)
+unsigned int CdzRead(CdzFile *cdz, void *buf, unsigned int offset, unsigned int len);
+
+// hunk cache hits and hunks decompressed so far
+void CdzGetStats(const CdzFile *cdz, unsigned int *hits, unsigned int *misses);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
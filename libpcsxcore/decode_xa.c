@@ -23,48 +23,25 @@
 
 #include "decode_xa.h"
 
-#define FIXED
-
-#define NOT(_X_)				(!(_X_))
-#define XACLAMP(_X_,_MI_,_MA_)	{if(_X_<_MI_)_X_=_MI_;if(_X_>_MA_)_X_=_MA_;}
+#include "adpcm.h"
+
+#if defined(_XBOX)
+#include <xtl.h>
+#define XA_VMX128
+#define XA_ALIGN	__declspec(align(16))	// __stvx targets
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XA_SSE2
+#endif
 
-#define SH	4
-#define SHC	10
+#ifndef XA_ALIGN
+#define XA_ALIGN
+#endif
 
 //============================================
 //===  ADPCM DECODING ROUTINES
 //============================================
 
-#ifndef FIXED
-static double K0[4] = {
-    0.0,
-    0.9375,
-    1.796875,
-    1.53125
-};
-
-static double K1[4] = {
-    0.0,
-    0.0,
-    -0.8125,
-    -0.859375
-};
-#else
-static int K0[4] = {
-	0.0       * (1<<SHC),
-	0.9375    * (1<<SHC),
-	1.796875  * (1<<SHC),
-	1.53125   * (1<<SHC)
-};
- 
-static int K1[4] = {
-	0.0       * (1<<SHC),
-	0.0       * (1<<SHC),
-	-0.8125   * (1<<SHC),
-	-0.859375 * (1<<SHC)
-};
-#endif
-
 #define BLKSIZ 28       /* block size (32 - 4 nibbles) */
 
 //===========================================
@@ -74,59 +51,32 @@ void ADPCM_InitDecode(ADPCM_Decode_t *decp) {
 }
 
 //===========================================
-#ifndef FIXED
-#define IK0(fid)	((int)((-K0[fid]) * (1<<SHC)))
-#define IK1(fid)	((int)((-K1[fid]) * (1<<SHC)))
-#else
-#define IK0(fid)	(-K0[fid])
-#define IK1(fid)	(-K1[fid])
-#endif
-
+// vblockp: 16 byte block as the SPU stores it, the sound unit nibbles
+// gathered in bytes 2..15. The filter math is the SPU voice decoder's.
 static __inline void ADPCM_DecodeBlock16( ADPCM_Decode_t *decp, u8 filter_range, const void *vblockp, short *destp, int inc ) {
 	int i;
 	int range, filterid;
-	s32 fy0, fy1;
-	const u16 *blockp;
+	int samples[BLKSIZ];
 
-	blockp = (const unsigned short *)vblockp;
-	filterid = (filter_range >>  4) & 0x0f;
+	filterid = (filter_range >>  4) & 0x03;	// xa only has filters 0..3
 	range    = (filter_range >>  0) & 0x0f;
 
-	fy0 = decp->y0;
-	fy1 = decp->y1;
-
-	for (i = BLKSIZ/4; i; --i) {
-		s32 y;
-		s32 x0, x1, x2, x3;
-
-		y = *blockp++;
-		x3 = (short)( y        & 0xf000) >> range; x3 <<= SH;
-		x2 = (short)((y <<  4) & 0xf000) >> range; x2 <<= SH;
-		x1 = (short)((y <<  8) & 0xf000) >> range; x1 <<= SH;
-		x0 = (short)((y << 12) & 0xf000) >> range; x0 <<= SH;
+	ADPCM_DecodeBlock_C( samples, (const u8 *)vblockp, range, filterid, &decp->y0, &decp->y1 );
 
-		x0 -= (IK0(filterid) * fy0 + (IK1(filterid) * fy1)) >> SHC; fy1 = fy0; fy0 = x0;
-		x1 -= (IK0(filterid) * fy0 + (IK1(filterid) * fy1)) >> SHC; fy1 = fy0; fy0 = x1;
-		x2 -= (IK0(filterid) * fy0 + (IK1(filterid) * fy1)) >> SHC; fy1 = fy0; fy0 = x2;
-		x3 -= (IK0(filterid) * fy0 + (IK1(filterid) * fy1)) >> SHC; fy1 = fy0; fy0 = x3;
-
-		XACLAMP( x0, -32768<<SH, 32767<<SH ); *destp = x0 >> SH; destp += inc;
-		XACLAMP( x1, -32768<<SH, 32767<<SH ); *destp = x1 >> SH; destp += inc;
-		XACLAMP( x2, -32768<<SH, 32767<<SH ); *destp = x2 >> SH; destp += inc;
-		XACLAMP( x3, -32768<<SH, 32767<<SH ); *destp = x3 >> SH; destp += inc;
-	}
-	decp->y0 = fy0;
-	decp->y1 = fy1;
+	for (i = 0; i < BLKSIZ; i++, destp += inc)
+		*destp = (short)samples[i];
 }
 
 static int headtable[4] = {0,2,8,10};
 
 //===========================================
-static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
+// scalar reference: every sound unit gathered into a 16 byte block for
+// the block decoder, written with a stride, attenuated in a second pass
+static void xa_decode_data_C( xa_decode_t *xdp, unsigned char *srcp ) {
 	const u8    *sound_groupsp;
 	const u8    *sound_datap, *sound_datap2;
 	int         i, j, k, nbits;
-	u16			data[4096], *datap;
+	u8			data[16] = {0}, *datap;
 	short		*destp;
 
 	destp = xdp->pcm;
@@ -139,22 +89,22 @@ static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
 				sound_datap = sound_groupsp + 16;	// sound data just after the header
 
 				for (i=0; i < nbits; i++) {
-    				datap = data;
+    				datap = data + 2;
     				sound_datap2 = sound_datap + i;
 
-					for (k=0; k < 14; k++, sound_datap2 += 8) {
-        	   				*(datap++) = (u16)sound_datap2[0] |
-        	               			     (u16)(sound_datap2[4] << 8);
+					for (k=0; k < 7; k++, sound_datap2 += 8) {
+        	   				*(datap++) = sound_datap2[0];
+        	   				*(datap++) = sound_datap2[4];
 					}
 
     				ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+0], data,
         	           				    destp+0, 2 );
 
-        			datap = data;
+        			datap = data + 2;
         			sound_datap2 = sound_datap + i;
-        			for (k=0; k < 14; k++, sound_datap2 += 8) {
-           					*(datap++) = (u16)sound_datap2[0] |
-            	          			     (u16)(sound_datap2[4] << 8);
+        			for (k=0; k < 7; k++, sound_datap2 += 8) {
+           					*(datap++) = sound_datap2[0];
+           					*(datap++) = sound_datap2[4];
 					}
 					ADPCM_DecodeBlock16( &xdp->right,  sound_groupsp[headtable[i]+1], data,
                            			    destp+1, 2 );
@@ -168,25 +118,21 @@ static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
 				sound_datap = sound_groupsp + 16;	// sound data just after the header
 
 				for (i=0; i < nbits; i++) {
-	    			datap = data;
+	    			datap = data + 2;
 	    			sound_datap2 = sound_datap + i;
 
         			for (k=0; k < 7; k++, sound_datap2 += 16) {
-           					*(datap++) = (u16)(sound_datap2[ 0] & 0x0f) |
-                       				    ((u16)(sound_datap2[ 4] & 0x0f) <<  4) |
-                       				    ((u16)(sound_datap2[ 8] & 0x0f) <<  8) |
-                       				    ((u16)(sound_datap2[12] & 0x0f) << 12);
+           					*(datap++) = (sound_datap2[ 0] & 0x0f) | ((sound_datap2[ 4] & 0x0f) << 4);
+           					*(datap++) = (sound_datap2[ 8] & 0x0f) | ((sound_datap2[12] & 0x0f) << 4);
 					}
 	    			ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+0], data,
                    				    destp+0, 2 );
 
-	        		datap = data;
+	        		datap = data + 2;
 	        		sound_datap2 = sound_datap + i;
         			for (k=0; k < 7; k++, sound_datap2 += 16) {
-           					*(datap++) = (u16)(sound_datap2[ 0] >> 4) |
-                       	    			((u16)(sound_datap2[ 4] >> 4) <<  4) |
-                       				    ((u16)(sound_datap2[ 8] >> 4) <<  8) |
-                       				    ((u16)(sound_datap2[12] >> 4) << 12);
+           					*(datap++) = (sound_datap2[ 0] >> 4) | ((sound_datap2[ 4] >> 4) << 4);
+           					*(datap++) = (sound_datap2[ 8] >> 4) | ((sound_datap2[12] >> 4) << 4);
 					}
 					ADPCM_DecodeBlock16( &xdp->right,  sound_groupsp[headtable[i]+1], data,
                            			    destp+1, 2 );
@@ -202,22 +148,22 @@ static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
     			sound_datap = sound_groupsp + 16;	// sound data just after the header
 
     			for (i=0; i < nbits; i++) {
-        			datap = data;
+        			datap = data + 2;
         			sound_datap2 = sound_datap + i;
-        			for (k=0; k < 14; k++, sound_datap2 += 8) {
-           					*(datap++) = (u16)sound_datap2[0] |
-                       				     (u16)(sound_datap2[4] << 8);
+        			for (k=0; k < 7; k++, sound_datap2 += 8) {
+           					*(datap++) = sound_datap2[0];
+           					*(datap++) = sound_datap2[4];
 					}
 	        		ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+0], data,
                            			    destp, 1 );
 
 	        		destp += 28;
 
-	        		datap = data;
+	        		datap = data + 2;
 	        		sound_datap2 = sound_datap + i;
-        			for (k=0; k < 14; k++, sound_datap2 += 8) {
-           					*(datap++) = (u16)sound_datap2[0] |
-                       				     (u16)(sound_datap2[4] << 8);
+        			for (k=0; k < 7; k++, sound_datap2 += 8) {
+           					*(datap++) = sound_datap2[0];
+           					*(datap++) = sound_datap2[4];
 					}
 	       			ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+1], data,
                            			    destp, 1 );
@@ -231,26 +177,22 @@ static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
 	    		sound_datap = sound_groupsp + 16;	// sound data just after the header
 
 	    		for (i=0; i < nbits; i++) {
-	        		datap = data;
+	        		datap = data + 2;
 	        		sound_datap2 = sound_datap + i;
         			for (k=0; k < 7; k++, sound_datap2 += 16) {
-           					*(datap++) = (u16)(sound_datap2[ 0] & 0x0f) |
-                       				    ((u16)(sound_datap2[ 4] & 0x0f) <<  4) |
-                       				    ((u16)(sound_datap2[ 8] & 0x0f) <<  8) |
-                       				    ((u16)(sound_datap2[12] & 0x0f) << 12);
+           					*(datap++) = (sound_datap2[ 0] & 0x0f) | ((sound_datap2[ 4] & 0x0f) << 4);
+           					*(datap++) = (sound_datap2[ 8] & 0x0f) | ((sound_datap2[12] & 0x0f) << 4);
 					}
 	        		ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+0], data,
                            			    destp, 1 );
 
 	        		destp += 28;
 
-	        		datap = data;
+	        		datap = data + 2;
 	        		sound_datap2 = sound_datap + i;
         			for (k=0; k < 7; k++, sound_datap2 += 16) {
-            				*(datap++) = (u16)(sound_datap2[ 0] >> 4) |
-                       	    		    ((u16)(sound_datap2[ 4] >> 4) <<  4) |
-                        				((u16)(sound_datap2[ 8] >> 4) <<  8) |
-                        				((u16)(sound_datap2[12] >> 4) << 12);
+            				*(datap++) = (sound_datap2[ 0] >> 4) | ((sound_datap2[ 4] >> 4) << 4);
+            				*(datap++) = (sound_datap2[ 8] >> 4) | ((sound_datap2[12] >> 4) << 4);
         			}
 	       			ADPCM_DecodeBlock16( &xdp->left,  sound_groupsp[headtable[i]+1], data,
                            			    destp, 1 );
@@ -262,6 +204,260 @@ static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp ) {
 	}
 }
 
+//============================================
+//===  CD ATTENUATION
+//============================================
+
+// volumes close to 0x80 without cross mix leave stereo as it is, all 0x40
+// leave mono as it is
+static int xa_atten_identity( const xa_atten_t *att, int stereo ) {
+	if (att->lr == 0 && att->rl == 0 && 0x78 <= att->ll && att->ll <= 0x88 && 0x78 <= att->rr && att->rr <= 0x88)
+		return 1;
+
+	if (!stereo && att->ll == 0x40 && att->lr == 0x40 && att->rl == 0x40 && att->rr == 0x40)
+		return 1;
+
+	return 0;
+}
+
+#define XA_SAT16(v) ((v) < -32768 ? -32768 : (v) > 32767 ? 32767 : (v))
+
+void xa_attenuate( s16 *buf, int samples, int stereo, const xa_atten_t *att ) {
+	int i, l, r;
+
+	if (att == NULL || xa_atten_identity(att, stereo))
+		return;
+
+	if (stereo) {
+		for (i = 0; i < samples; i++) {
+			l = buf[i * 2];
+			r = buf[i * 2 + 1];
+			l = (l * att->ll + r * att->rl) >> 7;
+			r = (r * att->rr + l * att->lr) >> 7;	// with the new left, as always
+			buf[i * 2] = XA_SAT16(l);
+			buf[i * 2 + 1] = XA_SAT16(r);
+		}
+	}
+	else {
+		for (i = 0; i < samples; i++) {
+			l = buf[i] * (att->ll + att->rl) >> 7;
+			buf[i] = XA_SAT16(l);
+		}
+	}
+}
+
+//============================================
+//===  FUSED DECODE
+//============================================
+
+/*
+* The sound group is read in place instead of being gathered into blocks:
+* its 112 data bytes are 28 rows of 4, the 4 bit units 2i and 2i+1 are the
+* low and high nibbles of column i. A vector holds 4 rows; a left shift
+* brings the wanted nibble to the top of each 32 bit lane, the bits below
+* are masked off and an arithmetic right shift by 16 + range gives
+* (nibble << 12) >> range, the expansion of the block decoder. adpcm.c runs the filter, then both
+* channels go out interleaved with the attenuation in the same loop.
+*
+* 8 bit (level A) groups keep the old reading: units 2i and 2i+1 both
+* decode column i, rows 0..13, low nibble first.
+*/
+
+#if defined(XA_VMX128)
+
+// unaligned load (lvlx/lvrx pair)
+#define VLOADU(p)	__vor(__lvlx((void *)(p), 0), __lvrx((void *)(p), 16))
+
+// big endian lanes: byte col is bits 31-8*col..24-8*col
+static __inline void XA_Shifts( __vector4 *up_lo, __vector4 *up_hi, __vector4 *down, int col, int range ) {
+	__declspec(align(16)) int sv[4];
+	__vector4 v;
+
+	sv[0] = 4 + 8 * col;
+	sv[1] = 8 * col;
+	sv[2] = 16 + range;
+	v = __lvx(sv, 0);
+	*up_lo = __vspltw(v, 0);
+	*up_hi = __vspltw(v, 1);
+	*down  = __vspltw(v, 2);
+}
+
+// 0xf0000000 in every lane (shift counts use the low 5 bits: -4 = 28)
+#define VTOPMASK()	__vslw(__vspltisw(-1), __vspltisw(-4))
+
+static void XA_Expand4( int *x, const u8 *data, int col, int hi, int range ) {
+	__vector4 up_lo, up_hi, up, down, top = VTOPMASK();
+	int k;
+
+	XA_Shifts(&up_lo, &up_hi, &down, col, range);
+	up = hi ? up_hi : up_lo;
+
+	for (k = 0; k < BLKSIZ; k += 4)
+		__stvx(__vsraw(__vand(__vslw(VLOADU(data + k * 4), up), top), down), x, k * 4);
+}
+
+static void XA_Expand8( int *x, const u8 *data, int col, int range ) {
+	__vector4 up_lo, up_hi, down, v, lo, hi, top = VTOPMASK();
+	int k;
+
+	XA_Shifts(&up_lo, &up_hi, &down, col, range);
+
+	for (k = 0; k < 16; k += 4) {
+		v  = VLOADU(data + k * 4);
+		lo = __vsraw(__vand(__vslw(v, up_lo), top), down);
+		hi = __vsraw(__vand(__vslw(v, up_hi), top), down);
+		__stvx(__vmrghw(lo, hi), x, k * 8);
+		__stvx(__vmrglw(lo, hi), x, k * 8 + 16);
+	}
+}
+
+const char *xa_kernel_name( void ) { return "vmx128"; }
+
+#elif defined(XA_SSE2)
+
+// little endian lanes: byte col is bits 8*col..8*col+7
+static void XA_Expand4( int *x, const u8 *data, int col, int hi, int range ) {
+	const __m128i up   = _mm_cvtsi32_si128(28 - 8 * col - (hi ? 4 : 0));
+	const __m128i down = _mm_cvtsi32_si128(16 + range);
+	const __m128i top  = _mm_set1_epi32(0xf0000000);
+	int k;
+
+	for (k = 0; k < BLKSIZ; k += 4)
+		_mm_storeu_si128((__m128i *)(x + k),
+			_mm_sra_epi32(_mm_and_si128(_mm_sll_epi32(_mm_loadu_si128((const __m128i *)(data + k * 4)), up), top), down));
+}
+
+static void XA_Expand8( int *x, const u8 *data, int col, int range ) {
+	const __m128i up_lo = _mm_cvtsi32_si128(28 - 8 * col);
+	const __m128i up_hi = _mm_cvtsi32_si128(24 - 8 * col);
+	const __m128i down  = _mm_cvtsi32_si128(16 + range);
+	const __m128i top   = _mm_set1_epi32(0xf0000000);
+	__m128i v, lo, hi;
+	int k;
+
+	for (k = 0; k < 16; k += 4) {
+		v  = _mm_loadu_si128((const __m128i *)(data + k * 4));
+		lo = _mm_sra_epi32(_mm_and_si128(_mm_sll_epi32(v, up_lo), top), down);
+		hi = _mm_sra_epi32(_mm_and_si128(_mm_sll_epi32(v, up_hi), top), down);
+		_mm_storeu_si128((__m128i *)(x + k * 2),     _mm_unpacklo_epi32(lo, hi));
+		_mm_storeu_si128((__m128i *)(x + k * 2 + 4), _mm_unpackhi_epi32(lo, hi));
+	}
+}
+
+const char *xa_kernel_name( void ) { return "sse2"; }
+
+#else
+
+static __inline int XA_Nibble( int n, int range ) {
+	int s = n << 12;
+
+	if (s & 0x8000) s |= 0xffff0000;
+	return s >> range;
+}
+
+static void XA_Expand4( int *x, const u8 *data, int col, int hi, int range ) {
+	int k;
+
+	for (k = 0; k < BLKSIZ; k++)
+		x[k] = XA_Nibble(hi ? data[k * 4 + col] >> 4 : data[k * 4 + col] & 0x0f, range);
+}
+
+static void XA_Expand8( int *x, const u8 *data, int col, int range ) {
+	int k;
+
+	for (k = 0; k < BLKSIZ / 2; k++) {
+		x[k * 2 + 0] = XA_Nibble(data[k * 4 + col] & 0x0f, range);
+		x[k * 2 + 1] = XA_Nibble(data[k * 4 + col] >> 4, range);
+	}
+}
+
+const char *xa_kernel_name( void ) { return "scalar"; }
+
+#endif
+
+// one sound unit: expansion, then the filter tail of adpcm.c
+static __inline void XA_DecodeUnit( int *dst, ADPCM_Decode_t *decp, u8 filter_range,
+									const u8 *data, int col, int hi, int level_a ) {
+	XA_ALIGN int x[32];
+
+	if (level_a) XA_Expand8(x, data, col, filter_range & 0x0f);
+	else XA_Expand4(x, data, col, hi, filter_range & 0x0f);
+
+	ADPCM_FilterBlock(dst, x, (filter_range >> 4) & 0x03, &decp->y0, &decp->y1);
+}
+
+static __inline void XA_StoreStereo( short *dst, const int *l, const int *r, const xa_atten_t *att ) {
+	int i, a, b;
+
+	if (att == NULL) {
+		for (i = 0; i < BLKSIZ; i++) {
+			dst[i * 2] = (short)l[i];
+			dst[i * 2 + 1] = (short)r[i];
+		}
+		return;
+	}
+
+	for (i = 0; i < BLKSIZ; i++) {
+		a = (l[i] * att->ll + r[i] * att->rl) >> 7;
+		b = (r[i] * att->rr + a * att->lr) >> 7;
+		dst[i * 2] = XA_SAT16(a);
+		dst[i * 2 + 1] = XA_SAT16(b);
+	}
+}
+
+static __inline void XA_StoreMono( short *dst, const int *l, const xa_atten_t *att ) {
+	int i, a, vol;
+
+	if (att == NULL) {
+		for (i = 0; i < BLKSIZ; i++) dst[i] = (short)l[i];
+		return;
+	}
+
+	vol = att->ll + att->rl;
+	for (i = 0; i < BLKSIZ; i++) {
+		a = l[i] * vol >> 7;
+		dst[i] = XA_SAT16(a);
+	}
+}
+
+// att NULL: no attenuation
+static void xa_decode_data( xa_decode_t *xdp, unsigned char *srcp, const xa_atten_t *att ) {
+	const u8	*group, *data;
+	int			i, j, n, level_a, written;
+	int			l[BLKSIZ], r[BLKSIZ];
+	short		*destp;
+
+	destp = xdp->pcm;
+	level_a = (xdp->nbits == 8) && (xdp->freq == 37800);
+	n = level_a ? 2 : 4;
+
+	for (j = 0; j < 18; j++) {
+		group = srcp + j * 128;		// sound group header
+		data = group + 16;			// sound data just after the header
+
+		for (i = 0; i < n; i++) {
+			if (xdp->stereo) {
+				XA_DecodeUnit(l, &xdp->left,  group[headtable[i] + 0], data, i, 0, level_a);
+				XA_DecodeUnit(r, &xdp->right, group[headtable[i] + 1], data, i, 1, level_a);
+				XA_StoreStereo(destp, l, r, att);
+			}
+			else {
+				XA_DecodeUnit(l, &xdp->left, group[headtable[i] + 0], data, i, 0, level_a);
+				XA_StoreMono(destp, l, att);
+				XA_DecodeUnit(l, &xdp->left, group[headtable[i] + 1], data, i, 1, level_a);
+				XA_StoreMono(destp + BLKSIZ, l, att);
+			}
+			destp += BLKSIZ * 2;
+		}
+	}
+
+	// level A fills half of nsamples, the old separate pass attenuated
+	// the rest of the buffer in place as well
+	written = (destp - xdp->pcm) >> xdp->stereo;
+	if (att != NULL && written < xdp->nsamples)
+		xa_attenuate(destp, xdp->nsamples - written, xdp->stereo, att);
+}
+
 //============================================
 //===  XA SPECIFIC ROUTINES
 //============================================
@@ -299,7 +495,9 @@ u8  coding2;
 static int parse_xa_audio_sector( xa_decode_t *xdp, 
 								  xa_subheader_t *subheadp,
 								  unsigned char *sectorp,
-								  int is_first_sector ) {
+								  int is_first_sector,
+								  const xa_atten_t *att,
+								  int reference ) {
     if ( is_first_sector ) {
 		switch ( AUDIO_CODING_GET_FREQ(subheadp->coding) ) {
 			case 0: xdp->freq = 37800;   break;
@@ -326,7 +524,15 @@ static int parse_xa_audio_sector( xa_decode_t *xdp,
 		xdp->nsamples = 18 * 28 * 8;
 		if (xdp->stereo == 1) xdp->nsamples /= 2;
     }
-	xa_decode_data( xdp, sectorp );
+
+	if (att != NULL && xa_atten_identity(att, xdp->stereo))
+		att = NULL;
+
+	if (reference) {
+		xa_decode_data_C( xdp, sectorp );
+		xa_attenuate( xdp->pcm, xdp->nsamples, xdp->stereo, att );
+	}
+	else xa_decode_data( xdp, sectorp, att );
 
 	return 0;
 }
@@ -342,7 +548,24 @@ static int parse_xa_audio_sector( xa_decode_t *xdp,
 //================================================================
 s32 xa_decode_sector( xa_decode_t *xdp,
 					   unsigned char *sectorp, int is_first_sector ) {
-	if (parse_xa_audio_sector(xdp, (xa_subheader_t *)sectorp, sectorp + sizeof(xa_subheader_t), is_first_sector))
+	return xa_decode_sector_att( xdp, sectorp, is_first_sector, NULL );
+}
+
+//=== same, the cd attenuation (att, NULL for none) applied to the output
+s32 xa_decode_sector_att( xa_decode_t *xdp,
+						  unsigned char *sectorp, int is_first_sector,
+						  const xa_atten_t *att ) {
+	if (parse_xa_audio_sector(xdp, (xa_subheader_t *)sectorp, sectorp + sizeof(xa_subheader_t), is_first_sector, att, 0))
+		return -1;
+
+	return 0;
+}
+
+//=== scalar reference of xa_decode_sector_att (verification)
+s32 xa_decode_sector_C( xa_decode_t *xdp,
+						unsigned char *sectorp, int is_first_sector,
+						const xa_atten_t *att ) {
+	if (parse_xa_audio_sector(xdp, (xa_subheader_t *)sectorp, sectorp + sizeof(xa_subheader_t), is_first_sector, att, 1))
 		return -1;
 
 	return 0;
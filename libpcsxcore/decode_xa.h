@@ -39,10 +39,33 @@ typedef struct {
 	short			pcm[16384];
 } xa_decode_t;
 
+// cd volume (cdrom.c attenuators), 0x80 = full
+typedef struct {
+	int				ll, lr, rl, rr;
+} xa_atten_t;
+
 s32 xa_decode_sector( xa_decode_t *xdp,
 					   unsigned char *sectorp,
 					   int is_first_sector );
 
+// decode with the attenuation applied in the same pass, att NULL for none
+s32 xa_decode_sector_att( xa_decode_t *xdp,
+						  unsigned char *sectorp,
+						  int is_first_sector,
+						  const xa_atten_t *att );
+
+// scalar reference: block decoder, then a separate attenuation pass
+s32 xa_decode_sector_C( xa_decode_t *xdp,
+						unsigned char *sectorp,
+						int is_first_sector,
+						const xa_atten_t *att );
+
+// attenuation alone, samples per channel
+void xa_attenuate( s16 *buf, int samples, int stereo, const xa_atten_t *att );
+
+// name of the kernel selected at compile time ("vmx128", "sse2", ...)
+const char *xa_kernel_name( void );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* Disc metadata cache, see discinfo.h for the file layout.
+*
+* The whole file is read into one array the first time a record is
+* needed (under a kilobyte per game, a 500 game library is one read of
+* about 400 KB) and written back in one piece when a record
+* changed. Lookups are a linear scan on the path crc, the game list gets
+* its stamps from the directory listing so listing a folder never opens
+* an image.
+*/
+
+#include <zlib.h>
+
+#include "discinfo.h"
+
+#if defined(_XBOX)
+#include <xtl.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static char diFile[MAXPATHLEN] = "";
+static DiscInfo *diRec = NULL;
+static int diCount = 0;
+static int diCap = 0;
+static int diLoaded = 0;
+static int diDirty = 0;
+static int diCurrent = -1;
+
+static u32 PathCrc(const char *path) {
+	char low[MAXPATHLEN];
+	int i;
+
+	for (i = 0; path[i] != '\0' && i < MAXPATHLEN - 1; i++)
+		low[i] = tolower((unsigned char)path[i]);
+
+	return (u32)crc32(0L, (const Bytef *)low, i);
+}
+
+static void DiscInfoLoad(void) {
+	FILE *f;
+	char magic[4];
+	u32 h[3];
+
+	diLoaded = 1;
+	diCount = 0;
+
+	f = fopen(diFile, "rb");
+	if (f == NULL) return;
+
+	if (fread(magic, 1, 4, f) != 4 || memcmp(magic, DISCINFO_MAGIC, 4) != 0 ||
+		fread(h, sizeof(u32), 3, f) != 3 ||
+		h[0] != DISCINFO_VERSION || h[1] != sizeof(DiscInfo) || h[2] > 0x10000) {
+		// other version or damaged, start over
+		fclose(f);
+		return;
+	}
+
+	if (h[2] > 0) {
+		diRec = (DiscInfo *)malloc(h[2] * sizeof(DiscInfo));
+		if (diRec != NULL) {
+			diCap = h[2];
+			diCount = fread(diRec, sizeof(DiscInfo), h[2], f);
+		}
+	}
+
+	fclose(f);
+}
+
+void DiscInfoInit(const char *file) {
+	DiscInfoShutdown();
+
+	if (file != NULL) {
+		strncpy(diFile, file, MAXPATHLEN - 1);
+		diFile[MAXPATHLEN - 1] = '\0';
+	}
+	else diFile[0] = '\0';
+}
+
+void DiscInfoShutdown(void) {
+	DiscInfoSave();
+
+	free(diRec);
+	diRec = NULL;
+	diCount = diCap = 0;
+	diLoaded = 0;
+	diDirty = 0;
+	diCurrent = -1;
+}
+
+int DiscInfoStamp(const char *path, DiscStamp *st) {
+#if defined(_XBOX) || defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fad)) return -1;
+
+	st->sizeLo = fad.nFileSizeLow;
+	st->sizeHi = fad.nFileSizeHigh;
+	st->timeLo = fad.ftLastWriteTime.dwLowDateTime;
+	st->timeHi = fad.ftLastWriteTime.dwHighDateTime;
+#else
+	struct stat s;
+
+	if (stat(path, &s) != 0) return -1;
+
+	st->sizeLo = (u32)s.st_size;
+	st->sizeHi = (u32)((u64)s.st_size >> 32);
+	st->timeLo = (u32)s.st_mtime;
+	st->timeHi = (u32)((u64)s.st_mtime >> 32);
+#endif
+	return 0;
+}
+
+static int Find(u32 crc, const DiscStamp *st) {
+	int i;
+
+	if (!diLoaded) DiscInfoLoad();
+
+	for (i = 0; i < diCount; i++) {
+		if (diRec[i].pathCrc == crc) {
+			if (st != NULL && memcmp(&diRec[i].image, st, sizeof(DiscStamp)) != 0) return -2; // stale
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+DiscInfo *DiscInfoOpen(const char *image) {
+	DiscStamp st;
+	DiscInfo *p;
+	u32 crc;
+	int i;
+
+	diCurrent = -1;
+
+	if (diFile[0] == '\0' || DiscInfoStamp(image, &st) != 0) return NULL;
+
+	crc = PathCrc(image);
+	i = Find(crc, &st);
+	if (i >= 0) {
+		diCurrent = i;
+		return &diRec[i];
+	}
+
+	if (i == -2) {
+		// image changed: reuse its record
+		for (i = 0; diRec[i].pathCrc != crc; i++);
+	}
+	else {
+		if (diCount == diCap) {
+			int cap = diCap ? diCap * 2 : 64;
+
+			p = (DiscInfo *)realloc(diRec, cap * sizeof(DiscInfo));
+			if (p == NULL) return NULL;
+			diRec = p;
+			diCap = cap;
+		}
+		i = diCount++;
+	}
+
+	memset(&diRec[i], 0, sizeof(DiscInfo));
+	diRec[i].pathCrc = crc;
+	diRec[i].image = st;
+	diDirty = 1;
+
+	diCurrent = i;
+	return &diRec[i];
+}
+
+DiscInfo *DiscInfoCurrent(void) {
+	return diCurrent >= 0 ? &diRec[diCurrent] : NULL;
+}
+
+void DiscInfoClose(void) {
+	diCurrent = -1;
+}
+
+const DiscInfo *DiscInfoPeek(const char *image, const DiscStamp *st) {
+	int i;
+
+	if (diFile[0] == '\0') return NULL;
+
+	i = Find(PathCrc(image), st);
+	return i >= 0 ? &diRec[i] : NULL;
+}
+
+// the sheet is the image path with its end replaced: keep how many bytes
+// go and what comes instead
+void DiscInfoSetSheet(DiscInfo *di, const char *image, const char *sheet) {
+	size_t n = 0, cut;
+
+	memset(&di->sheet, 0, sizeof(DiscStamp));
+	di->sheetCut = 0;
+	memset(di->sheetExt, 0, sizeof(di->sheetExt));
+	diDirty = 1;
+
+	if (sheet[0] == '\0') return;
+
+	while (image[n] != '\0' && image[n] == sheet[n]) n++;
+	cut = strlen(image) - n;
+	if (cut > 255 || strlen(sheet + n) >= sizeof(di->sheetExt) || cut + strlen(sheet + n) == 0 ||
+		DiscInfoStamp(sheet, &di->sheet) != 0) {
+		di->flags &= ~DISCINFO_LAYOUT;		// no name for it, parse again next time
+		return;
+	}
+
+	di->sheetCut = (u8)cut;
+	strcpy(di->sheetExt, sheet + n);
+}
+
+int DiscInfoSheetValid(const DiscInfo *di, const char *image) {
+	char sheet[MAXPATHLEN];
+	size_t len = strlen(image);
+	DiscStamp st;
+
+	if (di->sheetCut == 0 && di->sheetExt[0] == '\0') return 1;
+	if (di->sheetCut > len || len - di->sheetCut + strlen(di->sheetExt) >= MAXPATHLEN) return 0;
+
+	memcpy(sheet, image, len - di->sheetCut);
+	strcpy(sheet + len - di->sheetCut, di->sheetExt);
+	if (DiscInfoStamp(sheet, &st) != 0) return 0;
+
+	return memcmp(&st, &di->sheet, sizeof(DiscStamp)) == 0;
+}
+
+void DiscInfoTouch(void) {
+	diDirty = 1;
+}
+
+void DiscInfoSave(void) {
+	FILE *f;
+	u32 h[3];
+
+	if (!diDirty || diFile[0] == '\0') return;
+	diDirty = 0;
+
+	f = fopen(diFile, "wb");
+	if (f == NULL) return;
+
+	h[0] = DISCINFO_VERSION;
+	h[1] = sizeof(DiscInfo);
+	h[2] = diCount;
+
+	fwrite(DISCINFO_MAGIC, 1, 4, f);
+	fwrite(h, sizeof(u32), 3, f);
+	if (diCount > 0) fwrite(diRec, sizeof(DiscInfo), diCount, f);
+
+	fclose(f);
+}
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2007 Ryan Schultz, PCSX-df Team, PCSX team              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+* Disc metadata cache: what cdriso.c gets from the cue/ccd/mds/toc sheet
+* (track table, subchannel and sector layout) and what CheckCdrom gets
+* from the iso9660 directory (game id, label, boot executable), one
+* record per image in a single file. A record belongs to an image while
+* its path, size and modification time match, the track table also
+* needs the sheet file unchanged.
+*
+* file layout (native byte order, it never leaves the machine):
+*  char     magic[4]          "PDIC"
+*  u32      version           DISCINFO_VERSION
+*  u32      record_bytes      sizeof(DiscInfo)
+*  u32      count
+*  DiscInfo record[count]
+*/
+
+#ifndef __DISCINFO_H__
+#define __DISCINFO_H__
+
+#include "psxcommon.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISCINFO_MAGIC		"PDIC"
+#define DISCINFO_VERSION	2
+#define DISCINFO_TRACKS		100		// MAXTRACKS of cdriso.c, entry 0 unused
+
+// DiscInfo.flags
+#define DISCINFO_LAYOUT		0x01	// track table and layout bits valid
+#define DISCINFO_BOOT		0x02	// id, label and exe valid
+#define DISCINFO_SUBMIXED	0x10
+#define DISCINFO_SUBRAW		0x20
+#define DISCINFO_MODE1		0x40
+#define DISCINFO_CDDABE		0x80
+
+typedef struct {
+	u32 sizeLo, sizeHi;
+	u32 timeLo, timeHi;		// FILETIME on windows, st_mtime elsewhere
+} DiscStamp;
+
+typedef struct {
+	u8 type;				// cdriso.c trackinfo: 1 data, 2 audio
+	u8 start[3];			// msf
+	u8 length[3];			// msf
+} DiscTrack;
+
+typedef struct {
+	u32 pathCrc;			// crc32 of the lower case image path
+	DiscStamp image;
+	DiscStamp sheet;
+	u8 sheetCut;			// sheet path: the image path without its last
+	char sheetExt[7];		// sheetCut bytes, then sheetExt; both 0: none
+	u8 flags;
+	u8 numtracks;
+	u8 pal;					// id is a PAL serial (CheckCdrom rule)
+	u8 exeTime[3];			// bcd msf of the boot executable
+	char id[10];			// CdromId
+	char label[33];			// CdromLabel
+	DiscTrack track[DISCINFO_TRACKS];
+} DiscInfo;
+
+// cache file to use, NULL or "" turns the cache off; loaded on first use
+void DiscInfoInit(const char *file);
+// writes pending changes and frees the records
+void DiscInfoShutdown(void);
+
+// size and modification time of a file, -1 if it cannot be read
+int DiscInfoStamp(const char *path, DiscStamp *st);
+
+// record of an image that is being opened: the matching one, or an empty
+// one replacing a stale record. It becomes the current record. NULL when
+// the cache is off or the image cannot be stat'ed.
+DiscInfo *DiscInfoOpen(const char *image);
+// record of the image opened last, NULL if none or closed since
+DiscInfo *DiscInfoCurrent(void);
+void DiscInfoClose(void);
+// lookup without adding anything, for game lists: st is the stamp the
+// caller already has (FindFirstFile data); valid until the next open
+const DiscInfo *DiscInfoPeek(const char *image, const DiscStamp *st);
+
+// sheet file the track table came from, "" for none; a sheet that is not
+// named after the image clears DISCINFO_LAYOUT
+void DiscInfoSetSheet(DiscInfo *di, const char *image, const char *sheet);
+// the sheet next to image is still the one the track table came from
+int DiscInfoSheetValid(const DiscInfo *di, const char *image);
+// a record was changed, DiscInfoSave writes the file
+void DiscInfoTouch(void);
+void DiscInfoSave(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -52,55 +52,12 @@ static volatile uint32_t dma_addr;
 static __declspec(align(128)) uint32_t tw_ring[TW_RING_MAX_COUNT];
 static volatile  __declspec(align(128))  uint64_t tw_idx[2] = {0,0};
 
-// Taken from PEOPS SOFTGPU
-u32 lUsedAddr[3];
-
 #define GPUDMA_INT(eCycle) { \
 	psxRegs.interrupt |= (1 << PSXINT_GPUDMA); \
 	psxRegs.intCycle[PSXINT_GPUDMA].cycle = eCycle; \
 	psxRegs.intCycle[PSXINT_GPUDMA].sCycle = psxRegs.cycle; \
 }
 
-__inline boolean CheckForEndlessLoop(u32 laddr) {
-	if (laddr == lUsedAddr[1]) return TRUE;
-	if (laddr == lUsedAddr[2]) return TRUE;
-
-	if (laddr < lUsedAddr[0]) lUsedAddr[1] = laddr;
-	else lUsedAddr[2] = laddr;
-
-	lUsedAddr[0] = laddr;
-
-	return FALSE;
-}
-
-static u32 gpuDmaChainSize(u32 addr) {
-	u32 size;
-	u32 DMACommandCounter = 0;
-	lUsedAddr[0] = lUsedAddr[1] = lUsedAddr[2] = 0xffffff;
-
-	// initial linked list ptr (word)
-	size = 1;
-
-	do {
-		addr &= 0x1ffffc;
-
-		if (DMACommandCounter++ > 2000000) break;
-		if (CheckForEndlessLoop(addr)) break;
-
-
-		// # 32-bit blocks to transfer
-		size += psxMu8_2( addr + 3 );
-
-		
-		// next 32-bit pointer
-		addr = psxMu32_2( addr & ~0x3 ) & 0xffffff;
-		size += 1;
-	} while (addr != 0xffffff);
-
-	
-	return size;
-}
-
 __inline static void WaitForGpuThread() {
     while(gpu_thread_running||tw_ring_count(tw_idx)>0) {
 		YieldProcessor(); // or r31, r31, r31
@@ -174,40 +131,88 @@ void threadedgpuWriteData(uint32_t * pMem, int size) {
 
 ////////////////////////////////////////////////////////////gpu.c
 
-// Classic call !
-void gpuDmaChain(uint32_t addr)
-{
-	uint32_t dmaMem;
-	uint32_t * baseAddrL;
-	unsigned char * baseAddrB;
-	short count;
-	unsigned int DMACommandCounter = 0;
+// Linked list walker (dma chain)
+// One pass does it all: the packets are gathered in a batch that goes to
+// the gpu (thread ring or plugin) in one call, the size for the dma irq
+// timing is counted on the way, and a bitmap over psx ram stops lists
+// that loop (a node reached twice loops forever). Only the touched words
+// of the bitmap are cleared afterwards.
 
-	 baseAddrL = (u32 *)psxM_2;
+#define DMA_RAMWORDS	(0x200000 >> 2)
+#define DMA_BATCH		4096
 
+static u32 dma_visited[DMA_RAMWORDS / 32];
+static u32 dma_dirty[DMA_RAMWORDS / 32 / 32];
+static __declspec(align(128)) u32 dma_batch[DMA_BATCH];
 
-	lUsedAddr[0]=lUsedAddr[1]=lUsedAddr[2]=0xffffff;
+__inline static boolean CheckForEndlessLoop(u32 laddr) {
+	u32 n = laddr >> 2;
+	u32 w = n >> 5;
+	u32 b = 1u << (n & 31);
 
-	baseAddrB = (unsigned char*) baseAddrL;
+	if (dma_visited[w] & b) return TRUE;
 
-	do
-	{
-		addr&=0x1FFFFC;
-		if(DMACommandCounter++ > 2000000) break;
-		if(CheckForEndlessLoop(addr)) break;
+	dma_visited[w] |= b;
+	dma_dirty[w >> 5] |= 1u << (w & 31);
 
-		count = baseAddrB[addr+3];
+	return FALSE;
+}
 
-		dmaMem=addr+4;
+static void ClearEndlessLoopCheck() {
+	u32 i, j, d;
 
-		if(count>0) {
-			// Call threaded gpu func
-			threadedgpuWriteData(&baseAddrL[dmaMem>>2],count);
-		}
+	for (i = 0; i < DMA_RAMWORDS / 32 / 32; i++) {
+		d = dma_dirty[i];
+		if (!d) continue;
 
-		addr = psxMu32_2( addr & ~0x3 ) & 0xffffff;
+		dma_dirty[i] = 0;
+		for (j = i << 5; d; j++, d >>= 1) {
+			if (d & 1) dma_visited[j] = 0;
+		}
 	}
-	while (addr != 0xffffff);
+}
+
+static u32 gpuDmaChain(u32 addr) {
+	u32 *baseAddrL = (u32 *)psxM_2;
+	u32 hdr, node, count, size;
+	u32 batch = 0;
+	u32 DMACommandCounter = 0;
+
+	// initial linked list ptr (word)
+	size = 1;
+
+	do {
+		node = addr & 0x1ffffc;
+
+		if (DMACommandCounter++ > 2000000) break;
+		if (CheckForEndlessLoop(node)) break;
+
+		hdr = SWAP32(baseAddrL[node >> 2]);
+		count = hdr >> 24;
+		addr = hdr & 0xffffff;
+
+		// next node: let the cache fetch it while this packet gets copied
+		if (addr != 0xffffff) __dcbt(0, &psxM_2[addr & 0x1ffffc]);
+
+		if (count > 0) {
+			if (batch + count > DMA_BATCH) {
+				// Call threaded gpu func
+				threadedgpuWriteData(dma_batch, batch);
+				batch = 0;
+			}
+			memcpy(&dma_batch[batch], &baseAddrL[(node >> 2) + 1], count << 2);
+			batch += count;
+		}
+
+		// # 32-bit blocks to transfer + next 32-bit pointer
+		size += count + 1;
+	} while (addr != 0xffffff);
+
+	if (batch) threadedgpuWriteData(dma_batch, batch);
+
+	ClearEndlessLoopCheck();
+
+	return size;
 }
 
 void gpuReadDataMem(uint32_t * addr, int size) {
@@ -382,9 +387,7 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 			PSXDMA_LOG("*** DMA 2 - GPU dma chain *** %lx addr = %lx size = %lx\n", chcr, madr, bcr);
 #endif
 
-			size = gpuDmaChainSize(madr);
-
-	        gpuDmaChain(madr & 0x1fffff);
+			size = gpuDmaChain(madr & 0x1fffff);
 			
 			// Tekken 3 = use 1.0 only (not 1.5x)
 
@@ -25,6 +25,9 @@
 #include "cdrom.h"
 #include "mdec.h"
 #include "ppf.h"
+#include "cdriso.h"
+#include "discinfo.h"
+#include "bootcache.h"
 
 char CdromId[10] = "";
 char CdromLabel[33] = "";
@@ -139,15 +142,22 @@ int GetCdromFile(u8 *mdir, u8 *time, s8 *filename) {
 	return 0;
 }
 
-int LoadCdrom() {
-	EXE_HEADER tmpHead;
+// header of the boot executable (SYSTEM.CNF BOOT line, else PSX.EXE),
+// time is left on its sector
+static int ReadCdromExeHeader(u8 *time, EXE_HEADER *head) {
 	struct iso_directory_record *dir;
-	u8 time[4], *buf;
+	DiscInfo *di;
+	u8 *buf;
 	u8 mdir[4096];
 	s8 exename[256];
 
-	if (!Config.HLE) {
-		if (!Config.SlowBoot) psxRegs.pc = psxRegs.GPR.n.ra;
+	di = cdrIsoActive() ? DiscInfoCurrent() : NULL;
+	if (di != NULL && (di->flags & DISCINFO_BOOT)) {
+		// CheckCdrom found (or had cached) the executable, no directory walk
+		memcpy(time, di->exeTime, 3);
+
+		READTRACK();
+		memcpy(head, buf + 12, sizeof(EXE_HEADER));
 		return 0;
 	}
 
@@ -197,7 +207,31 @@ int LoadCdrom() {
 		READTRACK();
 	}
 
-	memcpy(&tmpHead, buf + 12, sizeof(EXE_HEADER));
+	memcpy(head, buf + 12, sizeof(EXE_HEADER));
+	return 0;
+}
+
+int GetCdromExeHeader(EXE_HEADER *head) {
+	u8 time[4];
+
+	return ReadCdromExeHeader(time, head);
+}
+
+int LoadCdrom() {
+	EXE_HEADER tmpHead;
+	u8 time[4], *buf;
+
+	if (!Config.HLE) {
+		if (!Config.SlowBoot) {
+			psxRegs.pc = psxRegs.GPR.n.ra;
+
+			// straight to the game's entry point when it was booted before
+			BootCacheBoot();
+		}
+		return 0;
+	}
+
+	if (ReadCdromExeHeader(time, &tmpHead) == -1) return -1;
 
 	psxRegs.pc = SWAP32(tmpHead.pc0);
 	psxRegs.GPR.n.gp = SWAP32(tmpHead.gp0);
@@ -286,24 +320,40 @@ int LoadCdromFile(const char *filename, EXE_HEADER *head) {
 	return 0;
 }
 
+int CdromIdIsPal(const char *id) {
+	return (id[2] == 'e') || (id[2] == 'E') ||
+		!strncmp(id, "PBPX95001", 10) || // according to redump.org, these PAL
+		!strncmp(id, "PBPX95007", 10) || // demos have a non-standard ID;
+		!strncmp(id, "PBPX95008", 10);   // add more serials if they are discovered.
+}
+
 int CheckCdrom() {
 	struct iso_directory_record *dir;
 	unsigned char time[4], *buf;
 	unsigned char mdir[4096];
 	char exename[256];
+	DiscInfo *di;
 	int i, c;
 
 	FreePPFCache();
 
+	CdromLabel[0] = '\0';
+	CdromId[0] = '\0';
+
+	// image checked before: id, label and executable from the cache
+	di = cdrIsoActive() ? DiscInfoCurrent() : NULL;
+	if (di != NULL && (di->flags & DISCINFO_BOOT)) {
+		memcpy(CdromLabel, di->label, sizeof(CdromLabel));
+		memcpy(CdromId, di->id, sizeof(CdromId));
+		goto have_id;
+	}
+
 	time[0] = itob(0);
 	time[1] = itob(2);
 	time[2] = itob(0x10);
 
 	READTRACK();
 
-	CdromLabel[0] = '\0';
-	CdromId[0] = '\0';
-
 	strncpy(CdromLabel, buf + 52, 32);
 
 	// skip head and sub, and go to the root directory record
@@ -353,18 +403,27 @@ int CheckCdrom() {
 		}
 	}
 
+	if (CdromLabel[0] == ' ') {
+		strncpy(CdromLabel, CdromId, 9);
+	}
+
+	if (di != NULL) {
+		memcpy(di->label, CdromLabel, sizeof(di->label));
+		memcpy(di->id, CdromId, sizeof(di->id));
+		memcpy(di->exeTime, time, 3);
+		di->pal = CdromIdIsPal(CdromId);
+		di->flags |= DISCINFO_BOOT;
+		DiscInfoTouch();
+		DiscInfoSave();
+	}
+
+have_id:
 	if (Config.PsxAuto) { // autodetect system (pal or ntsc)
-		if((CdromId[2] == 'e') || (CdromId[2] == 'E') ||
-			!strncmp(CdromId, "PBPX95001", 10) || // according to redump.org, these PAL
-			!strncmp(CdromId, "PBPX95007", 10) || // demos have a non-standard ID;
-			!strncmp(CdromId, "PBPX95008", 10))   // add more serials if they are discovered.
+		if (CdromIdIsPal(CdromId))
 			Config.PsxType = PSX_TYPE_PAL; // pal
 		else Config.PsxType = PSX_TYPE_NTSC; // ntsc
 	}
 
-	if (CdromLabel[0] == ' ') {
-		strncpy(CdromLabel, CdromId, 9);
-	}
 	SysPrintf(_("CD-ROM Label: %.32s\n"), CdromLabel);
 	SysPrintf(_("CD-ROM ID: %.9s\n"), CdromId);
 
@@ -539,16 +598,12 @@ static const char PcsxHeader[32] = "STv4 PCSX v" PACKAGE_VERSION;
 // If you make changes to the savestate version, please increment the value below.
 static const u32 SaveVersion = 0x8b410006;
 
-int SaveState(const char *file) {
-	gzFile f;
+int SaveStateGz(gzFile f) {
 	GPUFreeze_t *gpufP;
 	SPUFreeze_t *spufP;
 	int Size;
 	unsigned char *pMem;
 
-	f = gzopen(file, "wb");
-	if (f == NULL) return -1;
-
 	gzwrite(f, (void *)PcsxHeader, 32);
 	gzwrite(f, (void *)&SaveVersion, sizeof(u32));
 	gzwrite(f, (void *)&Config.HLE, sizeof(boolean));
@@ -581,11 +636,11 @@ int SaveState(const char *file) {
 
 	// spu
 	spufP = (SPUFreeze_t *) malloc(16);
-	SPU_freeze(2, spufP);
+	spuFreeze(2, spufP);
 	Size = spufP->Size; gzwrite(f, &Size, 4);
 	free(spufP);
 	spufP = (SPUFreeze_t *) malloc(Size);
-	SPU_freeze(1, spufP);
+	spuFreeze(1, spufP);
 	gzwrite(f, spufP, Size);
 	free(spufP);
 
@@ -595,13 +650,24 @@ int SaveState(const char *file) {
 	psxRcntFreeze(f, 1);
 	mdecFreeze(f, 1);
 
-	gzclose(f);
-
 	return 0;
 }
 
-int LoadState(const char *file) {
+int SaveState(const char *file) {
 	gzFile f;
+	int ret;
+
+	f = gzopen(file, "wb");
+	if (f == NULL) return -1;
+
+	ret = SaveStateGz(f);
+
+	gzclose(f);
+
+	return ret;
+}
+
+int LoadStateGz(gzFile f) {
 	GPUFreeze_t *gpufP;
 	SPUFreeze_t *spufP;
 	int Size;
@@ -609,17 +675,12 @@ int LoadState(const char *file) {
 	u32 version;
 	boolean hle;
 
-	f = gzopen(file, "rb");
-	if (f == NULL) return -1;
-
 	gzread(f, header, sizeof(header));
 	gzread(f, &version, sizeof(u32));
 	gzread(f, &hle, sizeof(boolean));
 
-	if (strncmp("STv4 PCSX", header, 9) != 0 || version != SaveVersion || hle != Config.HLE) {
-		gzclose(f);
+	if (strncmp("STv4 PCSX", header, 9) != 0 || version != SaveVersion || hle != Config.HLE)
 		return -1;
-	}
 
 	psxCpu->Reset();
 	gzseek(f, 128 * 96 * 3, SEEK_CUR);
@@ -647,7 +708,7 @@ int LoadState(const char *file) {
 	gzread(f, &Size, 4);
 	spufP = (SPUFreeze_t *)malloc(Size);
 	gzread(f, spufP, Size);
-	SPU_freeze(0, spufP);
+	spuFreeze(0, spufP);
 	free(spufP);
 
 	sioFreeze(f, 0);
@@ -656,9 +717,21 @@ int LoadState(const char *file) {
 	psxRcntFreeze(f, 0);
 	mdecFreeze(f, 0);
 
+	return 0;
+}
+
+int LoadState(const char *file) {
+	gzFile f;
+	int ret;
+
+	f = gzopen(file, "rb");
+	if (f == NULL) return -1;
+
+	ret = LoadStateGz(f);
+
 	gzclose(f);
 
-	return 0;
+	return ret;
 }
 
 int CheckState(const char *file) {
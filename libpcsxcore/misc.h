@@ -59,6 +59,8 @@ extern char CdromLabel[33];
 int LoadCdrom();
 int LoadCdromFile(const char *filename, EXE_HEADER *head);
 int CheckCdrom();
+int GetCdromExeHeader(EXE_HEADER *head);
+int CdromIdIsPal(const char *id);
 int Load(const char *ExePath);
 
 char * getgameID();
@@ -66,6 +68,9 @@ int fileExists(const char * filename);
 
 int SaveState(const char *file);
 int LoadState(const char *file);
+// same on a stream the caller has open, positioned at the state
+int SaveStateGz(gzFile f);
+int LoadStateGz(gzFile f);
 int CheckState(const char *file);
 
 int SendPcsxInfo();
@@ -301,7 +301,7 @@ static int LoadCDRplugin(const char *CDRdll) {
 	void *drv;
 
 	if (CDRdll == NULL) {
-		cdrIsoInit();
+		cdrIsoMapInit();
 		return 0;
 	}
 
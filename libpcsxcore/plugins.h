@@ -241,6 +241,17 @@ extern SPUregisterCallback SPU_registerCallback;
 extern SPUasync            SPU_async;
 extern SPUplayCDDAchannel  SPU_playCDDAchannel;
 
+// SPU calls of the core (spu.c), queued to the spu thread when it runs
+void spuWriteRegister(u32 add, u16 value);
+u16  spuReadRegister(u32 add);
+void spuWriteDMAMem(u16 *pMem, int size);
+void spuReadDMAMem(u16 *pMem, int size);
+void spuPlayADPCMchannel(xa_decode_t *xap);
+void spuPlayCDDAchannel(short *pcm, int nbytes);
+void spuRegisterCallback(void (CALLBACK *callback)(void));
+void spuAsync(u32 cycle);
+long spuFreeze(u32 ulFreezeMode, SPUFreeze_t *pF);
+
 // PAD Functions
 typedef long (CALLBACK* PADconfigure)(void);
 typedef void (CALLBACK* PADabout)(void);
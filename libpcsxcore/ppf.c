@@ -24,158 +24,223 @@
 #include "ppf.h"
 #include "cdrom.h"
 
-typedef struct tagPPF_DATA {
-	s32					addr;
-	s32					pos;
-	s32					anz;
-	struct tagPPF_DATA	*pNext;
-} PPF_DATA;
-
-typedef struct tagPPF_CACHE {
-	s32					addr;
-	struct tagPPF_DATA	*pNext;
-} PPF_CACHE;
-
-static PPF_CACHE		*ppfCache = NULL;
-static PPF_DATA			*ppfHead = NULL, *ppfLast = NULL;
-static int				iPPFNum = 0;
-
-// using a linked data list, and address array
-static void FillPPFCache() {
-	PPF_DATA		*p;
-	PPF_CACHE		*pc;
-	s32				lastaddr;
-
-	p = ppfHead;
-	lastaddr = -1;
-	iPPFNum = 0;
-
-	while (p != NULL) {
-		if (p->addr != lastaddr) iPPFNum++;
-		lastaddr = p->addr;
-		p = p->pNext;
-	}
+/*
+* PPF and SBI data end up in one overlay, built once when the disc is
+* checked: a sorted table of the patched sectors, each pointing at its
+* run of ppf records (position, length, bytes in ppfData, packed in
+* sector order), plus a bitmap with a bit per sector up to the last
+* patched one. Almost every sector read stops at the bitmap test.
+*/
+
+// len bytes at pos of a raw sector, the bytes at ppfData + data
+typedef struct {
+	s32					sector;
+	u16					pos;
+	u16					len;
+	u32					data;
+	u32					order;		// position in the patch file, sort tie break
+} PPF_REC;
+
+typedef struct {
+	s32					sector;
+	u32					rec;		// first ppf record
+	u32					count;		// ppf records
+	u32					sbi;		// listed in the .sbi file
+} PATCH_SECTOR;
+
+static PPF_REC			*ppfRec = NULL;
+static u32				ppfRecNum = 0, ppfRecMax = 0;
+static u8				*ppfData = NULL;
+static u32				ppfDataLen = 0, ppfDataMax = 0;
+
+static s32				*sbiSector = NULL;
+static u32				sbiNum = 0, sbiMax = 0;
+
+static PATCH_SECTOR		*patchTable = NULL;
+static u32				patchNum = 0;
+static u32				*patchMap = NULL;	// bit per sector below patchMapSectors
+static u32				patchMapSectors = 0;
+
+static void FreeOverlay() {
+	free(patchTable);
+	free(patchMap);
+	patchTable = NULL;
+	patchMap = NULL;
+	patchNum = 0;
+	patchMapSectors = 0;
+}
 
-	if (iPPFNum <= 0) return;
+// same order the old linked list had: by sector and position, a later
+// record at the same position goes first (so the earlier one wins)
+static int ComparePPFRec(const void *a, const void *b) {
+	const PPF_REC *x = (const PPF_REC *)a, *y = (const PPF_REC *)b;
 
-	pc = ppfCache = (PPF_CACHE *)malloc(iPPFNum * sizeof(PPF_CACHE));
+	if (x->sector != y->sector) return x->sector < y->sector ? -1 : 1;
+	if (x->pos != y->pos) return x->pos < y->pos ? -1 : 1;
+	return x->order > y->order ? -1 : (x->order < y->order);
+}
 
-	iPPFNum--;
-	p = ppfHead;
-	lastaddr = -1;
+static int CompareSector(const void *a, const void *b) {
+	s32 x = *(const s32 *)a, y = *(const s32 *)b;
 
-	while (p != NULL) {
-		if (p->addr != lastaddr) {
-			pc->addr = p->addr;
-			pc->pNext = p;
-			pc++;
-		}
-		lastaddr = p->addr;
-		p = p->pNext;
-	}
+	return x < y ? -1 : (x > y);
 }
 
-void FreePPFCache() {
-	PPF_DATA *p = ppfHead;
-	void *pn;
+// merges the (sorted) ppf records and sbi sectors into the sector table
+static void BuildOverlay() {
+	PATCH_SECTOR	*p;
+	u32				i = 0, j = 0;
+	s32				sector;
 
-	while (p != NULL) {
-		pn = p->pNext;
-		free(p);
-		p = (PPF_DATA *)pn;
+	FreeOverlay();
+
+	if (ppfRecNum + sbiNum == 0) return;
+
+	patchTable = (PATCH_SECTOR *)malloc((ppfRecNum + sbiNum) * sizeof(PATCH_SECTOR));
+	if (patchTable == NULL) return;
+
+	while (i < ppfRecNum || j < sbiNum) {
+		if (j >= sbiNum || (i < ppfRecNum && ppfRec[i].sector <= sbiSector[j])) sector = ppfRec[i].sector;
+		else sector = sbiSector[j];
+
+		p = &patchTable[patchNum++];
+		p->sector = sector;
+		p->rec = i;
+		p->count = 0;
+		p->sbi = 0;
+		while (i < ppfRecNum && ppfRec[i].sector == sector) { i++; p->count++; }
+		while (j < sbiNum && sbiSector[j] == sector) { j++; p->sbi = 1; }
 	}
-	ppfHead = NULL;
-	ppfLast = NULL;
 
-	if (ppfCache != NULL) free(ppfCache);
-	ppfCache = NULL;
+	patchMapSectors = patchTable[patchNum - 1].sector + 1;
+	patchMap = (u32 *)calloc((patchMapSectors + 31) / 32, sizeof(u32));
+	if (patchMap == NULL) {
+		FreeOverlay();
+		return;
+	}
+
+	for (i = 0; i < patchNum; i++) {
+		sector = patchTable[i].sector;
+		patchMap[sector >> 5] |= 1u << (sector & 31);
+	}
 }
 
-void CheckPPFCache(unsigned char *pB, unsigned char m, unsigned char s, unsigned char f) {
-	PPF_CACHE *pcstart, *pcend, *pcpos;
-	int addr = MSF2SECT(btoi(m), btoi(s), btoi(f)), pos, anz, start;
+// identity of the loaded ppf and sbi data, 0 without patches
+u32 PatchCrc() {
+	uLong crc;
 
-	if (ppfCache == NULL) return;
+	if (patchNum == 0) return 0;
 
-	pcstart = ppfCache;
-	if (addr < pcstart->addr) return;
-	pcend = ppfCache + iPPFNum;
-	if (addr > pcend->addr) return;
+	crc = crc32(0L, (const Bytef *)patchTable, patchNum * sizeof(PATCH_SECTOR));
+	crc = crc32(crc, (const Bytef *)ppfRec, ppfRecNum * sizeof(PPF_REC));
+	crc = crc32(crc, (const Bytef *)ppfData, ppfDataLen);
 
-	while (1) {
-		if (addr == pcend->addr) { pcpos = pcend; break; }
+	return crc != 0 ? (u32)crc : 1;
+}
 
-		pcpos = pcstart + (pcend - pcstart) / 2;
-		if (pcpos == pcstart) break;
-		if (addr < pcpos->addr) {
-			pcend = pcpos;
-			continue;
-		}
-		if (addr > pcpos->addr) {
-			pcstart = pcpos;
-			continue;
-		}
-		break;
+static PATCH_SECTOR *FindPatch(s32 sector) {
+	u32 lo, hi, mid;
+
+	if (sector < 0 || (u32)sector >= patchMapSectors ||
+		!(patchMap[sector >> 5] & (1u << (sector & 31)))) return NULL;
+
+	lo = 0;
+	hi = patchNum;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (patchTable[mid].sector < sector) lo = mid + 1;
+		else hi = mid;
 	}
 
-	if (addr == pcpos->addr) {
-		PPF_DATA *p = pcpos->pNext;
-		while (p != NULL && p->addr == addr) {
-			pos = p->pos - (CD_FRAMESIZE_RAW - DATA_SIZE);
-			anz = p->anz;
-			if (pos < 0) { start = -pos; pos = 0; anz -= start; }
-			else start = 0;
-			memcpy(pB + pos, (unsigned char *)(p + 1) + start, anz);
-			p = p->pNext;
+	return &patchTable[lo];
+}
+
+// sorts the records and packs their bytes in the same order
+static void FillPPFCache() {
+	u8	*data;
+	u32	i, len = 0;
+
+	if (ppfRecNum == 0) return;
+
+	qsort(ppfRec, ppfRecNum, sizeof(PPF_REC), ComparePPFRec);
+
+	data = (u8 *)malloc(ppfDataLen);
+	if (data != NULL) {
+		for (i = 0; i < ppfRecNum; i++) {
+			memcpy(data + len, ppfData + ppfRec[i].data, ppfRec[i].len);
+			ppfRec[i].data = len;
+			len += ppfRec[i].len;
 		}
+		free(ppfData);
+		ppfData = data;
+		ppfDataMax = ppfDataLen;
 	}
+
+	BuildOverlay();
 }
 
-static void AddToPPF(s32 ladr, s32 pos, s32 anz, unsigned char *ppfmem) {
-	if (ppfHead == NULL) {
-		ppfHead = (PPF_DATA *)malloc(sizeof(PPF_DATA) + anz);
-		ppfHead->addr = ladr;
-		ppfHead->pNext = NULL;
-		ppfHead->pos = pos;
-		ppfHead->anz = anz;
-		memcpy(ppfHead + 1, ppfmem, anz);
-		iPPFNum = 1;
-		ppfLast = ppfHead;
-	} else {
-		PPF_DATA *p = ppfHead;
-		PPF_DATA *plast = NULL;
-		PPF_DATA *padd;
-
-		if (ladr > ppfLast->addr || (ladr == ppfLast->addr && pos > ppfLast->pos)) {
-			p = NULL;
-			plast = ppfLast;
-		} else {
-			while (p != NULL) {
-				if (ladr < p->addr) break;
-				if (ladr == p->addr) {
-					while (p && ladr == p->addr && pos > p->pos) {
-						plast = p;
-						p = p->pNext;
-					}
-					break;
-				}
-				plast = p;
-				p = p->pNext;
-			}
-		}
+void FreePPFCache() {
+	FreeOverlay();
+
+	free(ppfRec);
+	free(ppfData);
+	ppfRec = NULL;
+	ppfData = NULL;
+	ppfRecNum = ppfRecMax = 0;
+	ppfDataLen = ppfDataMax = 0;
+
+	free(sbiSector);
+	sbiSector = NULL;
+	sbiNum = sbiMax = 0;
+}
+
+void CheckPPFCache(unsigned char *pB, unsigned char m, unsigned char s, unsigned char f) {
+	PATCH_SECTOR *p = FindPatch(MSF2SECT(btoi(m), btoi(s), btoi(f)));
+	PPF_REC *r, *end;
+	int pos, anz, start;
+
+	if (p == NULL) return;
+
+	for (r = ppfRec + p->rec, end = r + p->count; r < end; r++) {
+		pos = r->pos - (CD_FRAMESIZE_RAW - DATA_SIZE);
+		anz = r->len;
+		if (pos < 0) { start = -pos; pos = 0; anz -= start; }
+		else start = 0;
+		if (anz > 0) memcpy(pB + pos, ppfData + r->data + start, anz);
+	}
+}
 
-		padd = (PPF_DATA *)malloc(sizeof(PPF_DATA) + anz);
-		padd->addr = ladr;
-		padd->pNext = p;
-		padd->pos = pos;
-		padd->anz = anz;
-		memcpy(padd + 1, ppfmem, anz);
-		iPPFNum++;
-		if (plast == NULL) ppfHead = padd;
-		else plast->pNext = padd;
-
-		if (padd->pNext == NULL) ppfLast = padd;
+static void AddToPPF(s32 ladr, s32 pos, s32 anz, unsigned char *ppfmem) {
+	PPF_REC *r;
+	void *n;
+	u32 max;
+
+	if (anz <= 0) return;
+
+	if (ppfRecNum == ppfRecMax) {
+		max = ppfRecMax ? ppfRecMax * 2 : 256;
+		n = realloc(ppfRec, max * sizeof(PPF_REC));
+		if (n == NULL) return;
+		ppfRec = (PPF_REC *)n;
+		ppfRecMax = max;
+	}
+	if (ppfDataLen + anz > ppfDataMax) {
+		max = ppfDataMax ? ppfDataMax * 2 : 16384;
+		n = realloc(ppfData, max);
+		if (n == NULL) return;
+		ppfData = (u8 *)n;
+		ppfDataMax = max;
 	}
+
+	r = &ppfRec[ppfRecNum];
+	r->sector = ladr;
+	r->pos = (u16)pos;
+	r->len = (u16)anz;
+	r->data = ppfDataLen;
+	r->order = ppfRecNum++;
+
+	memcpy(ppfData + ppfDataLen, ppfmem, anz);
+	ppfDataLen += anz;
 }
 
 void BuildPPFCache() {
@@ -327,17 +392,18 @@ void BuildPPFCache() {
 
 	fclose(ppffile);
 
-	FillPPFCache(); // build address array
+	FillPPFCache(); // sort, build the overlay
 
 	SysPrintf(_("Loaded PPF %d.0 patch: %s.\n"), method + 1, szPPF);
 }
 
 // redump.org SBI files
-static u8 sbitime[256][3], sbicount;
-
 void LoadSBI() {
 	FILE *sbihandle;
 	char buffer[16], sbifile[MAXPATHLEN];
+	u8 t[3];
+	s32 sector;
+	void *n;
 
 	// Generate filename in the format of SLUS_123.45.sbi
 	buffer[0] = toupper(CdromId[0]);
@@ -360,33 +426,42 @@ void LoadSBI() {
 	sprintf(sbifile, "%s%s", Config.PatchesDir, buffer);
 
 	// init
-	sbicount = 0;
+	sbiNum = 0;
 
 	sbihandle = fopen(sbifile, "rb");
-	if (sbihandle == NULL) return;
+	if (sbihandle == NULL) {
+		BuildOverlay();
+		return;
+	}
 
-	// 4-byte SBI header
+	// 4-byte SBI header, then 3 bytes of time (bcd) and 11 of subq data
 	fread(buffer, 1, 4, sbihandle);
-	while (!feof(sbihandle)) {
-		fread(sbitime[sbicount++], 1, 3, sbihandle);
+	while (fread(t, 1, 3, sbihandle) == 3) {
 		fread(buffer, 1, 11, sbihandle);
+
+		sector = MSF2SECT(btoi(t[0]), btoi(t[1]), btoi(t[2]));
+		if (sector < 0) continue;
+
+		if (sbiNum == sbiMax) {
+			n = realloc(sbiSector, (sbiMax ? sbiMax * 2 : 64) * sizeof(s32));
+			if (n == NULL) break;
+			sbiSector = (s32 *)n;
+			sbiMax = sbiMax ? sbiMax * 2 : 64;
+		}
+		sbiSector[sbiNum++] = sector;
 	}
 
 	fclose(sbihandle);
 
+	qsort(sbiSector, sbiNum, sizeof(s32), CompareSector);
+	BuildOverlay();
+
 	SysPrintf(_("Loaded SBI file: %s.\n"), sbifile);
 }
 
 boolean CheckSBI(const u8 *time) {
-	int lcv;
-
-	// both BCD format
-	for (lcv = 0; lcv < sbicount; lcv++) {
-		if (time[0] == sbitime[lcv][0] && 
-				time[1] == sbitime[lcv][1] && 
-				time[2] == sbitime[lcv][2])
-			return TRUE;
-	}
+	// bcd format
+	PATCH_SECTOR *p = FindPatch(MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2])));
 
-	return FALSE;
+	return (p != NULL && p->sbi) ? TRUE : FALSE;
 }
@@ -26,6 +26,7 @@ extern "C" {
 void BuildPPFCache();
 void FreePPFCache();
 void CheckPPFCache(unsigned char *pB, unsigned char m, unsigned char s, unsigned char f);
+u32 PatchCrc();
 
 void LoadSBI();
 boolean CheckSBI(const u8 *time);
@@ -53,10 +53,24 @@ typedef struct {
     
     unsigned int start_time;
     
+    // Audio (amostrado a cada 1 segundo)
+    unsigned int audio_fill_ms;
+    unsigned int audio_underruns;
+    unsigned int audio_dropped;
+    
+    // CD read-ahead: ultimo segundo e desde o inicio
+    unsigned long cd_hits, cd_misses, cd_stall_us;     // totais na ultima amostra
+    unsigned long cd_hits_start, cd_misses_start, cd_stall_start;
+    unsigned int cd_sec_hits, cd_sec_reads, cd_sec_stall_ms;
+    
 } ProfilerState;
 
 static ProfilerState g_profiler;
 
+// Fica fora do estado: Profiler_Init limpa o estado, a fonte e registrada antes
+static ProfilerAudioStats g_audio_stats = NULL;
+static ProfilerCdStats g_cd_stats = NULL;
+
 // ============================================================================
 // Funcoes Internas
 // ============================================================================
@@ -77,10 +91,54 @@ static void GenerateLogFilename(void) {
             ticks);
 }
 
+// Le o anel de saida do som; fill em frames (44100 Hz) -> ms
+static void SampleAudio(void) {
+    unsigned long fill, underruns, dropped;
+    
+    if (!g_audio_stats || !g_audio_stats(&fill, &underruns, &dropped)) {
+        return;
+    }
+    
+    g_profiler.audio_fill_ms = (unsigned int)(fill * 10 / 441);
+    g_profiler.audio_underruns = (unsigned int)underruns;
+    g_profiler.audio_dropped = (unsigned int)dropped;
+}
+
+// Le os contadores do read-ahead; first = 1 so guarda a base (inicio do log)
+static void SampleCd(int first) {
+    unsigned long hits, misses, stall;
+    
+    if (!g_cd_stats || !g_cd_stats(&hits, &misses, &stall)) {
+        return;
+    }
+    
+    if (first) {
+        g_profiler.cd_hits_start = hits;
+        g_profiler.cd_misses_start = misses;
+        g_profiler.cd_stall_start = stall;
+    } else {
+        g_profiler.cd_sec_hits = (unsigned int)(hits - g_profiler.cd_hits);
+        g_profiler.cd_sec_reads = g_profiler.cd_sec_hits + (unsigned int)(misses - g_profiler.cd_misses);
+        g_profiler.cd_sec_stall_ms = (unsigned int)((stall - g_profiler.cd_stall_us) / 1000);
+    }
+    
+    g_profiler.cd_hits = hits;
+    g_profiler.cd_misses = misses;
+    g_profiler.cd_stall_us = stall;
+}
+
 // ============================================================================
 // Funcoes Publicas
 // ============================================================================
 
+void Profiler_SetAudioStats(ProfilerAudioStats get) {
+    g_audio_stats = get;
+}
+
+void Profiler_SetCdStats(ProfilerCdStats get) {
+    g_cd_stats = get;
+}
+
 void Profiler_Init(const char* game_id, const char* game_name) {
     (void)game_name;
     
@@ -139,6 +197,7 @@ void Profiler_Start(void) {
         g_profiler.last_calc_time = GetTickCount();
         g_profiler.last_frame_time = GetTickCount();
         g_profiler.frame_count = 0;
+        SampleCd(1);
     }
 }
 
@@ -148,10 +207,18 @@ void Profiler_Stop(void) {
     }
     
     if (g_profiler.log_file) {
-        unsigned int elapsed = (GetTickCount() - g_profiler.start_time) / 1000;
+        unsigned int elapsed;
         const char* region = (Config.PsxType == 0) ? "NTSC" : "PAL";
         int target_fps = (Config.PsxType == 0) ? 60 : 50;
-        float performance = (g_profiler.current_fps * 100.0f) / target_fps;
+        float performance;
+        unsigned long cd_hits, cd_reads;
+        
+        SampleAudio();
+        SampleCd(0);
+        cd_hits = g_profiler.cd_hits - g_profiler.cd_hits_start;
+        cd_reads = cd_hits + (g_profiler.cd_misses - g_profiler.cd_misses_start);
+        elapsed = (GetTickCount() - g_profiler.start_time) / 1000;
+        performance = (g_profiler.current_fps * 100.0f) / target_fps;
         
         fprintf(g_profiler.log_file,
                 "\n=================================================================\n"
@@ -161,13 +228,20 @@ void Profiler_Stop(void) {
                 "Region:     %s (Target: %d FPS)\n"
                 "Last FPS:   %u (%.1f%% of target)\n"
                 "Status:     %s\n"
+                "Audio:      %u underruns, %u frames dropped\n"
+                "CD:         %lu/%lu read-ahead hits, %lu ms stalled\n"
                 "=================================================================\n",
                 elapsed,
                 region,
                 target_fps,
                 g_profiler.current_fps,
                 performance,
-                (performance >= 95.0f) ? "GOOD" : (performance >= 80.0f) ? "BELOW TARGET" : "POOR");
+                (performance >= 95.0f) ? "GOOD" : (performance >= 80.0f) ? "BELOW TARGET" : "POOR",
+                g_profiler.audio_underruns,
+                g_profiler.audio_dropped,
+                cd_hits,
+                cd_reads,
+                (g_profiler.cd_stall_us - g_profiler.cd_stall_start) / 1000);
         fflush(g_profiler.log_file);
         
         fclose(g_profiler.log_file);
@@ -219,12 +293,19 @@ void Profiler_FrameEnd(void) {
     elapsed = now - g_profiler.last_calc_time;
     if (elapsed >= FPS_SAMPLE_INTERVAL) {
         g_profiler.current_fps = (g_profiler.frame_count * 1000) / elapsed;
+        SampleAudio();
+        SampleCd(0);
         
-        // Escreve no log
-        fprintf(g_profiler.log_file, "[%5u] FPS: %3u | Latency: %3u ms\n",
+        // Escreve no log (CD: leituras sequenciais servidas do read-ahead no ultimo segundo)
+        fprintf(g_profiler.log_file, "[%5u] FPS: %3u | Latency: %3u ms | Audio: %3u ms, %u underruns | CD: %u/%u hit, %u ms stall\n",
                 (now - g_profiler.start_time) / 1000,
                 g_profiler.current_fps,
-                g_profiler.frame_time_ms);
+                g_profiler.frame_time_ms,
+                g_profiler.audio_fill_ms,
+                g_profiler.audio_underruns,
+                g_profiler.cd_sec_hits,
+                g_profiler.cd_sec_reads,
+                g_profiler.cd_sec_stall_ms);
         fflush(g_profiler.log_file);
         
         // Reseta contador
@@ -245,6 +326,14 @@ unsigned int Profiler_GetLatency(void) {
     return g_profiler.frame_time_ms;
 }
 
+unsigned int Profiler_GetAudioFill(void) {
+    return g_profiler.audio_fill_ms;
+}
+
+unsigned int Profiler_GetAudioUnderruns(void) {
+    return g_profiler.audio_underruns;
+}
+
 // ============================================================================
 // Cleanup
 // ============================================================================
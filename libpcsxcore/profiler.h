@@ -34,6 +34,22 @@ void Profiler_FrameEnd(void);
 
 unsigned int Profiler_GetFPS(void);
 unsigned int Profiler_GetLatency(void);
+unsigned int Profiler_GetAudioFill(void);       // ms no anel de saida
+unsigned int Profiler_GetAudioUnderruns(void);
+
+// ============================================================================
+// Audio (anel de saida do plugin de som, ex: SoundGetStats do xaudio_2.cpp)
+// ============================================================================
+
+typedef int (*ProfilerAudioStats)(unsigned long* fill, unsigned long* underruns, unsigned long* dropped);
+void Profiler_SetAudioStats(ProfilerAudioStats get);
+
+// ============================================================================
+// CD (read-ahead da imagem, ex: cdrIsoGetStats do cdriso.c), contadores totais
+// ============================================================================
+
+typedef int (*ProfilerCdStats)(unsigned long* hits, unsigned long* misses, unsigned long* stall_us);
+void Profiler_SetCdStats(ProfilerCdStats get);
 
 // ============================================================================
 // Macros
@@ -23,6 +23,7 @@
 
 #include "cheat.h"
 #include "ppf.h"
+#include "sio.h"
 
 PcsxConfig Config;
 boolean NetOpened = FALSE;
@@ -47,6 +48,7 @@ void EmuShutdown() {
 	FreeCheatSearchMem();
 
 	FreePPFCache();
+	McdShutdown();
 
 	psxShutdown();
 }
@@ -57,6 +59,7 @@ void EmuUpdate() {
 		SysUpdate();
 
 	ApplyCheats();
+	McdUpdate();
 }
 
 void __Log(char *fmt, ...) {
@@ -139,6 +139,7 @@ typedef struct {
 	u8 Cpu; // CPU_DYNAREC or CPU_INTERPRETER
 	u8 PsxType; // PSX_TYPE_NTSC or PSX_TYPE_PAL
 	u8 CpuBias;
+	u8 CdFastLoad; // cd seek/read delays divided by this while no audio streams (0, 1: real)
 	boolean CpuRunning;
 	boolean Widescreen;
 #ifdef _WIN32
@@ -276,10 +276,7 @@ __inline void psxRcntUpdate()
         {
             spuSyncCount = 0;
 
-            if( SPU_async )
-            {
-                SPU_async( SpuUpdInterval[Config.PsxType] * rcnts[3].target );
-            }
+            spuAsync( SpuUpdInterval[Config.PsxType] * rcnts[3].target );
         }
         
         // VSync irq.
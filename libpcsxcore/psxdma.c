@@ -69,7 +69,7 @@ void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 #endif
 				break;
 			}
-			SPU_writeDMAMem(ptr, (bcr >> 16) * (bcr & 0xffff) * 2);
+			spuWriteDMAMem(ptr, (bcr >> 16) * (bcr & 0xffff) * 2);
 
 			// Jungle Book - 0-0.333x DMA
 			SPUDMA_INT((bcr >> 16) * (bcr & 0xffff) / 3);
@@ -91,7 +91,7 @@ void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 				break;
 			}
 			size = (bcr >> 16) * (bcr & 0xffff) * 2;
-			SPU_readDMAMem(ptr, size);
+			spuReadDMAMem(ptr, size);
 			psxCpu->Clear(madr, size);
 
 			SPUDMA_INT((bcr >> 16) * (bcr & 0xffff) / 2);
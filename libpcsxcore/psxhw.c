@@ -263,14 +263,14 @@ _WF(u32, mdecWrite1);
 * Spu
 **/
 static void SpuWriteRegister16(u32 add, u16 value) {
-	SPU_writeRegister(add, value);
+	spuWriteRegister(add, value);
 }
 
 static void SpuWriteRegister32(u32 add, u32 value) {
-	SPU_writeRegister(add, value&0xffff);
+	spuWriteRegister(add, value&0xffff);
 
 	// next 16bit
-	SPU_writeRegister(add+2, (value>>16)&0xffff);
+	spuWriteRegister(add+2, (value>>16)&0xffff);
 }
 
 
@@ -357,7 +357,7 @@ void psxHwInit() {
 
 	// Spu
 	for(i = 0x1c00; i < 0x1e00; i++) {
-		hw_read16_handler[i] = (hw_read16_t)SPU_readRegister;
+		hw_read16_handler[i] = (hw_read16_t)spuReadRegister;
 		hw_write16_handler[i] = (hw_write16_t)SpuWriteRegister16;
 		hw_write32_handler[i] = (hw_write32_t)SpuWriteRegister32;
 	}
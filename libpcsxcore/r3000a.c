@@ -25,6 +25,7 @@
 #include "mdec.h"
 #include "gpu.h"
 #include "gte.h"
+#include "spu.h"
 
 boolean use_vm;
 // extern boolean use_vm on psxcommon.h
@@ -131,6 +132,9 @@ void psxException(u32 code, u32 bd) {
 }
 
 void psxBranchTest() {
+
+	// spu irq raised on the spu thread
+	if (spu_irq_pending) spuIrqMerge();
 	
     // GameShark Sampler: Give VSync pin some delay before exception eats it
 /*
@@ -24,6 +24,12 @@
 #include "sio.h"
 #include <sys/stat.h>
 
+#if defined(_XBOX)
+#include <xtl.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
 // Status Flags
 #define TX_RDY		0x0001
 #define RX_RDY		0x0002
@@ -460,49 +466,342 @@ void sioInterrupt() {
 #endif
 }
 
+//============================================
+//===  MEMORY CARD WRITE-BACK
+//============================================
+
+/*
+* The cards live in Mcd1Data/Mcd2Data, a frame written by the game only
+* sets its bit in the dirty bitmap. A flush copies the dirty runs into a
+* second image (what the file holds) and writes that out as <card>.tmp,
+* which then replaces the card, so a card is never left half written.
+*
+* Flushes happen once the game has not written for MCD_IDLE ms, at the
+* latest MCD_MAXAGE ms after the first pending write, and on request
+* (McdFlush on disc change, McdShutdown). With threads they run on their
+* own thread and saving in game never waits for the storage; without,
+* McdUpdate checks the timers once per frame.
+*/
+
+#if defined(_XBOX) || defined(_WIN32)
+#define MCD_THREAD
+#endif
+
+#define MCD_FRAMES		(MCD_SIZE / 128)
+#define MCD_IDLE		500			// ms
+#define MCD_MAXAGE		3000		// ms
+#define MCD_POLL		250			// ms between timer checks of the thread
+
+typedef struct {
+	char path[MAXPATHLEN];			// "" while the card is not cached
+	char *data;						// Mcd1Data / Mcd2Data
+	u32 dirty[MCD_FRAMES / 32];		// frames written since the last flush
+	int ndirty;
+	u32 first, last;				// ticks of the oldest and newest pending write
+	int stale;						// a flush failed, the file is behind
+	int headLen;					// 0, 64 (.mem/.vgs) or 3904 (.gme)
+	char head[3904];				// file header as loaded
+	char disk[MCD_SIZE];			// card image as it goes to the file
+} McdCard;
+
+static McdCard mcdCard[2];
+
+#ifdef MCD_THREAD
+static CRITICAL_SECTION mcdLock;	// dirty bitmap
+static CRITICAL_SECTION mcdFlushLock;	// disk images and files
+static HANDLE mcdHandle = NULL;
+static HANDLE mcdEvent = NULL;
+static volatile int mcd_exit = 0;
+static volatile int mcd_force = 0;
+static int mcd_locks = 0;
+
+#define McdLock()			EnterCriticalSection(&mcdLock)
+#define McdUnlock()			LeaveCriticalSection(&mcdLock)
+#define McdFlushLock()		EnterCriticalSection(&mcdFlushLock)
+#define McdFlushUnlock()	LeaveCriticalSection(&mcdFlushLock)
+#else
+#define McdLock()
+#define McdUnlock()
+#define McdFlushLock()
+#define McdFlushUnlock()
+#endif
+
+static u32 McdTicks() {
+#ifdef MCD_THREAD
+	return GetTickCount();
+#else
+	return (u32)((u64)clock() * 1000 / CLOCKS_PER_SEC);
+#endif
+}
+
+// header size of a card file, the rest is the card
+static int McdHeadLen(char *str) {
+	struct stat buf;
+
+	if (stat(str, &buf) != -1) {
+		if (buf.st_size == MCD_SIZE + 64)
+			return 64;
+		else if (buf.st_size == MCD_SIZE + 3904)
+			return 3904;
+	}
+	return 0;
+}
+
+// a crash between removing the card and renaming the new one leaves only
+// the .tmp, which is complete at that point
+static void McdRecover(char *str) {
+	char tmp[MAXPATHLEN + 4];
+	struct stat buf;
+
+	if (stat(str, &buf) != -1) return;
+
+	sprintf(tmp, "%s.tmp", str);
+	if (stat(tmp, &buf) != -1 && buf.st_size >= MCD_SIZE) {
+		SysPrintf(_("Recovering memory card %s\n"), str);
+#ifdef MCD_THREAD
+		MoveFileA(tmp, str);
+#else
+		rename(tmp, str);
+#endif
+	}
+}
+
+static int McdReplace(McdCard *c) {
+	char tmp[MAXPATHLEN + 4];
+	FILE *f;
+	int ok;
+
+	sprintf(tmp, "%s.tmp", c->path);
+
+	f = fopen(tmp, "wb");
+	if (f == NULL) return 0;
+
+	ok = (c->headLen == 0 || fwrite(c->head, 1, c->headLen, f) == (size_t)c->headLen) &&
+		fwrite(c->disk, 1, MCD_SIZE, f) == MCD_SIZE;
+	if (fclose(f) != 0) ok = 0;
+
+	if (!ok) {
+		remove(tmp);
+		return 0;
+	}
+
+#ifdef MCD_THREAD
+	// no replacing rename here: McdRecover covers the gap
+	DeleteFileA(c->path);
+	return MoveFileA(tmp, c->path) ? 1 : 0;
+#else
+	return rename(tmp, c->path) == 0;
+#endif
+}
+
+static void McdWriteCard(McdCard *c) {
+	int i, n;
+
+	McdFlushLock();
+
+	// closed since the thread looked at it
+	if (c->path[0] == '\0') {
+		McdFlushUnlock();
+		return;
+	}
+
+	McdLock();
+	for (i = 0; i < MCD_FRAMES; i += n) {
+		if (c->dirty[i >> 5] == 0) {
+			n = 32 - (i & 31);
+			continue;
+		}
+
+		// one copy per run of dirty frames
+		for (n = 0; i + n < MCD_FRAMES && (c->dirty[(i + n) >> 5] & (1u << ((i + n) & 31))); n++)
+			c->dirty[(i + n) >> 5] &= ~(1u << ((i + n) & 31));
+
+		if (n > 0) memcpy(c->disk + i * 128, c->data + i * 128, n * 128);
+		else n = 1;
+	}
+	if (c->ndirty && !c->stale) c->stale = 1;
+	c->ndirty = 0;
+	McdUnlock();
+
+	if (c->stale) {
+		if (McdReplace(c)) c->stale = 0;
+		else {
+			if (c->stale == 1)
+				SysPrintf(_("Memory card %s could not be saved, retrying\n"), c->path);
+			c->stale = 2;
+
+			McdLock();
+			c->last = McdTicks();
+			McdUnlock();
+		}
+	}
+
+	McdFlushUnlock();
+}
+
+static void McdPoll(int force) {
+	McdCard *c;
+	u32 now = McdTicks();
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		c = &mcdCard[i];
+		if (c->path[0] == '\0' || (c->ndirty == 0 && !c->stale)) continue;
+
+		// a failed flush counts as a write, it is retried after MCD_IDLE
+		if (!force && now - c->last < MCD_IDLE && (c->ndirty == 0 || now - c->first < MCD_MAXAGE))
+			continue;
+
+		McdWriteCard(c);
+	}
+}
+
+#ifdef MCD_THREAD
+static void mcdThread() {
+	while (!mcd_exit) {
+		WaitForSingleObject(mcdEvent, MCD_POLL);
+
+		if (mcd_force) {
+			mcd_force = 0;
+			McdPoll(1);
+		}
+		else McdPoll(0);
+	}
+
+	ExitThread(0);
+}
+#endif
+
+static void McdStart() {
+#ifdef MCD_THREAD
+	if (!mcd_locks) {
+		InitializeCriticalSection(&mcdLock);
+		InitializeCriticalSection(&mcdFlushLock);
+		mcd_locks = 1;
+	}
+
+	if (mcdHandle) return;
+
+	mcd_exit = 0;
+	mcd_force = 0;
+	mcdEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	mcdHandle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)mcdThread, NULL, CREATE_SUSPENDED, NULL);
+#ifdef _XBOX
+	XSetThreadProcessor(mcdHandle, 5);
+#endif
+	ResumeThread(mcdHandle);
+#endif
+}
+
+// writes what is pending and drops the card from the cache
+static void McdClose(McdCard *c) {
+	if (c->path[0] == '\0') return;
+
+	McdFlushLock();
+	McdWriteCard(c);
+	if (c->stale)
+		SysPrintf(_("Memory card %s could not be saved, the last changes are lost\n"), c->path);
+	c->path[0] = '\0';
+	McdFlushUnlock();
+}
+
+static void McdOpen(McdCard *c, char *str, char *data) {
+	McdStart();
+
+	// the path goes in last, the thread skips the card until then
+	McdFlushLock();
+	c->path[0] = '\0';
+	c->data = data;
+	memset(c->dirty, 0, sizeof(c->dirty));
+	c->ndirty = 0;
+	c->stale = 0;
+	memcpy(c->disk, data, MCD_SIZE);
+	strncpy(c->path, str, MAXPATHLEN - 1);
+	c->path[MAXPATHLEN - 1] = '\0';
+	McdFlushUnlock();
+}
+
+static McdCard *McdCardOf(char *mcd, char *data) {
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (mcdCard[i].path[0] != '\0' && mcdCard[i].data == data && strcmp(mcdCard[i].path, mcd) == 0)
+			return &mcdCard[i];
+	}
+	return NULL;
+}
+
+void McdFlush() {
+#ifdef MCD_THREAD
+	if (mcdHandle) {
+		mcd_force = 1;
+		SetEvent(mcdEvent);
+		return;
+	}
+#endif
+	McdPoll(1);
+}
+
+void McdUpdate() {
+#ifdef MCD_THREAD
+	if (mcdHandle) return;
+#endif
+	McdPoll(0);
+}
+
+void McdShutdown() {
+#ifdef MCD_THREAD
+	if (mcdHandle) {
+		mcd_exit = 1;
+		SetEvent(mcdEvent);
+		WaitForSingleObject(mcdHandle, INFINITE);
+		CloseHandle(mcdHandle);
+		CloseHandle(mcdEvent);
+		mcdHandle = NULL;
+		mcdEvent = NULL;
+	}
+#endif
+	McdClose(&mcdCard[0]);
+	McdClose(&mcdCard[1]);
+}
+
 void LoadMcd(int mcd, char *str) {
 	FILE *f;
 	char *data = NULL;
+	McdCard *c;
 
 	if (mcd == 1) data = Mcd1Data;
 	if (mcd == 2) data = Mcd2Data;
+	c = &mcdCard[mcd - 1];
+
+	// the card that was loaded before gets its pending frames first
+	McdClose(c);
 
 	if (*str == 0) {
 		sprintf(str, "memcards/card%d.mcd", mcd);
 		SysPrintf(_("No memory card value was specified - creating a default card %s\n"), str);
 	}
+	McdRecover(str);
 	f = fopen(str, "rb");
 	if (f == NULL) {
 		SysPrintf(_("The memory card %s doesn't exist - creating it\n"), str);
 		CreateMcd(str);
 		f = fopen(str, "rb");
-		if (f != NULL) {
-			struct stat buf;
-
-			if (stat(str, &buf) != -1) {
-				if (buf.st_size == MCD_SIZE + 64)
-					fseek(f, 64, SEEK_SET);
-				else if(buf.st_size == MCD_SIZE + 3904)
-					fseek(f, 3904, SEEK_SET);
-			}
-			fread(data, 1, MCD_SIZE, f);
-			fclose(f);
-		}
-		else
+		if (f == NULL) {
 			SysMessage(_("Memory card %s failed to load!\n"), str);
-	}
-	else {
-		struct stat buf;
-		SysPrintf(_("Loading memory card %s\n"), str);
-		if (stat(str, &buf) != -1) {
-			if (buf.st_size == MCD_SIZE + 64)
-				fseek(f, 64, SEEK_SET);
-			else if(buf.st_size == MCD_SIZE + 3904)
-				fseek(f, 3904, SEEK_SET);
+			return;
 		}
-		fread(data, 1, MCD_SIZE, f);
-		fclose(f);
 	}
+	else
+		SysPrintf(_("Loading memory card %s\n"), str);
+
+	c->headLen = McdHeadLen(str);
+	if (fread(c->head, 1, c->headLen, f) != (size_t)c->headLen)
+		c->headLen = 0;
+	fread(data, 1, MCD_SIZE, f);
+	fclose(f);
+
+	McdOpen(c, str, data);
 }
 
 void LoadMcds(char *mcd1, char *mcd2) {
@@ -510,23 +809,13 @@ void LoadMcds(char *mcd1, char *mcd2) {
 	LoadMcd(2, mcd2);
 }
 
-void SaveMcd(char *mcd, char *data, uint32_t adr, int size) {
+// straight to the file, for cards that are not cached
+static void McdWriteNow(char *mcd, char *data, uint32_t adr, int size) {
 	FILE *f;
 
 	f = fopen(mcd, "r+b");
 	if (f != NULL) {
-		struct stat buf;
-
-		if (stat(mcd, &buf) != -1) {
-			if (buf.st_size == MCD_SIZE + 64)
-				fseek(f, adr + 64, SEEK_SET);
-			else if (buf.st_size == MCD_SIZE + 3904)
-				fseek(f, adr + 3904, SEEK_SET);
-			else
-				fseek(f, adr, SEEK_SET);
-		} else
-			fseek(f, adr, SEEK_SET);
-
+		fseek(f, adr + McdHeadLen(mcd), SEEK_SET);
 		fwrite(data + adr, 1, size, f);
 		fclose(f);
 		return;
@@ -544,6 +833,30 @@ void SaveMcd(char *mcd, char *data, uint32_t adr, int size) {
 	ConvertMcd(mcd, data);
 }
 
+void SaveMcd(char *mcd, char *data, uint32_t adr, int size) {
+	McdCard *c = McdCardOf(mcd, data);
+	u32 now;
+	int i;
+
+	if (c == NULL || size <= 0 || adr + size > MCD_SIZE) {
+		McdWriteNow(mcd, data, adr, size);
+		return;
+	}
+
+	// the data is in place already; the bit goes after it, a flush that
+	// raced with the copy sees the bit again next time
+	now = McdTicks();
+	McdLock();
+	for (i = adr / 128; i <= (int)((adr + size - 1) / 128); i++) {
+		if (!(c->dirty[i >> 5] & (1u << (i & 31)))) {
+			c->dirty[i >> 5] |= 1u << (i & 31);
+			if (c->ndirty++ == 0) c->first = now;
+		}
+	}
+	c->last = now;
+	McdUnlock();
+}
+
 void CreateMcd(char *mcd) {
 	FILE *f;
 	struct stat buf;
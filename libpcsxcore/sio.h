@@ -58,6 +58,13 @@ void SaveMcd(char *mcd, char *data, uint32_t adr, int size);
 void CreateMcd(char *mcd);
 void ConvertMcd(char *mcd, char *data);
 
+// cached cards: write pending frames soon (disc change, in-game menu),
+// timer check for builds without the flush thread (once per frame), write
+// everything and stop the thread (emu shutdown, before leaving the xex)
+void McdFlush();
+void McdUpdate();
+void McdShutdown();
+
 typedef struct {
 	char Title[48 + 1]; // Title in ASCII
 	char sTitle[48 * 2 + 1]; // Title in Shift-JIS
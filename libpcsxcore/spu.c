@@ -19,13 +19,446 @@
 
 /*
 * Sound (SPU) functions.
+*
+* Threaded SPU: every call into the spu plugin is stamped with psxRegs.cycle
+* and goes into a ring that the spu thread consumes in order. Before each
+* command the thread hands the cycles elapsed since the previous one to
+* SPU_async, so the plugin (in SPUasync driven mode) has mixed up to the
+* block the command belongs to when it gets applied.
+*
+* The cpu only waits for the thread when it needs the spu as it is now:
+* reads of mixer state (envelope, transfer port), dma reads, freeze, and
+* every SPU_async tick while the spu irq is enabled, so the irq is raised
+* in the same slice as in the synchronous mode. The status register only
+* changes with the commands (control, status, transfer port, dma), not
+* while mixing: once read it is kept until one of those is queued, so a
+* game polling SPUSTAT waits for the thread once per change.
 */
 
 #include "spu.h"
 
+// command ring, indices count words and run free
+#define SPU_RING_WORDS	(64 * 1024)
+#define SPU_RING_MASK	(SPU_RING_WORDS - 1)
+#define SPU_DMA_CHUNK	(16 * 1024)		// halfwords per dma record
+
+// mixer block of the plugin (dfsound NSSIZE samples), the thread does not
+// call SPU_async for less between two register writes
+#define SPU_BLOCK_CYCLES	(PSXCLK / 44100 * 23)
+#define SPU_MAX_DELTA		(PSXCLK / 8)
+
+// record: header (type << 24 | words), stamp, payload
+enum {
+	SPUCMD_PAD = 0,					// rest of the ring up to the wrap
+	SPUCMD_TICK,
+	SPUCMD_WRITEREG,				// reg, value
+	SPUCMD_WRITEDMAMEM,				// halfwords, data
+	SPUCMD_XA,						// xa_decode_t up to the used pcm
+	SPUCMD_CDDA,					// bytes, data
+	SPUCMD_CALLBACK					// irq callback (function pointer)
+};
+
+static volatile u32 spu_thread_exit = 1;
+static volatile u32 spu_irq_sync = 0;
+volatile u32 spu_irq_pending = 0;
+static __declspec(align(128)) u32 spu_ring[SPU_RING_WORDS];
+static volatile __declspec(align(128)) u32 spu_write_idx = 0;
+static volatile __declspec(align(128)) u32 spu_read_idx = 0;
+
+// cpu side: last written value of the registers that read back as written,
+// and the status as last read
+static u16 spu_shadow[0x200 >> 1];
+static u32 spu_shadow_valid[0x200 >> 6];
+
+#define SPU_STAT_SHADOW		((0xdae - 0xc00) >> 1)
+#define SpuStatChanged()	(spu_shadow_valid[SPU_STAT_SHADOW >> 5] &= ~(1 << (SPU_STAT_SHADOW & 31)))
+
+// thread side
+static u32 spu_cycle;
+static u32 spu_pending;
+static xa_decode_t spu_xa;
+
 void CALLBACK SPUirq(void) {
+	// on the spu thread: 0x1070 belongs to the cpu, it raises the irq in
+	// psxBranchTest (spuIrqMerge)
+	if (!spu_thread_exit) {
+		InterlockedExchange((volatile LONG *)&spu_irq_pending, 1);
+		return;
+	}
+
 //if(use_vm)
 //	psxHu32ref(0x1070) |= SWAPu32(0x200);
 //else
 	psxHu32ref_2(0x1070) |= SWAPu32(0x200);//teste
 }
+
+void spuIrqMerge() {
+	if (InterlockedExchange((volatile LONG *)&spu_irq_pending, 0))
+		psxHu32ref_2(0x1070) |= SWAPu32(0x200);
+}
+
+//============================================
+//===  RING (cpu side)
+//============================================
+
+// room for words contiguous words, the tail of the ring is padded when the
+// record would wrap
+static u32 *SpuRingAlloc(u32 words) {
+	u32 w = spu_write_idx;
+	u32 pos = w & SPU_RING_MASK;
+	u32 tail = SPU_RING_WORDS - pos;
+	u32 need = words + (tail < words ? tail : 0);
+
+	while (SPU_RING_WORDS - (w - spu_read_idx) < need)
+		YieldProcessor();
+
+	if (tail < words) {
+		spu_ring[pos] = (SPUCMD_PAD << 24) | tail;
+		__lwsync();
+		spu_write_idx = w + tail;
+		pos = 0;
+	}
+
+	return &spu_ring[pos];
+}
+
+static __inline void SpuRingCommit(u32 words) {
+	__lwsync();
+	spu_write_idx += words;
+}
+
+static void SpuPushTick() {
+	u32 *p = SpuRingAlloc(2);
+
+	p[0] = (SPUCMD_TICK << 24) | 2;
+	p[1] = psxRegs.cycle;
+	SpuRingCommit(2);
+}
+
+static void WaitForSpuThread() {
+	while (spu_read_idx != spu_write_idx) {
+		YieldProcessor(); // or r31, r31, r31
+	}
+
+	// High priority
+	__asm{
+		or r3, r3, r3
+	};
+}
+
+// everything queued so far applied and mixed up to now
+static void SpuSync() {
+	SpuPushTick();
+	WaitForSpuThread();
+}
+
+//============================================
+//===  SPU THREAD
+//============================================
+
+static void SpuRunCommand(const u32 *cmd) {
+	u32 type = cmd[0] >> 24;
+	u32 delta = cmd[1] - spu_cycle;
+
+	// a jump of the cpu clock (reset, state load) is not mixed
+	if (delta < SPU_MAX_DELTA) spu_pending += delta;
+	spu_cycle = cmd[1];
+
+	if (type == SPUCMD_TICK || spu_pending >= SPU_BLOCK_CYCLES) {
+		if (SPU_async) SPU_async(spu_pending);
+		spu_pending = 0;
+	}
+
+	switch (type) {
+		case SPUCMD_WRITEREG:
+			SPU_writeRegister(cmd[2], (u16)cmd[3]);
+			break;
+
+		case SPUCMD_WRITEDMAMEM:
+			SPU_writeDMAMem((unsigned short *)&cmd[3], cmd[2]);
+			break;
+
+		case SPUCMD_XA:
+			memcpy(&spu_xa, &cmd[2], (cmd[0] & 0xffffff) * 4 - 8);
+			SPU_playADPCMchannel(&spu_xa);
+			break;
+
+		case SPUCMD_CDDA:
+			if (SPU_playCDDAchannel) SPU_playCDDAchannel((short *)&cmd[3], cmd[2]);
+			break;
+
+		case SPUCMD_CALLBACK: {
+			void (CALLBACK *callback)(void);
+
+			memcpy(&callback, &cmd[2], sizeof(callback));
+			SPU_registerCallback(callback);
+			break;
+		}
+	}
+}
+
+static void spuThread() {
+	u32 r, w, words;
+
+	while (!spu_thread_exit) {
+		r = spu_read_idx;
+		w = spu_write_idx;
+
+		if (r == w) {
+			YieldProcessor();
+			continue;
+		}
+
+		__lwsync();
+
+		while (r != w) {
+			const u32 *cmd = &spu_ring[r & SPU_RING_MASK];
+
+			words = cmd[0] & 0xffffff;
+			if ((cmd[0] >> 24) != SPUCMD_PAD) SpuRunCommand(cmd);
+			r += words;
+
+			__lwsync();
+			spu_read_idx = r;
+		}
+	}
+
+	// Exit thread
+	ExitThread(0);
+}
+
+//============================================
+//===  PLUGIN CALLS (cpu side)
+//============================================
+
+void spuWriteRegister(u32 add, u16 value) {
+	u32 r = add & 0xfff;
+	u32 *p;
+
+	if (spu_thread_exit) {
+		SPU_writeRegister(add, value);
+		return;
+	}
+
+	if (r >= 0xc00 && r < 0xe00 && r != 0xdae) {
+		spu_shadow[(r - 0xc00) >> 1] = value;
+		spu_shadow_valid[(r - 0xc00) >> 6] |= 1 << (((r - 0xc00) >> 1) & 31);
+	}
+	if (r == 0xdaa || r == 0xdae || r == 0xda8) SpuStatChanged();
+
+	p = SpuRingAlloc(4);
+	p[0] = (SPUCMD_WRITEREG << 24) | 4;
+	p[1] = psxRegs.cycle;
+	p[2] = add;
+	p[3] = value;
+	SpuRingCommit(4);
+
+	// irq enable: the thread has to keep up with the cpu from now on,
+	// irq disable: let the irqs still in flight happen now
+	if (r == 0xdaa) {
+		if (value & 0x40) spu_irq_sync = 1;
+		else if (spu_irq_sync) {
+			spu_irq_sync = 0;
+			WaitForSpuThread();
+		}
+	}
+}
+
+u16 spuReadRegister(u32 add) {
+	u32 r = add & 0xfff;
+	u32 i;
+	u16 value;
+
+	if (spu_thread_exit)
+		return SPU_readRegister(add);
+
+	// mixer state and the transfer port need the thread, the others read
+	// back what was written last (the status what was read last)
+	if (r >= 0xc00 && r < 0xe00 &&
+		!(r < 0xd80 && (r & 0x0f) == 0x0c) &&
+		r != 0xda6 && r != 0xda8) {
+		i = (r - 0xc00) >> 1;
+		if (spu_shadow_valid[i >> 5] & (1 << (i & 31)))
+			return spu_shadow[i];
+
+		SpuSync();
+		value = SPU_readRegister(add);
+		spu_shadow[i] = value;
+		spu_shadow_valid[i >> 5] |= 1 << (i & 31);
+		return value;
+	}
+
+	SpuSync();
+	return SPU_readRegister(add);
+}
+
+void spuWriteDMAMem(u16 *pMem, int size) {
+	u32 *p;
+	int n;
+
+	if (spu_thread_exit) {
+		SPU_writeDMAMem(pMem, size);
+		return;
+	}
+
+	SpuStatChanged();
+
+	while (size > 0) {
+		n = size > SPU_DMA_CHUNK ? SPU_DMA_CHUNK : size;
+
+		p = SpuRingAlloc(3 + ((n + 1) >> 1));
+		p[0] = (SPUCMD_WRITEDMAMEM << 24) | (3 + ((n + 1) >> 1));
+		p[1] = psxRegs.cycle;
+		p[2] = n;
+		memcpy(&p[3], pMem, n * 2);
+		SpuRingCommit(3 + ((n + 1) >> 1));
+
+		pMem += n;
+		size -= n;
+	}
+}
+
+void spuReadDMAMem(u16 *pMem, int size) {
+	if (!spu_thread_exit) {
+		SpuSync();
+		SpuStatChanged();
+	}
+
+	SPU_readDMAMem(pMem, size);
+}
+
+void spuPlayADPCMchannel(xa_decode_t *xap) {
+	u32 bytes, words;
+	u32 *p;
+
+	if (spu_thread_exit) {
+		SPU_playADPCMchannel(xap);
+		return;
+	}
+
+	bytes = (u32)((u8 *)xap->pcm - (u8 *)xap) +
+			xap->nsamples * (xap->stereo ? 2 : 1) * sizeof(short);
+	if (bytes > sizeof(xa_decode_t)) bytes = sizeof(xa_decode_t);
+	words = 2 + ((bytes + 3) >> 2);
+
+	p = SpuRingAlloc(words);
+	p[0] = (SPUCMD_XA << 24) | words;
+	p[1] = psxRegs.cycle;
+	memcpy(&p[2], xap, bytes);
+	SpuRingCommit(words);
+}
+
+void spuPlayCDDAchannel(short *pcm, int nbytes) {
+	u32 words;
+	u32 *p;
+
+	if (spu_thread_exit) {
+		if (SPU_playCDDAchannel) SPU_playCDDAchannel(pcm, nbytes);
+		return;
+	}
+
+	if (nbytes <= 0) return;
+
+	words = 3 + ((nbytes + 3) >> 2);
+
+	p = SpuRingAlloc(words);
+	p[0] = (SPUCMD_CDDA << 24) | words;
+	p[1] = psxRegs.cycle;
+	p[2] = nbytes;
+	memcpy(&p[3], pcm, nbytes);
+	SpuRingCommit(words);
+}
+
+// the thread calls the irq callback, it is only changed between its commands
+void spuRegisterCallback(void (CALLBACK *callback)(void)) {
+	u32 words = 2 + ((sizeof(callback) + 3) >> 2);
+	u32 *p;
+
+	if (spu_thread_exit) {
+		SPU_registerCallback(callback);
+		return;
+	}
+
+	p = SpuRingAlloc(words);
+	p[0] = (SPUCMD_CALLBACK << 24) | words;
+	p[1] = psxRegs.cycle;
+	memcpy(&p[2], &callback, sizeof(callback));
+	SpuRingCommit(words);
+}
+
+void spuAsync(u32 cycle) {
+	if (spu_thread_exit) {
+		if (SPU_async) SPU_async(cycle);
+		return;
+	}
+
+	// the thread takes the time from the stamps
+	SpuPushTick();
+
+	if (spu_irq_sync) WaitForSpuThread();
+}
+
+long spuFreeze(u32 ulFreezeMode, SPUFreeze_t *pF) {
+	if (!spu_thread_exit) {
+		SpuSync();
+		if (ulFreezeMode == 0)
+			memset(spu_shadow_valid, 0, sizeof(spu_shadow_valid));
+	}
+
+	return SPU_freeze(ulFreezeMode, pF);
+}
+
+//============================================
+//===  THREAD START/STOP
+//============================================
+
+static HANDLE spuHandle = NULL;
+static u32 spu_thread_enable = 0;
+
+void spuThreadShutdown() {
+	if (!spuHandle) return;
+
+	// let the queue run dry, then ask to shutdown thread
+	WaitForSpuThread();
+	spu_thread_exit = 1;
+
+	// wait for thread exit ...
+	WaitForSingleObject(spuHandle, INFINITE);
+
+	// close thread handle
+	CloseHandle(spuHandle);
+	spuHandle = NULL;
+
+	spuIrqMerge();
+}
+
+void spuThreadInit() {
+
+	// if thread running Shutdown it ...
+	if (spuHandle) {
+		spuThreadShutdown();
+	}
+
+	if (!spu_thread_enable) return;
+
+	// Reset thread variables
+	spu_write_idx = 0;
+	spu_read_idx = 0;
+	spu_irq_sync = 0;
+	spu_cycle = psxRegs.cycle;
+	spu_pending = 0;
+	memset(spu_shadow_valid, 0, sizeof(spu_shadow_valid));
+	spu_thread_exit = 0;
+
+	// Create spu thread on cpu 4 (the plugin's own thread is not used)
+	spuHandle = CreateThread(NULL, NULL, (LPTHREAD_START_ROUTINE)spuThread, NULL, CREATE_SUSPENDED, NULL);
+
+	XSetThreadProcessor(spuHandle, 4);
+	SetThreadPriority(spuHandle, THREAD_PRIORITY_HIGHEST);
+
+	ResumeThread(spuHandle);
+}
+
+void spuThreadEnable(int enable) {
+	spu_thread_enable = enable;
+}
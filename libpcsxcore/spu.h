@@ -41,6 +41,17 @@ extern "C" {
 
 void CALLBACK SPUirq(void);
 
+// spu irq raised on the spu thread, merged into 0x1070 by the cpu thread
+extern volatile u32 spu_irq_pending;
+void spuIrqMerge();
+
+// spu plugin calls, queued to the spu thread when it runs
+void spuThreadInit();
+void spuThreadShutdown();
+void spuThreadEnable(int enable);
+
+// the calls themselves are in plugins.h (they need the plugin types)
+
 #ifdef __cplusplus
 }
 #endif
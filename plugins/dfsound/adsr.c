@@ -323,6 +323,120 @@ static INLINE int MixADSR(int ch)                             // MIX ADSR
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////
+// ADSR BLOCK
+//
+// The attack, a rising sustain and a linear falling sustain move by the
+// same step (whole + fraction) every sample, so until the next boundary
+// (0x6000 for the exponential rise, the 0x7fff clamp, 0) the levels are
+// a straight line. Those stretches are written as runs, only the samples
+// at a boundary and the exponential parts (decay, exponential falling
+// sustain) go through MixADSR one by one.
+////////////////////////////////////////////////////////////////////////
+
+#define ADSR_FRAC_SHIFT 21                             // RateTable_denom = 1<<21
+
+// k (>0) rising steps, no boundary in between
+static INLINE void ADSRRunUp(int * env,int * pVol,int * pVol_f,int add,int add_f,int k)
+{
+ const int vol=*pVol;
+ int i,t=*pVol_f;                                      // fraction before the carries
+
+ for(i=1;i<=k;i++)
+  {
+   t+=add_f;
+   env[i-1]=(vol+i*add+(t>>ADSR_FRAC_SHIFT))>>5;
+  }
+
+ *pVol=vol+k*add+(t>>ADSR_FRAC_SHIFT);
+ *pVol_f=t&(RateTable_denom-1);
+}
+
+// k (>0) linear falling steps (sub, sub_f <= 0), the volume stays >= 0
+static INLINE void ADSRRunDown(int * env,int * pVol,int * pVol_f,int sub,int sub_f,int k)
+{
+ const int vol=*pVol;
+ int i,b=0,t=*pVol_f;
+
+ for(i=1;i<=k;i++)
+  {
+   t+=sub_f;
+   b=(t<0)?((RateTable_denom-1-t)>>ADSR_FRAC_SHIFT):0; // borrows so far
+   env[i-1]=(vol+i*sub-b)>>5;
+  }
+
+ *pVol=vol+k*sub-b;
+ *pVol_f=t+(b<<ADSR_FRAC_SHIFT);
+}
+
+// levels of the next n samples of a voice that is neither in release nor
+// dead (bStop, iSilent 2), the same as n MixADSR calls. Returns the sample
+// where a falling sustain has reached 0 (n if it doesn't): from there on
+// the voice can't be heard until the next key on, the levels are 0 and
+// the state is left alone
+static INLINE int ADSRBlock(int ch,int * env,int n)
+{
+ ADSRInfoEx * a=&s_chan[ch].ADSRX;
+ int ns=0,k,idx,step,top,vol,vol_f;
+
+ while(ns<n)
+  {
+   vol=a->EnvelopeVol;
+   vol_f=a->EnvelopeVol_f;
+   k=0;
+
+   if(a->State==2 && !a->SustainIncrease)              // falling sustain
+    {
+     if(!vol && !vol_f)                                // -> dead
+      {
+       memset(env+ns,0,(n-ns)*sizeof(int));
+       return ns;
+      }
+     if(!a->SustainModeExp)
+      {
+       step=1-RateTableSub[a->SustainRate];            // max drop per sample (borrow included)
+       k=vol/step;
+       if(k>n-ns) k=n-ns;
+       if(k>0) ADSRRunDown(env+ns,&vol,&vol_f,RateTableSub[a->SustainRate],
+                           RateTableSub_f[a->SustainRate],k);
+      }
+    }
+   else if(a->State!=1)                                // attack or rising sustain
+    {
+     const int bExp=(a->State==0)?a->AttackModeExp:a->SustainModeExp;
+
+     idx=((a->State==0)?a->AttackRate:a->SustainRate)+((bExp && vol>=0x6000)?8:0);
+
+     if(idx<128)
+      {
+       if(a->State==2 && vol==0x7fff && vol_f==RateTable_denom) // clamped sustain: stays there
+        {
+         for(;ns<n;ns++) env[ns]=0x7fff>>5;
+         a->lVolume=0x7fff>>5;
+         break;
+        }
+       step=RateTableAdd[idx]+1;                       // max rise per sample (carry included)
+       top=(bExp && vol<0x6000)?0x6000:0x8000;
+       k=(top-1-vol)/step+1;                           // the last step starts below top...
+       if(k>(0x7fff-vol)/step) k=(0x7fff-vol)/step;    // ... and ends below the clamp
+       if(k>n-ns) k=n-ns;
+       if(k>0) ADSRRunUp(env+ns,&vol,&vol_f,RateTableAdd[idx],RateTableAdd_f[idx],k);
+      }
+    }
+
+   if(k>0)
+    {
+     a->EnvelopeVol=vol;
+     a->EnvelopeVol_f=vol_f;
+     a->lVolume=vol>>5;
+     ns+=k;
+    }
+   else env[ns++]=MixADSR(ch);                         // boundary or exponential: one sample
+  }
+
+ return n;
+}
+
 #endif
 
 /*
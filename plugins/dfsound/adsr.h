@@ -17,3 +17,4 @@
 
 static INLINE void StartADSR(int ch);
 static INLINE int  MixADSR(int ch);
+static INLINE int  ADSRBlock(int ch,int * env,int n);
@@ -22,6 +22,7 @@ email                : BlackDove@addcom.de
 #include "externals.h"
 
 BOOL spuirq = 0;
+BOOL sputhread = 0;                                    // core spu thread drives us through SPUasync
 BOOL tombraider2fix = 0;
 
 
@@ -43,10 +44,11 @@ void ReadConfig(void)
 {
 	iVolume=2;
 	iXAPitch=0;
-	if(spuirq){iSPUIRQWait=1;}else{iSPUIRQWait=0;}
-	iUseTimer=0;
+	if(spuirq && !sputhread){iSPUIRQWait=1;}else{iSPUIRQWait=0;}  // the core thread syncs on irqs itself
+	iUseTimer=sputhread ? 2 : 0;
   	iUseReverb=1;
 	iUseInterpolation=2;
+	iXAResample=2;
 	iDisStereo=0;
 	iFreqResponse=0;
 
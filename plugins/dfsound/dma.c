@@ -21,6 +21,7 @@
 
 #include "externals.h"
 #include "registers.h"
+#include "spucap.h"
 
 ////////////////////////////////////////////////////////////////////////
 // READ DMA (one value)
@@ -28,7 +29,11 @@
 
 unsigned short CALLBACK SPUreadDMA(void)
 {
- unsigned short s=spuMem[spuAddr>>1];
+ unsigned short s;
+
+ if(iSPUCapture) SPUcapReadDMA();
+
+ s=spuMem[spuAddr>>1];
  spuAddr+=2;
  if(spuAddr>0x7ffff) spuAddr=0;
 
@@ -45,6 +50,8 @@ void CALLBACK SPUreadDMAMem(unsigned short * pusPSXMem,int iSize)
 {
  int i;
 
+ if(iSPUCapture) SPUcapReadDMAMem(iSize);
+
  spuStat |= STAT_DATA_BUSY;
 
  for(i=0;i<iSize;i++)
@@ -81,6 +88,8 @@ void CALLBACK SPUreadDMAMem(unsigned short * pusPSXMem,int iSize)
   
 void CALLBACK SPUwriteDMA(unsigned short val)
 {
+ if(iSPUCapture) SPUcapWriteDMA(val);
+
  spuMem[spuAddr>>1] = val;                             // spu addr got by writeregister
 
  spuAddr+=2;                                           // inc spu addr
@@ -97,6 +106,8 @@ void CALLBACK SPUwriteDMAMem(unsigned short * pusPSXMem,int iSize)
 {
  int i;
 
+ if(iSPUCapture) SPUcapWriteDMAMem(pusPSXMem,iSize);
+
  spuStat |= STAT_DATA_BUSY;
 
  for(i=0;i<iSize;i++)
@@ -20,6 +20,12 @@ void RemoveSound(void);
 unsigned long SoundGetBytesBuffered(void);
 void SoundFeedStreamData(unsigned char* pSound,long lBytes);
 
+#ifdef _XBOX
+int SoundGetClock(unsigned long * pulSamples);         // xaudio_2.cpp, frame pacing clock
+int SoundGetStats(unsigned long * pulFill,             // xaudio_2.cpp, output ring for the profiler
+                  unsigned long * pulUnderruns,unsigned long * pulDropped);
+#endif
+
 #ifdef _WINDOWS
 #define timeGetTime_spu timeGetTime
 #else
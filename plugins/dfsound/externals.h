@@ -267,6 +267,7 @@ extern int        iDebugMode;
 extern int        iRecordMode;
 extern int        iUseReverb;
 extern int        iUseInterpolation;
+extern int        iXAResample;
 extern int        iDisStereo;
 extern int				iFreqResponse;
 // MISC
@@ -287,6 +288,9 @@ extern int      bEndThread;
 extern int      bThreadEnded;
 extern int      bSpuInit;
 extern uint32_t dwNewChannel;
+extern uint32_t dwActiveChannel;
+extern uint32_t dwNoiseChannel;
+extern uint32_t dwVoiceSamples;
 extern unsigned int bIrqHit;
 
 extern int      SSumR[];
@@ -355,17 +359,3 @@ extern int           iRightXAVol;
 
 #endif
 
-///////////////////////////////////////////////////////////
-// REVERB.C globals
-///////////////////////////////////////////////////////////
-
-#ifndef _IN_REVERB
-
-extern int *          sRVBPlay;
-extern int *          sRVBEnd;
-extern int *          sRVBStart;
-extern int            iReverbOff;
-extern int            iReverbRepeat;
-extern int            iReverbNum;
-
-#endif
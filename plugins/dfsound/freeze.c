@@ -56,8 +56,6 @@ typedef struct
 void LoadStateV5(SPUFreeze_t * pF);                    // newest version
 void LoadStateUnknown(SPUFreeze_t * pF);               // unknown format
 
-extern int lastns;
-
 ////////////////////////////////////////////////////////////////////////
 // SPUFREEZE: called by main emu on savestate load/save
 ////////////////////////////////////////////////////////////////////////
@@ -141,7 +139,12 @@ long CALLBACK SPUfreeze(uint32_t ulFreezeMode,SPUFreeze_t * pF)
    LoadStateV5(pF);
  else LoadStateUnknown(pF);
 
- lastns = 0;
+ dwActiveChannel=dwNoiseChannel=0;                     // rebuild the voice masks
+ for(i=0;i<MAXCHAN;i++)
+  {
+   if(s_chan[i].bOn)    dwActiveChannel|=(1<<i);
+   if(s_chan[i].bNoise) dwNoiseChannel |=(1<<i);
+  }
 
  // repair some globals
  for(i=0;i<=62;i+=2)
@@ -23,6 +23,7 @@
 #include "registers.h"
 #include "regs.h"
 #include "reverb.h"
+#include "spucap.h"
 
 /*
 // adsr time values (in ms) by James Higgs ... see the end of
@@ -48,13 +49,15 @@
 
 
 int Check_IRQ( int addr, int force ) {
+	void (CALLBACK *callback)(void) = irqCallback;	// read once, the core may change it
+
 	if(spuCtrl & CTRL_IRQ)         // some callback and irq active?
 	{
 		if( ( bIrqHit == 0 ) &&
 				( force == 1 || pSpuIrq == spuMemC+addr ) )
 		{
-			if(irqCallback)
-				irqCallback();                        // -> call main emu
+			if(callback)
+				callback();                           // -> call main emu
 
 			// one-time
 			bIrqHit = 1;
@@ -81,6 +84,9 @@ int Check_IRQ( int addr, int force ) {
 void CALLBACK SPUwriteRegister(unsigned long reg, unsigned short val)
 {
  const unsigned long r=reg&0xfff;
+
+ if(iSPUCapture) SPUcapWriteRegister(reg,val);
+
  regArea[(r-0xc00)>>1] = val;
 
  if(r>=0x0c00 && r<0x0d80)                             // some channel info?
@@ -378,17 +384,7 @@ void CALLBACK SPUwriteRegister(unsigned long reg, unsigned short val)
       ReverbOn(16,24,val);
       break;
     //-------------------------------------------------//
-    case H_Reverb+0:
-
-      rvb.FB_SRC_A=val;
-
-      // OK, here's the fake REVERB stuff...
-      // depending on effect we do more or less delay and repeats... bah
-      // still... better than nothing :)
-
-      SetREVERB(val);
-      break;
-
+    case H_Reverb+0   : rvb.FB_SRC_A=val;             break;
 
     case H_Reverb+2   : rvb.FB_SRC_B=(short)val;       break;
     case H_Reverb+4   : rvb.IIR_ALPHA=(short)val;      break;
@@ -430,7 +426,7 @@ void CALLBACK SPUwriteRegister(unsigned long reg, unsigned short val)
 // READ REGISTER: called by main emu
 ////////////////////////////////////////////////////////////////////////
 
-unsigned short CALLBACK SPUreadRegister(unsigned long reg)
+static unsigned short ReadRegister(unsigned long reg)
 {
  const unsigned long r=reg&0xfff;
         
@@ -481,6 +477,15 @@ unsigned short CALLBACK SPUreadRegister(unsigned long reg)
 
  return regArea[(r-0xc00)>>1];
 }
+
+unsigned short CALLBACK SPUreadRegister(unsigned long reg)
+{
+ const unsigned short val=ReadRegister(reg);
+
+ if(iSPUCapture) SPUcapReadRegister(reg,val);
+
+ return val;
+}
  
 ////////////////////////////////////////////////////////////////////////
 // SOUND ON register write
@@ -533,8 +538,9 @@ void SoundOff(int start,int end,unsigned short val)    // SOUND OFF PSX COMMAND
 
 		 // Jungle Book - Rhythm 'n Groove
 		 // - turns off buzzing sound (loop hangs)
+		 // - the dwNewChannel bit stays: the mixer still has to pick
+		 //   up the voice (bOn) if it wasn't playing yet
 		 s_chan[ch].bNew=0;
-		 dwNewChannel &= ~(1<<ch);
 		}                                                  
   }
 }
@@ -577,10 +583,12 @@ void NoiseOn(int start,int end,unsigned short val)     // NOISE ON PSX COMMAND
    if(val&1)                                           // -> noise on/off
     {
      s_chan[ch].bNoise=1;
+     dwNoiseChannel|=(1<<ch);
     }
    else 
     {
      s_chan[ch].bNoise=0;
+     dwNoiseChannel&=~(1<<ch);
     }
   }
 }
@@ -1,165 +1,252 @@
 /***************************************************************************
-                           reverb.c  -  PSX Reverb - FIXED
-                              -------------------
-     Minimalist implementation com acumulação correta de samples
-  ***************************************************************************/
+                          reverb.c  -  description
+                             -------------------
+ PSX reverb unit
+
+ The SPU reverb runs at half the output rate (22050 Hz) on a work area at
+ the end of spu ram (mBASE = H_SPUReverbAddr up to 0x7ffff) and is fully
+ driven by the 32 rvb registers:
+
+  - the voices (and cd audio) flagged for reverb are summed per block,
+    then taken down to 22050 Hz with the 39 tap half band FIR
+  - each 22050 Hz tick does the same side / different side reflections
+    (IIR, vWALL/vIIR), the 4 comb taps and the 2 all pass filters, all
+    buffers are offsets from the current address in the work area
+  - the output goes back up to 44100 Hz with the same FIR and is scaled
+    by the reverb output volume
+
+ The math follows the hardware description from nocash's psx-spx docs:
+ 16 bit products shifted by 15 and saturated at every ram write. The two
+ FIRs are the expensive part and run as block kernels (voiceblk.c) over
+ both sides at once. The work area is only written with spuCtrl bit 7.
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
 
 #define _IN_REVERB
 #ifdef _IN_SPU
 
-/* Buffer para acumular samples de todos os canais */
-#define RVB_BUF_SIZE 512
-static int s_reverbInL[RVB_BUF_SIZE];
-static int s_reverbInR[RVB_BUF_SIZE];
-static int s_bufPos = 0;
-
-/* Delay line para o efeito */
-#define RVB_DELAY_SIZE 2205  /* ~50ms */
-#define RVB_MASK (RVB_DELAY_SIZE - 1)
-static short s_delayL[RVB_DELAY_SIZE];
-static short s_delayR[RVB_DELAY_SIZE];
-static int s_delayPos = 0;
-
-/* Níveis: 90% dry, 10% wet */
-static int s_wet = 3277;    /* 10% */
-static int s_dry = 29491;   /* 90% */
-
-/* Legacy globals */
-int *sRVBPlay = 0;
-int *sRVBEnd = 0;
-int *sRVBStart = 0;
-int iReverbOff = -1;
-int iReverbRepeat = 0;
-int iReverbNum = 1;
-
-/* Clamp helper */
 #define CLAMP16(x) (((x) > 32767) ? 32767 : ((x) < -32768) ? -32768 : (x))
 
-/* Inicialização */
-void InitReverbSystem(void)
+#define RVB_DOWN_TAPS 40                               // 39 taps + a leading 0, whole vectors
+#define RVB_UP_TAPS   24                               // the 20 odd taps + 4 leading 0
+#define RVB_TICKS     ((NSSIZE+1)/2)                   // max 22050 Hz ticks per block
+
+// half band FIR (center tap 0x4000, every other tap 0)
+static const short rvbDownTaps[RVB_DOWN_TAPS] =
 {
-    int i;
-    for (i = 0; i < RVB_BUF_SIZE; i++) {
-        s_reverbInL[i] = 0;
-        s_reverbInR[i] = 0;
-    }
-    for (i = 0; i < RVB_DELAY_SIZE; i++) {
-        s_delayL[i] = 0;
-        s_delayR[i] = 0;
-    }
-    s_bufPos = 0;
-    s_delayPos = 0;
+     0,
+    -1,    0,     2,    0,   -10,    0,    35,    0,  -103,    0,
+   266,    0,  -616,    0,  1332,    0, -2960,    0, 10246,16384,
+ 10246,    0, -2960,    0,  1332,    0,  -616,    0,   266,    0,
+  -103,    0,    35,    0,   -10,    0,     2,    0,    -1
+};
+
+// upsampling: the zero stuffed samples drop out, leaving the odd taps
+static const short rvbUpTaps[RVB_UP_TAPS] =
+{
+     0,    0,    0,    0,
+    -1,    2,   -10,   35,  -103,  266,  -616, 1332, -2960,10246,
+ 10246,-2960,  1332, -616,   266, -103,    35,  -10,     2,   -1
+};
+
+static int   rvbSumL[NSSIZE];                          // reverb input of the current block
+static int   rvbSumR[NSSIZE];
+static short rvbInL[RVB_DOWN_TAPS-1+NSSIZE];           // 16 bit input: history + block
+static short rvbInR[RVB_DOWN_TAPS-1+NSSIZE];
+static short rvbOutL[RVB_UP_TAPS-1+RVB_TICKS];         // 22050 Hz output: history + block
+static short rvbOutR[RVB_UP_TAPS-1+RVB_TICKS];
+static int   rvbPhase;                                 // 0: next 44100 Hz sample is a reverb tick
+
+////////////////////////////////////////////////////////////////////////
+// START REVERB
+////////////////////////////////////////////////////////////////////////
+
+static INLINE void StartREVERB(int ch)
+{
+ if(s_chan[ch].bReverb && (spuCtrl&0x80) && iUseReverb) // reverb possible?
+      s_chan[ch].bRVBActive=1;
+ else s_chan[ch].bRVBActive=0;                         // else -> no reverb
 }
 
-void ShutdownReverbSystem(void)
+////////////////////////////////////////////////////////////////////////
+// INIT REVERB: clears the resampler state (spu init, stream setup)
+////////////////////////////////////////////////////////////////////////
+
+void InitREVERB(void)
 {
-    InitReverbSystem();
+ memset(rvbSumL,0,sizeof(rvbSumL));
+ memset(rvbSumR,0,sizeof(rvbSumR));
+ memset(rvbInL,0,sizeof(rvbInL));
+ memset(rvbInR,0,sizeof(rvbInR));
+ memset(rvbOutL,0,sizeof(rvbOutL));
+ memset(rvbOutR,0,sizeof(rvbOutR));
+ rvbPhase=0;
 }
 
-/* Set reverb - simplified */
-void SetREVERB(unsigned short val)
+////////////////////////////////////////////////////////////////////////
+// STORE REVERB: voice block and cd audio samples go into the input sums
+////////////////////////////////////////////////////////////////////////
+
+static INLINE void StoreREVERB(int ch,const int * src,int iSamples)
 {
-    iReverbOff = (val == 0x0000) ? -1 : 32;
+ VoiceVolumeBlock(rvbSumL,rvbSumR,src,                 // same volume math as the dry mix
+                  s_chan[ch].iLeftVolume,s_chan[ch].iRightVolume,iSamples);
 }
 
-/* Inicializa reverb para canais */
-static INLINE void StartREVERB(int ch)
+static INLINE void StoreREVERB_CD(int left,int right,int ns)
 {
-    if (s_chan[ch].bReverb && (spuCtrl & 0x80) && iUseReverb >= 1) {
-        s_chan[ch].bRVBActive = 1;
-    } else {
-        s_chan[ch].bRVBActive = 0;
-    }
+ if(!iUseReverb) return;
+ rvbSumL[ns]+=left;
+ rvbSumR[ns]+=right;
 }
 
-static INLINE void InitREVERB(void)
+////////////////////////////////////////////////////////////////////////
+// work area access: register offsets are in 8 byte units, addresses in
+// halfwords, everything wraps inside mBASE...end of ram
+////////////////////////////////////////////////////////////////////////
+
+#define RVB_OFS(x) (((x)&0xffff)<<2)
+
+static INLINE int RvbAddr(int off)
 {
-    int i;
-    if (iUseReverb >= 1) {
-        for (i = 0; i < RVB_DELAY_SIZE; i++) {
-            s_delayL[i] = 0;
-            s_delayR[i] = 0;
-        }
-        s_delayPos = 0;
-    }
+ const int size=0x40000-rvb.StartAddr;
+ int a=(rvb.CurrAddr-rvb.StartAddr+off)%size;
+ if(a<0) a+=size;
+ return rvb.StartAddr+a;
 }
 
-/* Store CD audio */
-static INLINE void StoreREVERB_CD(int left, int right, int ns)
+static INLINE int RvbRead(int off)
 {
-    if (iUseReverb == 0) return;
-    if (ns < RVB_BUF_SIZE) {
-        s_reverbInL[ns] += left >> 1;  /* Acumula com redução de volume */
-        s_reverbInR[ns] += right >> 1;
-    }
+ return (short)SWAP16(spuMem[RvbAddr(off)]);
 }
 
-/* Store channel sample - ACUMULA no buffer */
-static INLINE void StoreREVERB(int ch, int ns)
+static INLINE void RvbWrite(int off,int val)
 {
-    int vl, vr;
-    
-    if (iUseReverb == 0) return;
-    if (ns >= RVB_BUF_SIZE) return;
-    
-    /* Calcula volume do canal */
-    vl = (s_chan[ch].sval * s_chan[ch].iLeftVolume) >> 14;   /* /16384 */
-    vr = (s_chan[ch].sval * s_chan[ch].iRightVolume) >> 14;
-    
-    /* Acumula no buffer de reverb */
-    s_reverbInL[ns] += vl;
-    s_reverbInR[ns] += vr;
+ if(spuCtrl&0x80)
+  spuMem[RvbAddr(off)]=SWAP16((unsigned short)CLAMP16(val));
 }
 
-/* Mix reverb - LEFT channel */
-static INLINE int MixREVERBLeft(int ns)
+// [m] = ((in + [d]*vWALL - [m-1]) * vIIR) + [m-1]
+static INLINE void RvbReflect(int m,int d,int in)
 {
-    int inL, inR;
-    int readPos;
-    int wetL, wetR;
-    int outL;
-    
-    if (iUseReverb == 0) return 0;
-    if (ns >= RVB_BUF_SIZE) return 0;
-    
-    /* Pega sample acumulado */
-    inL = s_reverbInL[ns];
-    inR = s_reverbInR[ns];
-    
-    /* Limpa para próxima rodada */
-    s_reverbInL[ns] = 0;
-    s_reverbInR[ns] = 0;
-    
-    /* Limita para evitar clipping */
-    inL = CLAMP16(inL);
-    inR = CLAMP16(inR);
-    
-    /* Lê sample atrasado do delay line */
-    readPos = (s_delayPos + 16) & RVB_MASK;  /* Pequeno offset */
-    wetL = s_delayL[readPos];
-    wetR = s_delayR[readPos];
-    
-    /* Escreve sample atual no delay (com atenuação) */
-    s_delayL[s_delayPos] = (short)CLAMP16((inL * 8000) >> 15);  /* ~24% */
-    s_delayR[s_delayPos] = (short)CLAMP16((inR * 8000) >> 15);
-    
-    /* Avança posição do delay */
-    s_delayPos = (s_delayPos + 1) & RVB_MASK;
-    
-    /* Mix: dry + wet */
-    outL = ((inL * s_dry) + (wetL * s_wet)) >> 15;
-    
-    /* Aplica volume de reverb */
-    outL = (outL * rvb.VolLeft) >> 14;
-    
-    return CLAMP16(outL);
+ const int last=RvbRead(m-1);
+ const int v=CLAMP16(in+((RvbRead(d)*rvb.IIR_COEF)>>15));
+ RvbWrite(m,(((v-last)*rvb.IIR_ALPHA)>>15)+last);
 }
 
-/* Mix reverb - RIGHT channel */
-static INLINE int MixREVERBRight(void)
+static INLINE int RvbComb(int a,int b,int c,int d)
 {
-    /* Processado junto com Left */
-    return 0;
+ return CLAMP16(((RvbRead(a)*rvb.ACC_COEF_A)>>15)+((RvbRead(b)*rvb.ACC_COEF_B)>>15)+
+                ((RvbRead(c)*rvb.ACC_COEF_C)>>15)+((RvbRead(d)*rvb.ACC_COEF_D)>>15));
+}
+
+static INLINE int RvbAllPass(int out,int m,int dist,int v)
+{
+ const int old=RvbRead(m-dist);
+ const int t=CLAMP16(out-((old*v)>>15));
+ RvbWrite(m,t);
+ return CLAMP16(((t*v)>>15)+old);
+}
+
+////////////////////////////////////////////////////////////////////////
+// one 22050 Hz tick of the reverb unit
+////////////////////////////////////////////////////////////////////////
+
+static INLINE void ReverbTick(int inL,int inR,short * outL,short * outR)
+{
+ const int Lin=(inL*rvb.IN_COEF_L)>>15;
+ const int Rin=(inR*rvb.IN_COEF_R)>>15;
+ int l,r;
+
+ if(!rvb.StartAddr) {*outL=*outR=0;return;}            // no work area: silence
+
+ RvbReflect(RVB_OFS(rvb.IIR_DEST_A0),RVB_OFS(rvb.IIR_SRC_A0),Lin); // same side
+ RvbReflect(RVB_OFS(rvb.IIR_DEST_A1),RVB_OFS(rvb.IIR_SRC_A1),Rin);
+ RvbReflect(RVB_OFS(rvb.IIR_DEST_B0),RVB_OFS(rvb.IIR_SRC_B0),Lin); // different side
+ RvbReflect(RVB_OFS(rvb.IIR_DEST_B1),RVB_OFS(rvb.IIR_SRC_B1),Rin);
+
+ l=RvbComb(RVB_OFS(rvb.ACC_SRC_A0),RVB_OFS(rvb.ACC_SRC_B0),
+           RVB_OFS(rvb.ACC_SRC_C0),RVB_OFS(rvb.ACC_SRC_D0));
+ r=RvbComb(RVB_OFS(rvb.ACC_SRC_A1),RVB_OFS(rvb.ACC_SRC_B1),
+           RVB_OFS(rvb.ACC_SRC_C1),RVB_OFS(rvb.ACC_SRC_D1));
+
+ l=RvbAllPass(l,RVB_OFS(rvb.MIX_DEST_A0),RVB_OFS(rvb.FB_SRC_A),rvb.FB_ALPHA);
+ r=RvbAllPass(r,RVB_OFS(rvb.MIX_DEST_A1),RVB_OFS(rvb.FB_SRC_A),rvb.FB_ALPHA);
+ l=RvbAllPass(l,RVB_OFS(rvb.MIX_DEST_B0),RVB_OFS(rvb.FB_SRC_B),rvb.FB_X);
+ r=RvbAllPass(r,RVB_OFS(rvb.MIX_DEST_B1),RVB_OFS(rvb.FB_SRC_B),rvb.FB_X);
+
+ *outL=(short)l;
+ *outR=(short)r;
+
+ if(++rvb.CurrAddr>=0x40000) rvb.CurrAddr=rvb.StartAddr;
+}
+
+////////////////////////////////////////////////////////////////////////
+// MIX REVERB: runs the reverb over one block and adds it to the sums
+////////////////////////////////////////////////////////////////////////
+
+static void MixREVERB(int * sumL,int * sumR)
+{
+ int x22L[RVB_TICKS],x22R[RVB_TICKS];
+ int upL[RVB_TICKS],upR[RVB_TICKS];
+ const int first=rvbPhase;                             // block sample of the first tick
+ const int nt=(NSSIZE-first+1)/2;
+ const int vl=(short)rvb.VolLeft;
+ const int vr=(short)rvb.VolRight;
+ short * yL=rvbOutL+RVB_UP_TAPS-1;
+ short * yR=rvbOutR+RVB_UP_TAPS-1;
+ int ns,i,l,r;
+
+ if(!iUseReverb) return;
+
+ for(ns=0;ns<NSSIZE;ns++)                              // 16 bit input after the history
+  {
+   rvbInL[RVB_DOWN_TAPS-1+ns]=(short)CLAMP16(rvbSumL[ns]);
+   rvbInR[RVB_DOWN_TAPS-1+ns]=(short)CLAMP16(rvbSumR[ns]);
+  }
+ memset(rvbSumL,0,sizeof(rvbSumL));
+ memset(rvbSumR,0,sizeof(rvbSumR));
+
+ // down to 22050 Hz: every other sample, window ending at that sample
+ ReverbFirBlock(x22L,x22R,rvbInL+first,rvbInR+first,rvbDownTaps,RVB_DOWN_TAPS,2,nt);
+
+ for(i=0;i<nt;i++)
+  ReverbTick(CLAMP16(x22L[i]>>15),CLAMP16(x22R[i]>>15),&yL[i],&yR[i]);
+
+ // back up: on a tick the point between the two center samples of the
+ // newest 20, in between the later of them
+ ReverbFirBlock(upL,upR,rvbOutL,rvbOutR,rvbUpTaps,RVB_UP_TAPS,1,nt);
+
+ for(ns=0,i=0;ns<NSSIZE;ns++)
+  {
+   if(((ns-first)&1)==0)
+    {
+     l=CLAMP16(upL[i]>>14);
+     r=CLAMP16(upR[i]>>14);
+     i++;
+    }
+   else
+    {
+     l=yL[i-10];
+     r=yR[i-10];
+    }
+   sumL[ns]+=(l*vl)>>15;
+   sumR[ns]+=(r*vr)>>15;
+  }
+
+ memmove(rvbInL,rvbInL+NSSIZE,(RVB_DOWN_TAPS-1)*sizeof(short));
+ memmove(rvbInR,rvbInR+NSSIZE,(RVB_DOWN_TAPS-1)*sizeof(short));
+ memmove(rvbOutL,rvbOutL+nt,(RVB_UP_TAPS-1)*sizeof(short));
+ memmove(rvbOutR,rvbOutR+nt,(RVB_UP_TAPS-1)*sizeof(short));
+ rvbPhase=(first+NSSIZE)&1;
 }
 
 #endif
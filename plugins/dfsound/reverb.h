@@ -15,7 +15,5 @@
  *                                                                         *
  ***************************************************************************/
 
-void SetREVERB(unsigned short val);
-static INLINE void StartREVERB(int ch);
-static INLINE void StoreREVERB(int ch,int ns);
+void InitREVERB(void);
 
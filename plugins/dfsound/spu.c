@@ -23,6 +23,9 @@
 #include "cfg.h"
 #include "dsoundoss.h"
 #include "regs.h"
+#include "spucap.h"
+#include "adpcm.h"
+#include "voiceblk.h"
 
 #ifdef _WINDOWS
 #include "debug.h"
@@ -103,6 +106,7 @@ int             iDebugMode=0;
 int             iRecordMode=0;
 int             iUseReverb=2;
 int             iUseInterpolation=2;
+int             iXAResample=2;                         // xa 37800/18900 Hz: 0 hold, 1 linear, 2 polyphase
 int             iDisStereo=1;
 int							iFreqResponse=0;
 
@@ -140,24 +144,22 @@ static pthread_t thread = (pthread_t)-1;               // thread id (linux)
 #endif
 
 uint32_t dwNewChannel=0;                          // flags for faster testing, if new channel starts
+uint32_t dwActiveChannel=0;                       // voices the mixer walks (bOn), owned by the mixer
+uint32_t dwNoiseChannel=0;                        // voices in noise mode (register shadow)
 
 void (CALLBACK *irqCallback)(void)=0;                  // func of main emu, called on spu irq
 void (CALLBACK *cddavCallback)(unsigned short,unsigned short)=0;
 
 // certain globals (were local before, but with the new timeproc I need em global)
 
-static const int f[5][2] = {   {    0,  0  },
-                        {   60,  0  },
-                        {  115, -52 },
-                        {   98, -55 },
-                        {  122, -60 } };
 int SSumR[NSSIZE];
 int SSumL[NSSIZE];
 int iFMod[NSSIZE];
 int iCycle = 0;
 short * pS;
+uint32_t dwMixedSamples=0;                             // output samples mixed so far (capture stamps)
+uint32_t dwVoiceSamples=0;                             // voice samples rendered so far (mixer cost counter)
 
-int lastns=0;              // last ns pos
 static int iSecureStart=0; // secure start counter
 
 ////////////////////////////////////////////////////////////////////////
@@ -309,8 +311,6 @@ static INLINE void StartSound(int ch)
  if(iUseInterpolation>=2)                              // gauss interpolation?
       {s_chan[ch].spos=0x30000L;s_chan[ch].SB[28]=0;}  // -> start with more decoding
  else {s_chan[ch].spos=0x10000L;s_chan[ch].SB[31]=0;}  // -> no/simple interpolation starts with one 44100 decoding
-
- dwNewChannel&=~(1<<ch);                               // clear new channel bit
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -536,419 +536,466 @@ static INLINE int iGetInterpolationVal(int ch)
 }
 
 ////////////////////////////////////////////////////////////////////////
-// MAIN SPU FUNCTION
-// here is the main job handler... thread, timer or direct func call
-// basically the whole sound processing is done in this fat func!
+// CHANNEL MIXER
+// the main loop renders one channel at a time for a whole block of
+// NSSIZE samples, keeping the channel's state in cache/registers,
+// instead of visiting all 24 channels for every output sample
 ////////////////////////////////////////////////////////////////////////
 
-// 5 ms waiting phase, if buffer is full and no new sound has to get started
-// .. can be made smaller (smallest val: 1 ms), but bigger waits give
-// better performance
+static int iNoiseBlock[NSSIZE];                        // noise output of the current block
+static int iChanBlock[VOICE_BLOCK];                    // scratch: enveloped samples of one channel
 
-#define PAUSE_W 1
-#define PAUSE_L 1000
-
-////////////////////////////////////////////////////////////////////////
-
-#if defined(_WINDOWS) || defined(_XBOX)
-static VOID CALLBACK MAINProc(UINT nTimerId, UINT msg, DWORD dwUser, DWORD dwParam1, DWORD dwParam2)
-#else
-static void *MAINThread(void *arg)
-#endif
+static INLINE void NoiseBlock(void)
 {
- int s_1,s_2,fa,ns;
- int voldiv = iVolume;
+ int ns;
 
- unsigned char * start;unsigned int nSample;
- int ch,predict_nr,shift_factor,flags,d,s;
- int bIRQReturn=0;
- unsigned int decoded_voice=0;
-
- // mute output
- if( voldiv == 5 ) voldiv = 0x7fffffff;
+ if(!(dwNoiseChannel&dwActiveChannel))                 // the generator runs on every sample,
+  {                                                    // no matter how many channels use it
+   for(ns=0;ns<NSSIZE;ns++) NoiseClock();
+   return;
+  }
 
- while(!bEndThread)                                    // until we are shutting down
+ for(ns=0;ns<NSSIZE;ns++)
   {
-   // ok, at the beginning we are looking if there is
-   // enuff free place in the dsound/oss buffer to
-   // fill in new data, or if there is a new channel to start.
-   // if not, we wait (thread) or return (timer/spuasync)
-   // until enuff free place is available/a new channel gets
-   // started
-
-   if(dwNewChannel)                                    // new channel should start immedately?
-    {                                                  // (at least one bit 0 ... MAXCHANNEL is set?)
-     iSecureStart++;                                   // -> set iSecure
-     if(iSecureStart>1) iSecureStart=0;                //    (if it is set 5 times - that means on 5 tries a new samples has been started - in a row, we will reset it, to give the sound update a chance)
-    }
-   else iSecureStart=0;                                // 0: no new channel should start
+   NoiseClock();
+   iNoiseBlock[ns]=iGetNoiseVal(0);
+  }
+}
 
-   while(!iSecureStart && !bEndThread &&               // no new start? no thread end?
-         (SoundGetBytesBuffered()>TESTSIZE))           // and still enuff data in sound buffer?
-    {
-     iSecureStart=0;                                   // reset secure
+////////////////////////////////////////////////////////////////////////
+// key ons since the last block: taken with one atomic swap, so a bit
+// set by the emu thread meanwhile is never lost (the mixer may run in
+// its own thread)
 
+static INLINE uint32_t TakeNewChannels(void)
+{
 #if defined(_WINDOWS) || defined(_XBOX)
-#ifndef _XBOX
-     if(iUseTimer)                                     // no-thread mode?
-      {
-       if(iUseTimer==1)                                // -> ok, timer mode 1: setup a oneshot timer of x ms to wait
-        timeSetEvent(PAUSE_W,1,MAINProc,0,TIME_ONESHOT);
-       return;                                         // -> and done this time (timer mode 1 or 2)
-      }
+ return (uint32_t)InterlockedExchange((LONG volatile *)&dwNewChannel,0);
 #else
-//	 if(iUseTimer) return 0;							   // linux no-thread mode? bye
-	 if(iUseTimer) return;							   // linux no-thread mode? bye
+ return __sync_lock_test_and_set(&dwNewChannel,0);
 #endif
-	 // win thread mode:
-     Sleep(PAUSE_W);                                   // sleep for x ms (win)
+}
+
+////////////////////////////////////////////////////////////////////////
+// lowest set bit of a non zero voice mask
+
+#if defined(_XBOX)
+#define LowestChannel(m) (31-_CountLeadingZeros((m)&(0-(m))))
+#elif defined(__GNUC__) || defined(__clang__)
+#define LowestChannel(m) __builtin_ctz(m)
 #else
-     if(iUseTimer) return 0;                           // linux no-thread mode? bye
-     usleep(PAUSE_L);                                  // else sleep for x ms (linux)
+static INLINE int LowestChannel(uint32_t m)
+{
+ int ch=0;
+ while(!(m&1)) {m>>=1;ch++;}
+ return ch;
+}
 #endif
 
-     if(dwNewChannel) iSecureStart=1;                  // if a new channel kicks in (or, of course, sound buffer runs low), we will leave the loop
-    }
+////////////////////////////////////////////////////////////////////////
+// decode the next 28 samples of a channel, returns 1 if the cpu has
+// to catch up with a spu irq. Dead voices are decoded as well, the
+// samples stay in the interpolation ring for when the voice comes back.
+// *pbSilenced is set when the voice went dead here (envelope zeroed)
+static INLINE int DecodeBlock(int ch,int * pbSilenced)
+{
+ unsigned char * start;
+ int predict_nr,shift_factor,flags;
+ int bIRQReturn=0;
+ void (CALLBACK *callback)(void);
 
-   ns=0;
+ // Xenogears - Anima Relic dungeon (exp gain)
+ if( s_chan[ch].bLoopJump == 1 )
+  s_chan[ch].pCurr = s_chan[ch].pLoop;
 
-   //--------------------------------------------------// continue from irq handling in timer mode?
+ s_chan[ch].bLoopJump = 0;
 
-   if(lastns>0)                                        // will be 0 if no continue is pending
-    {
-     ns=lastns;                                        // -> setup all kind of vars to continue
-     lastns=0;
-    }
+ start=s_chan[ch].pCurr;                               // set up the current pos
 
-   //--------------------------------------------------//
-   //- main channel loop                              -//
-   //--------------------------------------------------//
+ if (s_chan[ch].iSilent==1 || start == (unsigned char*)-1)
+  {
+   if(!tombraider2fix)
     {
-//		 decoded_voice = decoded_ptr;
+     if (start == spuMemC)
+      s_chan[ch].bOn = 0;
+    }
 
-		 while(ns<NSSIZE)                                // loop until 1 ms of data is reached
-      {
-				SSumL[ns]=0;
-				SSumR[ns]=0;
+   s_chan[ch].iSilent=2;
+   s_chan[ch].ADSRX.lVolume=0;
+   s_chan[ch].ADSRX.EnvelopeVol=0;
+   *pbSilenced=1;
+  }
 
-/*
-				// decoded buffer values - dummy
-				spuMem[ (0x000 + decoded_voice) / 2 ] = (short) 0;
-				spuMem[ (0x400 + decoded_voice) / 2 ] = (short) 0;
-				spuMem[ (0x800 + decoded_voice) / 2 ] = (short) 0;
-				spuMem[ (0xc00 + decoded_voice) / 2 ] = (short) 0;
-*/
+ s_chan[ch].iSBPos=0;
 
-				NoiseClock();
+ //////////////////////////////////////////// spu irq handler here? mmm... do it later
 
-				for(ch=0;ch<MAXCHAN;ch++)                         // loop em all... we will collect 1 ms of sound of each playing channel
-        {
-					if(s_chan[ch].bNew) {
-#if 1
-						StartSound(ch);																 // start new sound
-						dwNewChannel&=~(1<<ch);                       // clear new channel bit
-#else
-						if( s_chan[ch].ADSRX.StartDelay == 0 ) {
-							StartSound(ch);															// start new sound
-							dwNewChannel&=~(1<<ch);                     // clear new channel bit
-						} else {
-							s_chan[ch].ADSRX.StartDelay--;
-						}
-#endif
-					}
-				 if(!s_chan[ch].bOn) continue;                   // channel not playing? next
+ predict_nr=(int)*start;start++;
+ shift_factor=predict_nr&0xf;
+ predict_nr >>= 4;
+ flags=(int)*start;start++;
 
-				 if(s_chan[ch].iActFreq!=s_chan[ch].iUsedFreq)   // new psx frequency?
-					VoiceChangeFrequency(ch);
+ // Silhouette Mirage - Serah fight
+ if( predict_nr > 4 ) predict_nr = 0;
 
-				 if(s_chan[ch].bFMod==1 && iFMod[ns])          // fmod freq channel
-          FModChangeFrequency(ch,ns);
+ // -------------------------------------- //
 
-         while(s_chan[ch].spos>=0x10000L)
-          {
-           if(s_chan[ch].iSBPos==28)                   // 28 reached?
-            {
-						 // Xenogears - Anima Relic dungeon (exp gain)
-						 if( s_chan[ch].bLoopJump == 1 )
-							 s_chan[ch].pCurr = s_chan[ch].pLoop;
+ ADPCM_DecodeBlock(s_chan[ch].SB,start-2,shift_factor,predict_nr,
+                   &s_chan[ch].s_1,&s_chan[ch].s_2);   // shared with the cd-xa decoder (libpcsxcore/adpcm.c)
+ start+=14;
 
-						 s_chan[ch].bLoopJump = 0;
+ //////////////////////////////////////////// irq check
 
-                         start=s_chan[ch].pCurr;       // set up the current pos    
+ callback=irqCallback;                                 // read once, the core may change it
 
-            if (s_chan[ch].iSilent==1 || start == (unsigned char*)-1)
-			 {
-if(!tombraider2fix)
-{
-		    if (start == spuMemC)
-               s_chan[ch].bOn = 0;
-}
+ if(callback && (spuCtrl&0x40))                        // some callback and irq active?
+  {
+   if((pSpuIrq >  start-16 &&                          // irq address reached?
+       pSpuIrq <= start) ||
+      ((flags&1) &&                                    // special: irq on looping addr, when stop/loop flag is set
+       (pSpuIrq >  s_chan[ch].pLoop-16 &&
+        pSpuIrq <= s_chan[ch].pLoop)))
+    {
+     s_chan[ch].iIrqDone=1;                            // -> debug flag
+     callback();                                       // -> call main emu
 
-			   s_chan[ch].iSilent=2;
-			   s_chan[ch].ADSRX.lVolume=0;
-               s_chan[ch].ADSRX.EnvelopeVol=0;
-             }
+     if(iSPUIRQWait)                                   // -> option: wait after irq for main emu
+      {
+       iSpuAsyncWait=1;
+       bIRQReturn=1;
+      }
+    }
+  }
 
-             s_chan[ch].iSBPos=0;
+ //////////////////////////////////////////// flag handler
 
-             //////////////////////////////////////////// spu irq handler here? mmm... do it later
+ /*
+ SPU2-X:
+ $4 = set loop to current block
+ $2 = keep envelope on (no mute)
+ $1 = jump to loop address
 
-             s_1=s_chan[ch].s_1;
-             s_2=s_chan[ch].s_2;
+ silence means no volume (ADSR keeps playing!!)
+ */
 
-             predict_nr=(int)*start;start++;
-             shift_factor=predict_nr&0xf;
-             predict_nr >>= 4;
-             flags=(int)*start;start++;
+ if(flags&4)
+  s_chan[ch].pLoop=start-16;
 
-						 // Silhouette Mirage - Serah fight
-						 if( predict_nr > 4 ) predict_nr = 0;
+ // Jungle Book - Rhythm 'n Groove - don't reset ignore status
+ // - fixes gameplay speed (IRQ hits)
+ //s_chan[ch].bIgnoreLoop = 0;
 
-             // -------------------------------------- //
+ if(flags&1)
+  {
+   // Xenogears - 7 = play missing sounds
+   // set jump flag
+   s_chan[ch].bLoopJump = 1;
 
-             for (nSample=0;nSample<28;start++)
-              {
-               d=(int)*start;
-               s=((d&0xf)<<12);
-               if(s&0x8000) s|=0xffff0000;
+   // silence = keep playing..?
+   if( (flags&2) == 0 )
+    {
+     s_chan[ch].iSilent = 1;                           // silence = don't start release phase
+    }
+  }
 
-               fa=(s >> shift_factor);
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+ // Silhouette Mirage - ending mini-game
+ if( start - spuMemC >= 0x80000 )
+  {
+   start -= 16;
 
-							 // snes brr clamps
-							 fa = CLAMP16(fa);
+   s_chan[ch].iSilent = 1;
+   s_chan[ch].bStop = 1;
+  }
 
-               s_2=s_1;s_1=fa;
-               s=((d & 0xf0) << 8);
+ s_chan[ch].pCurr=start;                               // store values for next cycle
 
-               s_chan[ch].SB[nSample++]=fa;
+ return bIRQReturn;
+}
 
+////////////////////////////////////////////////////////////////////////
+// render one block of a playing channel into iChanBlock, returns the
+// number of samples made: less than NSSIZE if the channel stopped, 0 if
+// it was silent for the whole block.
+// The envelope of the block is worked out first (ADSRBlock, adsr.c), only
+// the release stays per sample: where it ends depends on the irq address
+// and the sample position. A DecodeBlock in the block that silences the
+// voice or starts the release (iSilent, bStop) ends that: the envelope is
+// worked out again up to that sample and the rest goes per sample.
+// The serial part (pitch, decoding, interpolation
+// ring) leaves its per sample results in iValBlock (and the gauss taps),
+// the arithmetic is done afterwards by the block kernels in voiceblk.c.
+// Samples whose envelope is 0 for sure skip interpolation and envelope:
+// a dead voice (sample ended, iSilent 2: MixADSR gives 0 and holds the
+// envelope) or a falling sustain that reached 0. The sample is still
+// decoded and goes into the interpolation ring, a dead voice comes back
+// (iSilent 1) when the walk reaches another end block and its envelope
+// may rise again from there.
+
+static int iValBlock[VOICE_BLOCK];                     // interpolated samples
+static int iEnvBlock[VOICE_BLOCK];                     // envelope levels, 0 while silent
+static GAUSSBLOCK GaussBlock;                          // gauss taps of the block
+
+// envelope state at sample ns of a block done by ADSRBlock from a0, with
+// the voice flags it had before DecodeBlock changed them; what DecodeBlock
+// did to the envelope (the zero of a voice going dead) is done again
+static INLINE void EnvBlockBreak(int ch,const ADSRInfoEx * a0,int ns,int iSilent,int bStop,int bSilenced)
+{
+ ADSRInfoEx * a=&s_chan[ch].ADSRX;
+ const int iSilentNow=s_chan[ch].iSilent,bStopNow=s_chan[ch].bStop;
 
-               if(s&0x8000) s|=0xffff0000;
-               fa=(s>>shift_factor);
-               fa=fa + ((s_1 * f[predict_nr][0])>>6) + ((s_2 * f[predict_nr][1])>>6);
+ a->State=a0->State;
+ a->EnvelopeVol=a0->EnvelopeVol;
+ a->EnvelopeVol_f=a0->EnvelopeVol_f;
+ a->lVolume=a0->lVolume;
 
-							 // snes brr clamps
-							 fa = CLAMP16(fa);
+ s_chan[ch].iSilent=iSilent;                           // MixADSR looks at both
+ s_chan[ch].bStop=bStop;
+ if(ns) ADSRBlock(ch,iEnvBlock,ns);
+ s_chan[ch].iSilent=iSilentNow;
+ s_chan[ch].bStop=bStopNow;
 
-               s_2=s_1;s_1=fa;
+ if(bSilenced)
+  {
+   a->lVolume=0;
+   a->EnvelopeVol=0;
+  }
+}
 
-               s_chan[ch].SB[nSample++]=fa;
-              }
+static INLINE int MixChannel(int ch,int * pbIRQReturn)
+{
+ const int bGauss=(iUseInterpolation==2 && !s_chan[ch].bNoise);
+ int bEnvBlock=(!s_chan[ch].bStop && s_chan[ch].iSilent!=2);
+ int ns,bAudible=0,iEnvDead=NSSIZE;
+ ADSRInfoEx a0=s_chan[ch].ADSRX;                       // envelope at the block start, for a break
 
-             //////////////////////////////////////////// irq check
+ if(bEnvBlock)                                         // no release: whole block in advance
+  iEnvDead=ADSRBlock(ch,iEnvBlock,NSSIZE);
 
-#if 0
-						// Check channel/loop IRQs (e.g. Castlevania Chronicles) and at pos-8 for unknown reason
-						if( Check_IRQ( (s_chan[ch].pCurr)-spuMemC, 0 ) ||
-								Check_IRQ( (start-spuMemC)-0, 0 ) ||
-								Check_IRQ( (start-spuMemC)-8, 0 ) )
-						{
-#else
-             if(irqCallback && (spuCtrl&0x40))         // some callback and irq active?
-              {
-               if((pSpuIrq >  start-16 &&              // irq address reached?
-                   pSpuIrq <= start) ||
-                  ((flags&1) &&                        // special: irq on looping addr, when stop/loop flag is set
-                   (pSpuIrq >  s_chan[ch].pLoop-16 &&
-                    pSpuIrq <= s_chan[ch].pLoop)))
-#endif
-               {
-                 s_chan[ch].iIrqDone=1;                // -> debug flag
-                 irqCallback();                      // -> call main emu (checked & called on Check_IRQ)
+ for(ns=0;ns<NSSIZE;)
+  {
+   if(s_chan[ch].bFMod==1 && iFMod[ns])                // fmod freq channel
+    FModChangeFrequency(ch,ns);
 
-                 if(iSPUIRQWait)                       // -> option: wait after irq for main emu
-                  {
-                   iSpuAsyncWait=1;
-                   bIRQReturn=1;
-                  }
-                }
-              }
+   while(s_chan[ch].spos>=0x10000L)
+    {
+     if(s_chan[ch].iSBPos==28)                         // 28 reached?
+      {
+       const int iSilent=s_chan[ch].iSilent,bStop=s_chan[ch].bStop;
+       int bSilenced=0;
 
-             //////////////////////////////////////////// flag handler
+       *pbIRQReturn|=DecodeBlock(ch,&bSilenced);
 
-						/*
-						SPU2-X:
-						$4 = set loop to current block
-						$2 = keep envelope on (no mute)
-						$1 = jump to loop address
+       if(bEnvBlock && (bSilenced || s_chan[ch].bStop!=bStop))
+        {                                              // envelope from here on per sample
+         EnvBlockBreak(ch,&a0,ns,iSilent,bStop,bSilenced);
+         bEnvBlock=0;
+         iEnvDead=NSSIZE;
+        }
+      }
 
-						silence means no volume (ADSR keeps playing!!)
-						*/
+     StoreInterpolationVal(ch,s_chan[ch].SB[s_chan[ch].iSBPos++]); // store sample data for later interpolation
 
-						if(flags&4)
-							s_chan[ch].pLoop=start-16;
+     s_chan[ch].spos -= 0x10000L;
+    }
 
+   if(s_chan[ch].iSilent==2 || ns>=iEnvDead)           // fast path: position, irqs and fmod go on,
+    {                                                  // no interpolation, no envelope
+     if(s_chan[ch].iSilent==2 && s_chan[ch].bStop)     // -> like MixADSR
+      s_chan[ch].bOn=0;
+     if(iUseInterpolation==1 && !s_chan[ch].bNoise)    // -> simple interpolation keeps its state in SB[]
+      iGetInterpolationVal(ch);
+     iEnvBlock[ns]=0;                                  // -> whatever the taps hold, the sample is 0
+    }
+   else
+    {
+     if(bGauss)                                        // gauss: only fetch the taps
+      {
+       const short * ring=(short *)&s_chan[ch].SB[29];
+       const int gpos=s_chan[ch].SB[28];
+       const int vl=(s_chan[ch].spos >> 6) & ~3;
+
+       GaussBlock.g[0][ns]=gauss[vl];   GaussBlock.t[0][ns]=ring[gpos];
+       GaussBlock.g[1][ns]=gauss[vl+1]; GaussBlock.t[1][ns]=ring[(gpos+1)&3];
+       GaussBlock.g[2][ns]=gauss[vl+2]; GaussBlock.t[2][ns]=ring[(gpos+2)&3];
+       GaussBlock.g[3][ns]=gauss[vl+3]; GaussBlock.t[3][ns]=ring[(gpos+3)&3];
+      }
+     else
+     if(s_chan[ch].bNoise)
+          iValBlock[ns]=iNoiseBlock[ns];               // get noise val
+     else iValBlock[ns]=iGetInterpolationVal(ch);      // get sample val
 
-						// Jungle Book - Rhythm 'n Groove - don't reset ignore status
-						// - fixes gameplay speed (IRQ hits)
-						//s_chan[ch].bIgnoreLoop = 0;
+     if(!bEnvBlock) iEnvBlock[ns]=MixADSR(ch);         // release or after a break: mix adsr
+     bAudible=1;
+    }
 
+   ns++;
 
-						if(flags&1)
-						{
-							// ...?
-							//s_chan[ch].bIgnoreLoop = 0;
+   s_chan[ch].spos += s_chan[ch].sinc;
 
-							// Xenogears - 7 = play missing sounds
-							// set jump flag
-							s_chan[ch].bLoopJump = 1;
+   if(!s_chan[ch].bOn) break;                          // sample end or adsr done: rest of the block is silent
+  }
 
+ dwVoiceSamples+=ns;
 
-							// silence = keep playing..?
-							if( (flags&2) == 0 ) {
-								s_chan[ch].iSilent = 1;
+ if(bAudible)
+  {
+   if(bGauss) VoiceGaussBlock(iValBlock,&GaussBlock,ns);
+   VoiceEnvelopeBlock(iChanBlock,iValBlock,iEnvBlock,ns);
+  }
+ else memset(iChanBlock,0,ns*sizeof(int));
 
-								// silence = don't start release phase
-								//s_chan[ch].bStop = 1;
+ if(s_chan[ch].bFMod==2)                               // fmod freq channel
+  memcpy(iFMod,iChanBlock,ns*sizeof(int));             // -> store 1T sample data, use that to do fmod on next channel
 
-								//start = (unsigned char *) -1;
-							}
-						}
+ return bAudible ? ns : 0;
+}
 
-#if 0
-						// crash check
-						if( start == 0 )
-							start = (unsigned char *) -1;
-						if( start >= spuMemC + 0x80000 )
-							start = spuMemC - 0x80000;
-#endif
+////////////////////////////////////////////////////////////////////////
+// add a rendered channel block to the output and reverb sums
 
+static INLINE void AccumulateChannel(int ch,int iSamples)
+{
+ if(s_chan[ch].iMute || !iSamples)                     // debug mute or nothing to hear
+  {
+   s_chan[ch].sval=0;
+   return;
+  }
 
-						// Silhouette Mirage - ending mini-game
+ VoiceVolumeBlock(SSumL,SSumR,iChanBlock,              // psx volume goes from 0 ... 0x3fff
+                  s_chan[ch].iLeftVolume,s_chan[ch].iRightVolume,iSamples);
 
-						// ??
-						if( start - spuMemC >= 0x80000 ) {
-							start -= 16;
+ if(s_chan[ch].bRVBActive)                             // now let us store sound data for reverb
+  StoreREVERB(ch,iChanBlock,iSamples);
 
-							s_chan[ch].iSilent = 1;
-							s_chan[ch].bStop = 1;
-						}
+ s_chan[ch].sval=iChanBlock[iSamples-1];
+}
 
+////////////////////////////////////////////////////////////////////////
+// MAIN SPU FUNCTION
+// here is the main job handler... thread, timer or direct func call
+// basically the whole sound processing is done in this fat func!
+////////////////////////////////////////////////////////////////////////
 
-             s_chan[ch].pCurr=start;                   // store values for next cycle
-             s_chan[ch].s_1=s_1;
-             s_chan[ch].s_2=s_2;
-            }
+// 5 ms waiting phase, if buffer is full and no new sound has to get started
+// .. can be made smaller (smallest val: 1 ms), but bigger waits give
+// better performance
 
-           fa=s_chan[ch].SB[s_chan[ch].iSBPos++];      // get sample data
+#define PAUSE_W 1
+#define PAUSE_L 1000
 
-           StoreInterpolationVal(ch,fa);               // store val for later interpolation
+////////////////////////////////////////////////////////////////////////
 
-           s_chan[ch].spos -= 0x10000L;
-          }
+#if defined(_WINDOWS) || defined(_XBOX)
+static VOID CALLBACK MAINProc(UINT nTimerId, UINT msg, DWORD dwUser, DWORD dwParam1, DWORD dwParam2)
+#else
+static void *MAINThread(void *arg)
+#endif
+{
+ int ns,ch,d;
+ int voldiv = iVolume;
+ int bIRQReturn=0;
+ uint32_t dwChannels;
 
-         if(s_chan[ch].bNoise)
-              fa=iGetNoiseVal(ch);                     // get noise val
-         else fa=iGetInterpolationVal(ch);             // get sample val
+ // mute output
+ if( voldiv == 5 ) voldiv = 0x7fffffff;
 
-/*
-				 // Voice 1/3 decoded buffer
-				 if( ch == 0 ) {
-					 spuMem[ (0x800 + decoded_voice) / 2 ] = (short) fa;
-				 } else if( ch == 2 ) {
-					 spuMem[ (0xc00 + decoded_voice) / 2 ] = (short) fa;
-				 }
-*/
+ while(!bEndThread)                                    // until we are shutting down
+  {
+   // ok, at the beginning we are looking if there is
+   // enuff free place in the dsound/oss buffer to
+   // fill in new data, or if there is a new channel to start.
+   // if not, we wait (thread) or return (timer/spuasync)
+   // until enuff free place is available/a new channel gets
+   // started
 
-         s_chan[ch].sval = (MixADSR(ch) * fa) / 1023;  // mix adsr
+   if(dwNewChannel)                                    // new channel should start immedately?
+    {                                                  // (at least one bit 0 ... MAXCHANNEL is set?)
+     iSecureStart++;                                   // -> set iSecure
+     if(iSecureStart>1) iSecureStart=0;                //    (if it is set 5 times - that means on 5 tries a new samples has been started - in a row, we will reset it, to give the sound update a chance)
+    }
+   else iSecureStart=0;                                // 0: no new channel should start
 
-         if(s_chan[ch].bFMod==2)                       // fmod freq channel
-          iFMod[ns]=s_chan[ch].sval;                   // -> store 1T sample data, use that to do fmod on next channel
+   while(!iSecureStart && !bEndThread &&               // no new start? no thread end?
+         (SoundGetBytesBuffered()>TESTSIZE))           // and still enuff data in sound buffer?
+    {
+     iSecureStart=0;                                   // reset secure
 
-				 // mix fmod channel into output
-				 // - Xenogears save icon (high pitch)
-				 {
-           //////////////////////////////////////////////
-           // ok, left/right sound volume (psx volume goes from 0 ... 0x3fff)
+#if defined(_WINDOWS) || defined(_XBOX)
+#ifndef _XBOX
+     if(iUseTimer)                                     // no-thread mode?
+      {
+       if(iUseTimer==1)                                // -> ok, timer mode 1: setup a oneshot timer of x ms to wait
+        timeSetEvent(PAUSE_W,1,MAINProc,0,TIME_ONESHOT);
+       return;                                         // -> and done this time (timer mode 1 or 2)
+      }
+#else
+//	 if(iUseTimer) return 0;							   // linux no-thread mode? bye
+	 if(iUseTimer) return;							   // linux no-thread mode? bye
+#endif
+	 // win thread mode:
+     Sleep(PAUSE_W);                                   // sleep for x ms (win)
+#else
+     if(iUseTimer) return 0;                           // linux no-thread mode? bye
+     usleep(PAUSE_L);                                  // else sleep for x ms (linux)
+#endif
 
-           if(s_chan[ch].iMute)
-            s_chan[ch].sval=0;                         // debug mute
-           else
-            {
-             SSumL[ns]+=(s_chan[ch].sval*s_chan[ch].iLeftVolume)/0x4000L;
-             SSumR[ns]+=(s_chan[ch].sval*s_chan[ch].iRightVolume)/0x4000L;
-            }
+     if(dwNewChannel) iSecureStart=1;                  // if a new channel kicks in (or, of course, sound buffer runs low), we will leave the loop
+    }
 
-           //////////////////////////////////////////////
-           // now let us store sound data for reverb
+   //--------------------------------------------------//
+   //- main channel loop                              -//
+   //--------------------------------------------------//
 
-           if(s_chan[ch].bRVBActive) StoreREVERB(ch,ns);
-          }
+   memset(SSumL,0,NSSIZE*sizeof(int));
+   memset(SSumR,0,NSSIZE*sizeof(int));
 
-				 s_chan[ch].spos += s_chan[ch].sinc;
-        }
+   dwActiveChannel|=TakeNewChannels();                 // key ons join the voice list
 
-        ////////////////////////////////////////////////
-        // ok, go on until 1 ms data of this channel is collected
-/*
-				// decoded buffer - voice
-				decoded_voice += 2;
-				decoded_voice &= 0x3ff;
+   NoiseBlock();
 
+   // only the voices in the list, in ascending order: a fmod channel is
+   // modulated by the one below it, which has stored its whole block in
+   // iFMod[] by then
 
-				// status flag
-				if( decoded_voice >= 0x200 ) {
-					spuStat |= STAT_DECODED;
-				} else {
-					spuStat &= ~STAT_DECODED;
-				}
+   dwChannels=dwActiveChannel;
+   while(dwChannels)
+    {
+     int iSamples;
 
+     ch=LowestChannel(dwChannels);
+     dwChannels&=dwChannels-1;
 
-				// IRQ work
-				{
-					unsigned char *old_irq;
-					unsigned int old_ptr;
+     if(s_chan[ch].bNew) StartSound(ch);               // start new sound
+     if(!s_chan[ch].bOn)                               // channel not playing? drop it
+      {
+       dwActiveChannel&=~(1<<ch);
+       continue;
+      }
 
-					old_irq = pSpuIrq;
-					old_ptr = decoded_voice;
+     if(s_chan[ch].iActFreq!=s_chan[ch].iUsedFreq)     // new psx frequency?
+      VoiceChangeFrequency(ch);
 
-#if 0
-					// align to boundaries ($0, $200, $400, $600)
-					pSpuIrq = ((pSpuIrq - spuMemC) & (~0x1ff)) + spuMemC;
-					decoded_voice = decoded_voice & (~0x1ff);
-#endif
+     iSamples=MixChannel(ch,&bIRQReturn);
+     AccumulateChannel(ch,iSamples);
 
-					// check all decoded buffer IRQs - timing issue
-					Check_IRQ( decoded_voice + 0x000, 0 );
-					Check_IRQ( decoded_voice + 0x400, 0 );
-					Check_IRQ( decoded_voice + 0x800, 0 );
-					Check_IRQ( decoded_voice + 0xc00, 0 );
+     if(!s_chan[ch].bOn) dwActiveChannel&=~(1<<ch);    // stopped in this block
+    }
 
-					pSpuIrq = old_irq;
-					decoded_voice = old_ptr;
-				}
-*/
-         if(bIRQReturn)                            // special return for "spu irq - wait for cpu action"
-          {
-           bIRQReturn=0;
-           if(iUseTimer!=2)
-            {
-             DWORD dwWatchTime=timeGetTime_spu()+2500;
-
-             while(iSpuAsyncWait && !bEndThread &&
-                   timeGetTime_spu()<dwWatchTime)
-#if defined(_WINDOWS) || defined(_XBOX)
-                 Sleep(1);
-#else
-                 usleep(1000L);
-#endif
-            }
-           else
-            {
-             lastns=ns+1;
+   if(bIRQReturn)                                      // special return for "spu irq - wait for cpu action"
+    {                                                  // (timer mode 2: SPUasync stops calling us instead)
+     bIRQReturn=0;
+     if(iUseTimer!=2)
+      {
+       DWORD dwWatchTime=timeGetTime_spu()+2500;
 
+       while(iSpuAsyncWait && !bEndThread &&
+             timeGetTime_spu()<dwWatchTime)
 #if defined(_WINDOWS) || defined(_XBOX)
- //          return 0;
-			 return;
+           Sleep(1);
 #else
-             return 0;
+           usleep(1000L);
 #endif
-           }
-         }
-
-        ns++;
-      } // end ns
+      }
     }
 
 
@@ -959,9 +1006,13 @@ if(!tombraider2fix)
 
   MixXA();
 
+  MixREVERB(SSumL,SSumR);                              // reverb unit output (22050 Hz inside)
+
+  dwMixedSamples+=NSSIZE;
+
 
 	// now safe to update decoded buffer ptr
-	decoded_ptr += ns * 2;
+	decoded_ptr += NSSIZE * 2;
 	decoded_ptr &= 0x3ff;
 
 
@@ -973,13 +1024,9 @@ if(!tombraider2fix)
     int dl, dr;
     for (ns = 0; ns < NSSIZE; ns++)
      {
-      SSumL[ns] += MixREVERBLeft(ns);
-
       dl = SSumL[ns] / voldiv; SSumL[ns] = 0;
       if (dl < -32767) dl = -32767; if (dl > 32767) dl = 32767;
 
-      SSumR[ns] += MixREVERBRight();
-
       dr = SSumR[ns] / voldiv; SSumR[ns] = 0;
       if (dr < -32767) dr = -32767; if (dr > 32767) dr = 32767;
       *pS++ = (dl + dr) / 2;
@@ -994,9 +1041,6 @@ if(!tombraider2fix)
 			int sl,sr;
 			double ldiff, rdiff, avg, tmp;
 
-			SSumL[ns]+=MixREVERBLeft(ns);
-			SSumR[ns]+=MixREVERBRight();
-
 			sl = SSumL[ns]; SSumL[ns]=0;
 			sr = SSumR[ns]; SSumR[ns]=0;
 
@@ -1036,8 +1080,6 @@ if(!tombraider2fix)
 			*pS++=sl/voldiv;
 			*pS++=sr/voldiv;
 		} else {
-			SSumL[ns]+=MixREVERBLeft(ns);
-
 			// Limiter para prevenir overflow
 			if (SSumL[ns] > 98304) SSumL[ns] = 98304;
 			if (SSumL[ns] < -98304) SSumL[ns] = -98304;
@@ -1046,8 +1088,6 @@ if(!tombraider2fix)
 			if(d<-32767) d=-32767;if(d>32767) d=32767;
 			*pS++=d;
 
-			SSumR[ns]+=MixREVERBRight();
-
 			// Limiter para prevenir overflow
 			if (SSumR[ns] > 98304) SSumR[ns] = 98304;
 			if (SSumR[ns] < -98304) SSumR[ns] = -98304;
@@ -1077,7 +1117,10 @@ if(!tombraider2fix)
   // in some of Peops timer modes. So: we ignore this option here (for now).
 
 #ifdef CRASH_TEAM_RACING
-   if(pMixIrq && irqCallback)
+   {
+   void (CALLBACK *callback)(void)=irqCallback;         // read once, the core may change it
+
+   if(pMixIrq && callback)
    {
     for(ns=0;ns<NSSIZE;ns++)
      {
@@ -1086,14 +1129,14 @@ if(!tombraider2fix)
         for(ch=0;ch<4;ch++)
          {
           if(pSpuIrq>=pMixIrq+(ch*0x400) && pSpuIrq<pMixIrq+(ch*0x400)+2)
-           {irqCallback();s_chan[ch].iIrqDone=1;}
+           {callback();s_chan[ch].iIrqDone=1;}
          }
        }
       pMixIrq+=2;if(pMixIrq>spuMemC+0x3ff) pMixIrq=spuMemC;
      }
     }
+   }
 #endif
-  InitREVERB();
 
   //////////////////////////////////////////////////////
   // feed the sound
@@ -1122,6 +1165,8 @@ if(!tombraider2fix)
 #if defined(_WINDOWS) || defined(_XBOX)
  //return 0;
    return;
+#else
+ return 0;
 #endif
 }
 
@@ -1145,6 +1190,8 @@ DWORD WINAPI MAINThreadEx(LPVOID lpParameter)
 long cpu_cycles;
 void CALLBACK SPUasync(unsigned long cycle)
 {
+ if(iSPUCapture) SPUcapAsync(cycle);
+
 	cpu_cycles += cycle;
 
  if(iSpuAsyncWait)
@@ -1208,6 +1255,8 @@ void CALLBACK SPUplayADPCMchannel(xa_decode_t *xap)
  if(!xap)       return;
  if(!xap->freq) return;                                // no xa freq ? bye
 
+ if(iSPUCapture) SPUcapXA(xap);
+
  FeedXA(xap);                                          // call main XA feeder
 }
 
@@ -1217,6 +1266,8 @@ void CALLBACK SPUplayCDDAchannel(short *pcm, int nbytes)
  if (!pcm)      return;
  if (nbytes<=0) return;
 
+ if(iSPUCapture) SPUcapCDDA((unsigned char *)pcm,nbytes);
+
  FeedCDDA((unsigned char *)pcm, nbytes);
 }
 
@@ -1309,15 +1360,7 @@ void SetupStreams(void)
 
  pSpuBuffer=(unsigned char *)malloc(32768);            // alloc mixing buffer
 
- if(iUseReverb==1) i=88200*2;
- else              i=NSSIZE*2;
-
- sRVBStart = (int *)malloc(i*4);                       // alloc reverb buffer
- memset(sRVBStart,0,i*4);
- sRVBEnd  = sRVBStart + i;
- sRVBPlay = sRVBStart;
-
- InitReverbSystem();
+ InitREVERB();                                         // clear reverb resampler
  XAStart =                                             // alloc xa buffer
   (uint32_t *)malloc(44100 * sizeof(uint32_t));
  XAEnd   = XAStart + 44100;
@@ -1351,9 +1394,6 @@ void RemoveStreams(void)
 {
  free(pSpuBuffer);                                     // free mixing buffer
  pSpuBuffer = NULL;
- free(sRVBStart);                                      // free reverb buffer
- sRVBStart = NULL;
- ShutdownReverbSystem();
  free(XAStart);                                        // free XA buffer
  XAStart = NULL;
  free(CDDAStart);                                      // free CDDA buffer
@@ -1371,9 +1411,10 @@ long CALLBACK SPUinit(void)
  spuMemC = (unsigned char *)spuMem;                    // just small setup
  memset((void *)&rvb, 0, sizeof(REVERBInfo));
  InitADSR();
+ InitXA();
 
  iVolume = 3;
- iReverbOff = -1;
+ InitREVERB();
  spuIrq = 0;
  spuAddr = 0x200;
  bEndThread = 0;
@@ -1382,9 +1423,11 @@ long CALLBACK SPUinit(void)
  spuMemC = (unsigned char *)spuMem;
  pMixIrq = 0;
  memset((void *)s_chan, 0, (MAXCHAN + 1) * sizeof(SPUCHAN));
+ dwNewChannel = 0;
+ dwActiveChannel = 0;
+ dwNoiseChannel = 0;
  pSpuIrq = 0;
  iSPUIRQWait = 1;
- lastns = 0;
 
  ReadConfig();                                         // read user stuff
  SetupStreams();                                       // prepare streaming
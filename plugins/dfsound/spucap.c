@@ -0,0 +1,223 @@
+/***************************************************************************
+                          spucap.c  -  description
+                             -------------------
+ SPU command-stream capture (plugin boundary recorder)
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "stdafx.h"
+
+#include "externals.h"
+#include "spucap.h"
+
+////////////////////////////////////////////////////////////////////////
+// Everything the emu hands to the spu is appended to a file, see
+// spucap.h for the layout. Records carry the number of samples the
+// mixer had produced at that point and the psx cycles seen through
+// SPUasync, so a replay can apply them at the same place of the
+// output stream or redo the emu timing. The frontend only sets a
+// request, the file is opened/closed on the emu thread.
+////////////////////////////////////////////////////////////////////////
+
+#define CAPBUFSIZE (256*1024)
+
+volatile int         iSPUCapture=0;
+
+static FILE *        fCap=NULL;
+static volatile int  iCapRequest=0;                    // 1: start, 2: stop
+static char          szCapFile[260];
+static uint32_t      dwCapStart=0;                     // dwMixedSamples at start
+static uint32_t      dwCapCycles=0;                    // SPUasync cycles since start
+
+////////////////////////////////////////////////////////////////////////
+
+static void CapPut8(unsigned char c)
+{
+ fputc(c,fCap);
+}
+
+static void CapPut16(unsigned short s)
+{
+ unsigned char b[2];
+
+ b[0]=(unsigned char)s;                                // always little endian
+ b[1]=(unsigned char)(s>>8);
+ fwrite(b,2,1,fCap);
+}
+
+static void CapPut32(uint32_t l)
+{
+ unsigned char b[4];
+
+ b[0]=(unsigned char)l;
+ b[1]=(unsigned char)(l>>8);
+ b[2]=(unsigned char)(l>>16);
+ b[3]=(unsigned char)(l>>24);
+ fwrite(b,4,1,fCap);
+}
+
+static void CapRecord(unsigned char type)
+{
+ CapPut8(type);
+ CapPut32(dwMixedSamples-dwCapStart);
+ CapPut32(dwCapCycles);
+}
+
+////////////////////////////////////////////////////////////////////////
+// open/close, done by the first hook call after a request
+////////////////////////////////////////////////////////////////////////
+
+static void CapOpen(void)
+{
+ int i;
+
+ fCap=fopen(szCapFile,"wb");
+ if(!fCap) return;
+
+ setvbuf(fCap,NULL,_IOFBF,CAPBUFSIZE);
+
+ dwCapStart=dwMixedSamples;
+ dwCapCycles=0;
+
+ fwrite(SPUCAP_MAGIC,8,1,fCap);
+ CapPut32(SPUCAP_VERSION);
+ for(i=0;i<256;i++) CapPut16(regArea[i]);
+ fwrite(spuMem,1,512*1024,fCap);                       // spu ram is psx byte order already
+}
+
+static void CapClose(void)
+{
+ CapRecord(SPUCAP_END);
+ fclose(fCap);
+ fCap=NULL;
+}
+
+static int CapReady(void)
+{
+ if(iCapRequest)
+  {
+   if(iCapRequest==2 && fCap) CapClose();
+   else
+   if(iCapRequest==1 && !fCap) CapOpen();
+
+   iCapRequest=0;
+   iSPUCapture=(fCap!=NULL);
+  }
+
+ return fCap!=NULL;
+}
+
+////////////////////////////////////////////////////////////////////////
+// frontend interface
+////////////////////////////////////////////////////////////////////////
+
+void SPUcaptureStart(const char * pFileName)
+{
+ if(fCap || iCapRequest) return;
+
+ strncpy(szCapFile,pFileName,sizeof(szCapFile)-1);
+ szCapFile[sizeof(szCapFile)-1]=0;
+ iCapRequest=1;
+ iSPUCapture=1;
+}
+
+void SPUcaptureStop(void)
+{
+ if(fCap) {iCapRequest=2;iSPUCapture=1;}
+ else      iCapRequest=0;                              // cancel a pending start
+}
+
+int SPUcaptureActive(void)
+{
+ return fCap!=NULL || iCapRequest==1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// spu hooks
+////////////////////////////////////////////////////////////////////////
+
+void SPUcapWriteRegister(uint32_t reg, unsigned short val)
+{
+ if(!CapReady()) return;
+ CapRecord(SPUCAP_WRITEREG);
+ CapPut32(reg);
+ CapPut16(val);
+}
+
+void SPUcapReadRegister(uint32_t reg, unsigned short val)
+{
+ if(!CapReady()) return;
+ CapRecord(SPUCAP_READREG);
+ CapPut32(reg);
+ CapPut16(val);
+}
+
+void SPUcapAsync(uint32_t cycle)
+{
+ if(!CapReady()) return;
+ dwCapCycles+=cycle;
+ CapRecord(SPUCAP_ASYNC);
+ CapPut32(cycle);
+}
+
+void SPUcapWriteDMA(unsigned short val)
+{
+ if(!CapReady()) return;
+ CapRecord(SPUCAP_WRITEDMA);
+ CapPut16(val);
+}
+
+void SPUcapWriteDMAMem(const unsigned short * pusPSXMem, int iSize)
+{
+ if(!CapReady() || iSize<=0) return;
+ CapRecord(SPUCAP_WRITEDMAMEM);
+ CapPut32((uint32_t)iSize);
+ fwrite(pusPSXMem,2,iSize,fCap);                       // raw psx halfwords
+}
+
+void SPUcapReadDMA(void)
+{
+ if(!CapReady()) return;
+ CapRecord(SPUCAP_READDMA);
+}
+
+void SPUcapReadDMAMem(int iSize)
+{
+ if(!CapReady()) return;
+ CapRecord(SPUCAP_READDMAMEM);
+ CapPut32((uint32_t)iSize);
+}
+
+void SPUcapXA(const xa_decode_t * xap)
+{
+ int i,iCount;
+
+ if(!CapReady()) return;
+
+ iCount=xap->nsamples*(xap->stereo?2:1);
+ if(iCount<0)     iCount=0;
+ if(iCount>16384) iCount=16384;
+
+ CapRecord(SPUCAP_XA);
+ CapPut32((uint32_t)xap->freq);
+ CapPut32((uint32_t)xap->nbits);
+ CapPut32((uint32_t)xap->stereo);
+ CapPut32((uint32_t)(iCount/(xap->stereo?2:1)));
+ for(i=0;i<iCount;i++) CapPut16((unsigned short)xap->pcm[i]);
+}
+
+void SPUcapCDDA(const unsigned char * pcm, int nbytes)
+{
+ if(!CapReady() || nbytes<=0) return;
+ CapRecord(SPUCAP_CDDA);
+ CapPut32((uint32_t)nbytes);
+ fwrite(pcm,1,nbytes,fCap);
+}
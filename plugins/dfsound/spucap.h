@@ -0,0 +1,101 @@
+/***************************************************************************
+                          spucap.h  -  description
+                             -------------------
+ SPU command-stream capture (plugin boundary recorder)
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef _SPU_CAPTURE_H_
+#define _SPU_CAPTURE_H_
+
+#include <stdint.h>
+#include "psemuxa.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// file layout (every integer is little endian)
+//
+// header:
+//  char     magic[8]             "PSXSPCAP"
+//  uint32   version              SPUCAP_VERSION
+//  uint16   regs[256]            0x1f801c00-0x1f801dff, as last written
+//  uint8    spuram[512*1024]
+//
+// records, one type byte, the two stamps, then the payload:
+//  uint32   stamp                44.1 kHz output samples mixed since
+//                                the capture started
+//  uint32   cycle                psx cycles handed to SPUasync since the
+//                                capture started (version 2 and up)
+//  SPUCAP_WRITEREG     uint32 reg, uint16 value
+//  SPUCAP_READREG      uint32 reg, uint16 value returned
+//  SPUCAP_WRITEDMA     uint16 value
+//  SPUCAP_WRITEDMAMEM  uint32 count, count raw psx halfwords
+//  SPUCAP_READDMA      -
+//  SPUCAP_READDMAMEM   uint32 count
+//  SPUCAP_XA           int32 freq, nbits, stereo, nsamples, then
+//                      nsamples (x2 if stereo) int16 pcm values
+//  SPUCAP_CDDA         uint32 bytes, raw cdda bytes
+//  SPUCAP_ASYNC        uint32 cycles of the SPUasync call (already
+//                      counted in its cycle stamp)
+//  SPUCAP_END          stamps only
+//
+// the cycle stamp only moves with SPUasync: with the threaded spu
+// (libpcsxcore/spu.c) that is the psx cycle of every command, in the
+// synchronous mode the last counter tick before it. Version 1 files
+// have neither the cycle stamp nor READREG/ASYNC records.
+//
+// voices playing when the capture starts are not saved, a replay
+// rewrites the registers (like a state of unknown format) and picks
+// up from the next key on.
+////////////////////////////////////////////////////////////////////////
+
+#define SPUCAP_MAGIC        "PSXSPCAP"
+#define SPUCAP_VERSION      2
+
+#define SPUCAP_WRITEREG     0x01
+#define SPUCAP_WRITEDMA     0x02
+#define SPUCAP_WRITEDMAMEM  0x03
+#define SPUCAP_READDMA      0x04
+#define SPUCAP_READDMAMEM   0x05
+#define SPUCAP_XA           0x06
+#define SPUCAP_CDDA         0x07
+#define SPUCAP_READREG      0x08
+#define SPUCAP_ASYNC        0x09
+#define SPUCAP_END          0xff
+
+// frontend side (any thread): served on the next spu call of the emu
+void SPUcaptureStart(const char * pFileName);
+void SPUcaptureStop(void);
+int  SPUcaptureActive(void);
+
+// plugin side, only called while iSPUCapture is set (capture running
+// or a start/stop pending)
+extern volatile int iSPUCapture;
+extern uint32_t     dwMixedSamples;                    // spu.c, output samples mixed
+
+void SPUcapWriteRegister(uint32_t reg, unsigned short val);
+void SPUcapReadRegister(uint32_t reg, unsigned short val);
+void SPUcapAsync(uint32_t cycle);
+void SPUcapWriteDMA(unsigned short val);
+void SPUcapWriteDMAMem(const unsigned short * pusPSXMem, int iSize);
+void SPUcapReadDMA(void);
+void SPUcapReadDMAMem(int iSize);
+void SPUcapXA(const xa_decode_t * xap);
+void SPUcapCDDA(const unsigned char * pcm, int nbytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SPU_CAPTURE_H_
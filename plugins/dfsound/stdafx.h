@@ -69,6 +69,9 @@
 #undef CALLBACK
 #define CALLBACK
 #define DWORD unsigned int
+#ifndef BOOL
+#define BOOL int
+#endif
 #define LOWORD(l)           ((unsigned short)(l)) 
 #define HIWORD(l)           ((unsigned short)(((unsigned int)(l) >> 16) & 0xFFFF)) 
 
@@ -118,4 +121,5 @@
 
 #define SWAP16(x) _byteswap_ushort(x)
 #else
+#define SWAP16(x) (x)                                  // host tools (tools/) are little endian
 #endif
\ No newline at end of file
@@ -0,0 +1,251 @@
+/***************************************************************************
+                          voiceblk.c  -  description
+                             -------------------
+ Block kernels of the channel mixer and the reverb resampler
+
+ MixChannel walks a voice through a whole block first (pitch, sample
+ decoding, interpolation ring, envelope) and keeps the per sample inputs
+ in small arrays. The arithmetic on them has no dependency between
+ samples and runs here, 4 samples per vector on SSE2 hosts:
+
+  - the 4 tap gauss filter, each product rounded down to 2048 first
+  - the envelope, /1023 done exactly with shifts and adds
+  - left/right volume into the output sums, /0x4000 as a shift with
+    the rounding towards zero of the old division
+  - the half band FIRs that take the reverb input down to 22050 Hz and
+    its output back up, left and right side in one pass
+
+ Every kernel gives the same result as the old per sample code. The 360
+ builds use the scalar versions for now (VMX has no 32 bit integer
+ multiply), they still get the tighter loops of the block layout.
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "voiceblk.h"
+
+#if defined(_XBOX)
+// scalar
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#define VOICE_SSE2
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// scalar reference
+////////////////////////////////////////////////////////////////////////
+
+static void GaussRange(int * dst, const GAUSSBLOCK * b, int i, int n)
+{
+ int vr;
+
+ for(; i < n; i++)
+  {
+   vr =(b->g[0][i] * b->t[0][i]) & ~2047;
+   vr+=(b->g[1][i] * b->t[1][i]) & ~2047;
+   vr+=(b->g[2][i] * b->t[2][i]) & ~2047;
+   vr+=(b->g[3][i] * b->t[3][i]) & ~2047;
+   dst[i] = vr >> 11;
+  }
+}
+
+void VoiceGaussBlock_C(int * dst, const GAUSSBLOCK * b, int n)
+{
+ GaussRange(dst, b, 0, n);
+}
+
+void VoiceEnvelopeBlock_C(int * dst, const int * val, const int * env, int n)
+{
+ int i;
+
+ for(i = 0; i < n; i++)
+  dst[i] = (env[i] * val[i]) / 1023;
+}
+
+void VoiceVolumeBlock_C(int * sumL, int * sumR, const int * src, int volL, int volR, int n)
+{
+ int i;
+
+ for(i = 0; i < n; i++)
+  {
+   sumL[i] += (src[i] * volL) / 0x4000;
+   sumR[i] += (src[i] * volR) / 0x4000;
+  }
+}
+
+void ReverbFirBlock_C(int * dstL, int * dstR, const short * l, const short * r,
+                      const short * taps, int ntaps, int step, int n)
+{
+ int i, k, sl, sr;
+
+ for(i = 0; i < n; i++, l += step, r += step)
+  {
+   sl = sr = 0;
+   for(k = 0; k < ntaps; k++)
+    {
+     sl += taps[k] * l[k];
+     sr += taps[k] * r[k];
+    }
+   dstL[i] = sl;
+   dstR[i] = sr;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// SSE2 (SSE4.1 multiply if available)
+////////////////////////////////////////////////////////////////////////
+
+#if defined(VOICE_SSE2)
+
+// low 32 bits of a 32x32 multiply
+static __inline __m128i MulLo32(__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+ return _mm_mullo_epi32(a, b);
+#else
+ __m128i e = _mm_mul_epu32(a, b);
+ __m128i o = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+ return _mm_unpacklo_epi32(_mm_shuffle_epi32(e, _MM_SHUFFLE(0, 0, 2, 0)),
+                           _mm_shuffle_epi32(o, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+// x / 1023 rounded towards zero, for |x| < 2^26:
+// a = h*1024 + l -> a/1023 = h + (h+l)/1023, and y/1023 = (y + (y>>10) + 1) >> 10
+static __inline __m128i Div1023(__m128i x)
+{
+ const __m128i m = _mm_set1_epi32(1023);
+ const __m128i one = _mm_set1_epi32(1);
+ __m128i s = _mm_srai_epi32(x, 31);
+ __m128i a = _mm_sub_epi32(_mm_xor_si128(x, s), s);
+ __m128i h = _mm_srli_epi32(a, 10);
+ __m128i y = _mm_add_epi32(h, _mm_and_si128(a, m));
+ __m128i q = _mm_add_epi32(h, _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(y, _mm_srli_epi32(y, 10)), one), 10));
+ return _mm_sub_epi32(_mm_xor_si128(q, s), s);
+}
+
+// x / 0x4000 rounded towards zero
+static __inline __m128i Div4000(__m128i x)
+{
+ return _mm_srai_epi32(_mm_add_epi32(x, _mm_and_si128(_mm_srai_epi32(x, 31), _mm_set1_epi32(0x3fff))), 14);
+}
+
+#define VLOAD(p)     _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+
+void VoiceGaussBlock(int * dst, const GAUSSBLOCK * b, int n)
+{
+ const __m128i mask = _mm_set1_epi32(~2047);
+ __m128i vr;
+ int i = 0;
+
+ // gauss entries have a zero upper half and the taps are 16 bit, so
+ // pmaddwd makes the exact 32 bit product of each lane
+ for(; i + 4 <= n; i += 4)
+  {
+   vr =                   _mm_and_si128(_mm_madd_epi16(VLOAD(&b->g[0][i]), VLOAD(&b->t[0][i])), mask);
+   vr = _mm_add_epi32(vr, _mm_and_si128(_mm_madd_epi16(VLOAD(&b->g[1][i]), VLOAD(&b->t[1][i])), mask));
+   vr = _mm_add_epi32(vr, _mm_and_si128(_mm_madd_epi16(VLOAD(&b->g[2][i]), VLOAD(&b->t[2][i])), mask));
+   vr = _mm_add_epi32(vr, _mm_and_si128(_mm_madd_epi16(VLOAD(&b->g[3][i]), VLOAD(&b->t[3][i])), mask));
+   VSTORE(&dst[i], _mm_srai_epi32(vr, 11));
+  }
+
+ if(i < n) GaussRange(dst, b, i, n);
+}
+
+void VoiceEnvelopeBlock(int * dst, const int * val, const int * env, int n)
+{
+ int i = 0;
+
+ for(; i + 4 <= n; i += 4)
+  VSTORE(&dst[i], Div1023(MulLo32(VLOAD(&env[i]), VLOAD(&val[i]))));
+
+ if(i < n) VoiceEnvelopeBlock_C(dst + i, val + i, env + i, n - i);
+}
+
+void VoiceVolumeBlock(int * sumL, int * sumR, const int * src, int volL, int volR, int n)
+{
+ const __m128i vl = _mm_set1_epi32(volL);
+ const __m128i vr = _mm_set1_epi32(volR);
+ __m128i s;
+ int i = 0;
+
+ for(; i + 4 <= n; i += 4)
+  {
+   s = VLOAD(&src[i]);
+   VSTORE(&sumL[i], _mm_add_epi32(VLOAD(&sumL[i]), Div4000(MulLo32(s, vl))));
+   VSTORE(&sumR[i], _mm_add_epi32(VLOAD(&sumR[i]), Div4000(MulLo32(s, vr))));
+  }
+
+ if(i < n) VoiceVolumeBlock_C(sumL + i, sumR + i, src + i, volL, volR, n - i);
+}
+
+void ReverbFirBlock(int * dstL, int * dstR, const short * l, const short * r,
+                    const short * taps, int ntaps, int step, int n)
+{
+ __m128i t, al, ar;
+ int i, k;
+
+ for(i = 0; i < n; i++, l += step, r += step)
+  {
+   al = ar = _mm_setzero_si128();
+   for(k = 0; k < ntaps; k += 8)
+    {
+     t  = VLOAD(&taps[k]);
+     al = _mm_add_epi32(al, _mm_madd_epi16(t, VLOAD(&l[k])));
+     ar = _mm_add_epi32(ar, _mm_madd_epi16(t, VLOAD(&r[k])));
+    }
+   // l0+l2 r0+r2 l1+l3 r1+r3 -> lane 0 left, lane 1 right
+   t = _mm_add_epi32(_mm_unpacklo_epi32(al, ar), _mm_unpackhi_epi32(al, ar));
+   t = _mm_add_epi32(t, _mm_srli_si128(t, 8));
+   dstL[i] = _mm_cvtsi128_si32(t);
+   dstR[i] = _mm_cvtsi128_si32(_mm_srli_si128(t, 4));
+  }
+}
+
+#ifdef __SSE4_1__
+const char * VoiceKernelName(void) { return "sse4.1"; }
+#else
+const char * VoiceKernelName(void) { return "sse2"; }
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// no SIMD
+////////////////////////////////////////////////////////////////////////
+
+#else
+
+void VoiceGaussBlock(int * dst, const GAUSSBLOCK * b, int n)
+{
+ VoiceGaussBlock_C(dst, b, n);
+}
+
+void VoiceEnvelopeBlock(int * dst, const int * val, const int * env, int n)
+{
+ VoiceEnvelopeBlock_C(dst, val, env, n);
+}
+
+void VoiceVolumeBlock(int * sumL, int * sumR, const int * src, int volL, int volR, int n)
+{
+ VoiceVolumeBlock_C(sumL, sumR, src, volL, volR, n);
+}
+
+void ReverbFirBlock(int * dstL, int * dstR, const short * l, const short * r,
+                    const short * taps, int ntaps, int step, int n)
+{
+ ReverbFirBlock_C(dstL, dstR, l, r, taps, ntaps, step, n);
+}
+
+const char * VoiceKernelName(void) { return "scalar"; }
+
+#endif
@@ -0,0 +1,60 @@
+/***************************************************************************
+                          voiceblk.h  -  description
+                             -------------------
+ Block kernels of the channel mixer (gauss filter, envelope and volume)
+ and the reverb resampler, see voiceblk.c
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef _SPU_VOICEBLK_H_
+#define _SPU_VOICEBLK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// one mixer block (NSSIZE samples) rounded up to whole vectors
+#define VOICE_BLOCK 24
+
+// the 4 taps of every sample of a block, one row per tap: gauss table
+// entries (0..0x519) and the interpolation ring values (16 bit)
+typedef struct
+{
+ int g[4][VOICE_BLOCK];
+ int t[4][VOICE_BLOCK];
+} GAUSSBLOCK;
+
+// dst[i] = sum((g[k][i]*t[k][i]) & ~2047) >> 11, like iGetInterpolationVal
+void VoiceGaussBlock(int * dst, const GAUSSBLOCK * b, int n);
+// dst[i] = (env[i]*val[i]) / 1023, env 0..1023 (MixADSR)
+void VoiceEnvelopeBlock(int * dst, const int * val, const int * env, int n);
+// sumL[i] += (src[i]*volL) / 0x4000, same for the right side, vol 0..0x3fff
+void VoiceVolumeBlock(int * sumL, int * sumR, const int * src, int volL, int volR, int n);
+// FIR over both reverb sides: dstL[i] = sum(taps[k]*l[i*step+k]), k < ntaps
+// (a multiple of 8), same for the right side
+void ReverbFirBlock(int * dstL, int * dstR, const short * l, const short * r,
+                    const short * taps, int ntaps, int step, int n);
+
+// scalar reference versions, always compiled (verification / fallback)
+void VoiceGaussBlock_C(int * dst, const GAUSSBLOCK * b, int n);
+void VoiceEnvelopeBlock_C(int * dst, const int * val, const int * env, int n);
+void VoiceVolumeBlock_C(int * sumL, int * sumR, const int * src, int volL, int volR, int n);
+void ReverbFirBlock_C(int * dstL, int * dstR, const short * l, const short * r,
+                      const short * taps, int ntaps, int step, int n);
+
+// name of the kernel set selected at compile time ("sse2", "scalar")
+const char * VoiceKernelName(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SPU_VOICEBLK_H_
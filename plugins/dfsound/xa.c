@@ -19,7 +19,9 @@
 
 #define _IN_XA
 #include <stdint.h>
+#ifdef _XBOX
 #include <xtl.h>
+#endif
 
 // will be included from spu.c
 #ifdef _IN_SPU
@@ -57,188 +59,259 @@ static int UNUSED_VARIABLE gauss_window[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 long cdxa_dbuf_ptr;
 
 ////////////////////////////////////////////////////////////////////////
-// MIX XA & CDDA
+// XA RESAMPLER
+//
+// 37800 and 18900 Hz are 6/7 and 3/7 of 44100 Hz, and a sector always
+// gives a whole number of 7 output sample periods. So output sample j of
+// a sector sits at input j*6/7 (j*3/7): one of 7 fixed phases, the same
+// for both rates. Each phase has its own precomputed FIR row (linear: 2
+// taps, polyphase: 8 tap windowed sinc, cut at 0.45 of the input rate).
+// The sector is first split into left/right after the last input samples
+// of the previous one, then converted in one pass straight into the
+// ring, one or two contiguous pieces. Other rates and the pitch option
+// keep the old sample-and-hold stepping.
 ////////////////////////////////////////////////////////////////////////
 
-static int lastxa_lc, lastxa_rc;
-static int lastcd_lc, lastcd_rc;
-
-static INLINE void MixXA(void)
-{
- int ns;
- int lc,rc;
- unsigned long cdda_l;
- int decoded_xa;
- int decoded_cdda;
+#define XA_PHASES   7
+#define XA_TAPS     8                                  // polyphase taps, history = XA_TAPS-1
+#define XA_PI       3.14159265358979323846
 
- decoded_xa = decoded_ptr;
+static short xaCoefLin[XA_PHASES][XA_TAPS];            // Q14, rows sum up to 1<<14
+static short xaCoefPoly[XA_PHASES][XA_TAPS];
+static short xaInL[XA_TAPS-1+16384];                   // history + one sector
+static short xaInR[XA_TAPS-1+16384];
+static int   xaLastFreq=0,xaLastStereo=-1;             // history belongs to this stream
 
- lc = 0;
- rc = 0;
+void InitXA(void)
+{
+ int p,k,sum,big;
+ double x,w,c[XA_TAPS];
 
- for(ns=0;ns<NSSIZE && XAPlay!=XAFeed;ns++)
+ for(p=0;p<XA_PHASES;p++)
   {
-	 XALastVal=*XAPlay++;
-   if(XAPlay==XAEnd) XAPlay=XAStart;
+   // linear: between input i-1 and i
+   memset(xaCoefLin[p],0,sizeof(xaCoefLin[p]));
+   xaCoefLin[p][0]=(short)(((XA_PHASES-p)<<14)/XA_PHASES);
+   xaCoefLin[p][1]=(short)((1<<14)-xaCoefLin[p][0]);
 
-	 lc = (short)(XALastVal&0xffff);
-	 rc = (short)((XALastVal>>16) & 0xffff);
-
-
-	 // improve crackle - buffer under
-	 // - not update fast enough
-	 lastxa_lc = lc;
-	 lastxa_rc = rc;
-
-
-	 // Tales of Phantasia - voice meter
-	 spuMem[ (decoded_xa + 0x000)/2 ] = (short) lc;
-	 spuMem[ (decoded_xa + 0x400)/2 ] = (short) rc;
-
-	 decoded_xa += 2;
-	 if( decoded_xa >= 0x400 )
-		 decoded_xa = 0;
-
- 
-	 lc = CLAMP16( (lc * iLeftXAVol) / 0x8000 );
-	 rc = CLAMP16( (rc * iRightXAVol) / 0x8000 );
-
-
-	 // reverb write flag
-	 if( spuCtrl & CTRL_CD_REVERB ) {
-		StoreREVERB_CD( lc, rc, ns );
-	 }
+   // polyphase: taps i-7...i around i-4+p/7, blackman window
+   for(k=0;k<XA_TAPS;k++)
+    {
+     x=k-3-(double)p/XA_PHASES;
+     w=0.42+0.5*cos(XA_PI*x/4.0)+0.08*cos(2.0*XA_PI*x/4.0);
+     c[k]=(x==0.0)?0.9:sin(XA_PI*0.9*x)/(XA_PI*x);
+     c[k]*=w;
+    }
+   for(k=0,x=0.0;k<XA_TAPS;k++) x+=c[k];
+   for(k=0,sum=0,big=0;k<XA_TAPS;k++)                  // unity gain at dc, rest on the center
+    {
+     xaCoefPoly[p][k]=(short)floor(c[k]*16384.0/x+0.5);
+     sum+=xaCoefPoly[p][k];
+     if(c[k]>c[big]) big=k;
+    }
+   xaCoefPoly[p][big]+=(short)((1<<14)-sum);
+  }
 
+ memset(xaInL,0,sizeof(xaInL));
+ memset(xaInR,0,sizeof(xaInR));
+ xaLastFreq=0;
+ xaLastStereo=-1;
+}
 
-	 // play flag
-	 if( spuCtrl & CTRL_CD_PLAY ) {
-		 SSumL[ns]+=lc;
-		 SSumR[ns]+=rc;
-	 }
- }
+// output samples j...j+n-1 of the sector (den: 6 or 3 input steps per 7
+// outputs), ntaps FIR taps ending at the current input sample
+static void XAResampleBlock(uint32_t * dst,int j,int n,int den,
+                            short (*coef)[XA_TAPS],int ntaps)
+{
+ int i=(j*den)/XA_PHASES,p=(j*den)%XA_PHASES,k,l,r;
+ const short * c;
+ const short * xl;
+ const short * xr;
 
- if(XAPlay==XAFeed && XARepeat)
+ for(;n>0;n--)
   {
-   //XARepeat--;
-   for(;ns<NSSIZE;ns++)
+   c =coef[p];
+   xl=xaInL+XA_TAPS-ntaps+i;                           // input i-ntaps+1
+   xr=xaInR+XA_TAPS-ntaps+i;
+   for(k=0,l=r=1<<13;k<ntaps;k++)
     {
-		 // improve crackle - buffer under
-		 // - not update fast enough
-		 lc = lastxa_lc;
-		 rc = lastxa_rc;
-
-
-		 // Tales of Phantasia - voice meter
-		 spuMem[ (decoded_xa + 0x000)/2 ] = (short) lc;
-		 spuMem[ (decoded_xa + 0x400)/2 ] = (short) rc;
+     l+=c[k]*xl[k];
+     r+=c[k]*xr[k];
+    }
+   l>>=14;r>>=14;
+   *dst++=(uint32_t)(CLAMP16(l)&0xffff)|((uint32_t)CLAMP16(r)<<16);
 
-		 decoded_xa += 2;
-		 if( decoded_xa >= 0x400 )
-			 decoded_xa = 0;
+   p+=den;
+   if(p>=XA_PHASES) {p-=XA_PHASES;i++;}
+  }
+}
 
+// sector at 37800/18900 Hz, returns 0 if it has to take the old path
+static int FeedXABlock(xa_decode_t *xap,int iSize,int iPlace)
+{
+ const int den=(xap->freq==37800)?6:3;
+ short (*coef)[XA_TAPS]=(iXAResample==1)?xaCoefLin:xaCoefPoly;
+ const int ntaps=(iXAResample==1)?2:XA_TAPS;
+ int i,n,n1;
 
-		 lc = CLAMP16( (lc * iLeftXAVol) / 0x8000 );
-		 rc = CLAMP16( (rc * iRightXAVol) / 0x8000 );
+ if(iXAResample<1 || iXAPitch) return 0;
+ if(xap->freq!=37800 && xap->freq!=18900) return 0;
+ if(iSize*xap->freq!=44100*xap->nsamples || iSize%XA_PHASES) return 0;
+ if(xap->nsamples>16384/(xap->stereo?2:1)) return 0;
 
+ if(xap->freq!=xaLastFreq || xap->stereo!=xaLastStereo) // new stream: no history
+  {
+   memset(xaInL,0,(XA_TAPS-1)*sizeof(short));
+   memset(xaInR,0,(XA_TAPS-1)*sizeof(short));
+   xaLastFreq=xap->freq;
+   xaLastStereo=xap->stereo;
+  }
 
-		 // reverb write flags
-		 if( spuCtrl & CTRL_CD_REVERB ) {
-			StoreREVERB_CD( lc, rc, ns );
-		 }
+ if(xap->stereo)                                       // split the sector after the history
+  {
+   for(i=0;i<xap->nsamples;i++)
+    {
+     xaInL[XA_TAPS-1+i]=xap->pcm[2*i];
+     xaInR[XA_TAPS-1+i]=xap->pcm[2*i+1];
+    }
+  }
+ else
+  {
+   memcpy(xaInL+XA_TAPS-1,xap->pcm,xap->nsamples*sizeof(short));
+   memcpy(xaInR+XA_TAPS-1,xap->pcm,xap->nsamples*sizeof(short));
+  }
 
+ n=iSize;                                              // one slot stays free (feed==play: empty)
+ if(n>iPlace-1) n=iPlace-1;
 
-		 // play flag
-		 if( spuCtrl & CTRL_CD_PLAY ) {
-			 SSumL[ns]+=lc;
-			 SSumR[ns]+=rc;
-		 }
-    }
+ if(n>0)
+  {
+   n1=XAEnd-XAFeed;                                    // up to the end of the ring...
+   if(n1>n) n1=n;
+   XAResampleBlock(XAFeed,0,n1,den,coef,ntaps);
+   if(n>n1)                                            // ... and the rest from its start
+    XAResampleBlock(XAStart,n1,n-n1,den,coef,ntaps);
+
+   XAFeed+=n;
+   if(XAFeed>=XAEnd) XAFeed-=XAEnd-XAStart;
   }
 
+ memmove(xaInL,xaInL+xap->nsamples,(XA_TAPS-1)*sizeof(short)); // history for the next sector
+ memmove(xaInR,xaInR+xap->nsamples,(XA_TAPS-1)*sizeof(short));
+ return 1;
+}
 
+////////////////////////////////////////////////////////////////////////
+// MIX XA & CDDA
+////////////////////////////////////////////////////////////////////////
 
- decoded_cdda = decoded_ptr;
+static int lastxa_lc, lastxa_rc;
+static int lastcd_lc, lastcd_rc;
 
- for(ns=0;ns<NSSIZE && CDDAPlay!=CDDAFeed && (CDDAPlay!=CDDAEnd-1||CDDAFeed!=CDDAStart);ns++)
-  {
-   cdda_l=*CDDAPlay++;
-   if(CDDAPlay==CDDAEnd) CDDAPlay=CDDAStart;
+// one cd audio sample into the mix
+static INLINE void MixCDSample(int lc,int rc,int ns,int * pDecoded)
+{
+ // Tales of Phantasia - voice meter, Vib Ribbon - playback
+ spuMem[ (*pDecoded + 0x000)/2 ] = (short) lc;
+ spuMem[ (*pDecoded + 0x400)/2 ] = (short) rc;
 
-	 lc = (short)(cdda_l&0xffff);
-	 rc = (short)((cdda_l>>16) & 0xffff);
+ *pDecoded += 2;
+ if( *pDecoded >= 0x400 )
+	 *pDecoded = 0;
 
 
-	 // improve crackle - buffer under
-	 // - not update fast enough
-	 lastcd_lc = lc;
-	 lastcd_rc = rc;
+ // Rayman - stage end fadeout
+ lc = CLAMP16( (lc * iLeftXAVol) / 0x8000 );
+ rc = CLAMP16( (rc * iRightXAVol) / 0x8000 );
 
 
-	 // Vib Ribbon - playback
-	 spuMem[ (decoded_cdda + 0x000)/2 ] = (short) lc;
-	 spuMem[ (decoded_cdda + 0x400)/2 ] = (short) rc;
+ // reverb write flag
+ if( spuCtrl & CTRL_CD_REVERB ) {
+	StoreREVERB_CD( lc, rc, ns );
+ }
+
 
-	 decoded_cdda += 2;
-	 if( decoded_cdda >= 0x400 )
-		 decoded_cdda = 0;
+ // play flag
+ if( spuCtrl & CTRL_CD_PLAY ) {
+	 SSumL[ns]+=lc;
+	 SSumR[ns]+=rc;
+ }
+}
 
+// the rings are read in contiguous runs (up to the feed position or the
+// end of the buffer), no wrap check per sample
+static INLINE void MixXA(void)
+{
+ int ns,i,n;
+ uint32_t * feed;
+ int decoded_xa;
+ int decoded_cdda;
 
-	 // Rayman - stage end fadeout
-	 lc = CLAMP16( (lc * iLeftXAVol) / 0x8000 );
-	 rc = CLAMP16( (rc * iRightXAVol) / 0x8000 );
+ decoded_xa = decoded_ptr;
 
+ feed=XAFeed;                                          // (moved on by the cdrom side)
+ for(ns=0;ns<NSSIZE && XAPlay!=feed;)
+  {
+   n=((feed>XAPlay)?feed:XAEnd)-XAPlay;
+   if(n>NSSIZE-ns) n=NSSIZE-ns;
 
-	 // reverb write flag
-	 if( spuCtrl & CTRL_CD_REVERB ) {
-		StoreREVERB_CD( lc, rc, ns );
-	 }
+   for(i=0;i<n;i++,ns++)
+    {
+     XALastVal=XAPlay[i];
 
+     // improve crackle - buffer under
+     // - not update fast enough
+     lastxa_lc = (short)(XALastVal&0xffff);
+     lastxa_rc = (short)((XALastVal>>16) & 0xffff);
 
-	 // play flag
-	 if( spuCtrl & CTRL_CD_PLAY ) {
-		 SSumL[ns]+=lc;
-		 SSumR[ns]+=rc;
-	 }
-	}
+     MixCDSample(lastxa_lc,lastxa_rc,ns,&decoded_xa);
+    }
 
+   XAPlay+=n;
+   if(XAPlay==XAEnd) XAPlay=XAStart;
+  }
 
- if(CDDAPlay==CDDAFeed && XARepeat)
+ if(XAPlay==feed && XARepeat)
   {
    //XARepeat--;
    for(;ns<NSSIZE;ns++)
-    {
-		 // improve crackle - buffer under
-		 // - not update fast enough
-		 lc = lastcd_lc;
-		 rc = lastcd_rc;
+    MixCDSample(lastxa_lc,lastxa_rc,ns,&decoded_xa);
+  }
 
 
-		 // Vib Ribbon - playback
-		 spuMem[ (decoded_cdda + 0x000)/2 ] = (short) lc;
-		 spuMem[ (decoded_cdda + 0x400)/2 ] = (short) rc;
 
-		 decoded_cdda += 2;
-		 if( decoded_cdda >= 0x400 )
-			 decoded_cdda = 0;
+ decoded_cdda = decoded_ptr;
 
+ // the cdda feed wraps late (can sit on CDDAEnd), and the last slot is
+ // not played while the feed is back at the start
+ feed=CDDAFeed;
+ for(ns=0;ns<NSSIZE && CDDAPlay!=feed;)
+  {
+   if(feed>CDDAPlay) n=feed-CDDAPlay;
+   else              n=(CDDAEnd-CDDAPlay)-(feed==CDDAStart);
+   if(n<=0) break;
+   if(n>NSSIZE-ns) n=NSSIZE-ns;
 
-		 // Rayman - stage end fadeout
-		 lc = CLAMP16( (lc * iLeftXAVol) / 0x8000 );
-		 rc = CLAMP16( (rc * iRightXAVol) / 0x8000 );
+   for(i=0;i<n;i++,ns++)
+    {
+     // improve crackle - buffer under
+     // - not update fast enough
+     lastcd_lc = (short)(CDDAPlay[i]&0xffff);
+     lastcd_rc = (short)((CDDAPlay[i]>>16) & 0xffff);
 
+     MixCDSample(lastcd_lc,lastcd_rc,ns,&decoded_cdda);
+    }
 
-		 // reverb write flag
-		 if( spuCtrl & CTRL_CD_REVERB ) {
-			StoreREVERB_CD( lc, rc, ns );
-		 }
+   CDDAPlay+=n;
+   if(CDDAPlay==CDDAEnd) CDDAPlay=CDDAStart;
+  }
 
 
-		 // play flag
-		 if( spuCtrl & CTRL_CD_PLAY ) {
-			 SSumL[ns]+=lc;
-			 SSumR[ns]+=rc;
-		 }
-	 }
+ if(CDDAPlay==feed && XARepeat)
+  {
+   //XARepeat--;
+   for(;ns<NSSIZE;ns++)
+    MixCDSample(lastcd_lc,lastcd_rc,ns,&decoded_cdda);
   }
 }
 
@@ -250,13 +323,14 @@ static INLINE void MixXA(void)
 
 unsigned long timeGetTime_spu()
 {
-	/*
+#ifndef _XBOX
  struct timeval tv;
  gettimeofday(&tv, 0);                                 // well, maybe there are better ways
  return tv.tv_sec * 1000 + tv.tv_usec/1000;            // to do that, but at least it works
- */
+#else
 //	return __mftb()/500;//(500 cpu tick speed)
 	return __mftb32()/500;//(500 cpu tick speed)
+#endif
 }
 
 #endif
@@ -286,6 +360,8 @@ static INLINE void FeedXA(xa_decode_t *xap)
 
  if(iPlace==0) return;                                 // no place at all
 
+ if(FeedXABlock(xap,iSize,iPlace)) return;             // 37800/18900 Hz: block resampler
+
  //----------------------------------------------------//
  if(iXAPitch)                                          // pitch change option?
   {
@@ -458,24 +534,37 @@ unsigned int cdda_ptr;
 
 static INLINE void FeedCDDA(unsigned char *pcm, int nBytes)
 {
+ uint32_t * play;
+ int i,n;
+
  while(nBytes>0)
   {
    if(CDDAFeed==CDDAEnd) CDDAFeed=CDDAStart;
-   while(CDDAFeed==CDDAPlay-1||
-         (CDDAFeed==CDDAEnd-1&&CDDAPlay==CDDAStart))
-   {
+
+   // free run up to the end of the ring or one before the play position
+   play=CDDAPlay;                                      // (moved on by the mixer thread)
+   if(CDDAFeed<play) n=(play-1)-CDDAFeed;
+   else              n=(CDDAEnd-CDDAFeed)-(play==CDDAStart);
+
+   if(n<=0)                                            // full
+    {
 #if defined(_WINDOWS) || defined(_XBOX)
-    if (!iUseTimer) Sleep(1);
-    else return;
+     if (!iUseTimer) {Sleep(1);continue;}
+     else return;
 #else
-    if (!iUseTimer) usleep(1000);
-    else return;
+     if (!iUseTimer) {usleep(1000);continue;}
+     else return;
 #endif
-   }
-   *CDDAFeed++=(*pcm | (*(pcm+1)<<8) | (*(pcm+2)<<16) | (*(pcm+3)<<24));
-   nBytes-=4;
-   pcm+=4;
- }
+    }
+
+   if(n>(nBytes+3)/4) n=(nBytes+3)/4;
+
+   for(i=0;i<n;i++,pcm+=4)                             // le 16 bit stereo
+    CDDAFeed[i]=(*pcm | (*(pcm+1)<<8) | (*(pcm+2)<<16) | (*(pcm+3)<<24));
+
+   CDDAFeed+=n;
+   nBytes-=n*4;
+  }
 }
 
 #endif
@@ -15,6 +15,7 @@
  *                                                                         *
  ***************************************************************************/
 
+void InitXA(void);
 static INLINE void MixXA(void);
 static INLINE void FeedXA(xa_decode_t *xap);
 static INLINE void FeedCDDA(unsigned char *pcm, int nBytes);
@@ -5,15 +5,46 @@
 #define _IN_OSS
 #include "externals.h"
 
-#define BUFFER_SIZE		22050
-
-static short			*pSndBuffer = NULL;
-static int				iBufSize = 0;
-static volatile int	iReadPos = 0, iWritePos = 0;
-
-static unsigned int write_buffer = 0;
-
-static unsigned char xaudio_buffer[ SOUNDSIZE ];
+// Anel SPSC (um produtor: thread do SPU, um consumidor: callback do
+// XAudio2). Indices em frames estereo, correm livres e cada um fica na sua
+// linha de cache (128 bytes); os dados sao publicados com lwsync antes do
+// indice, entao nao ha trava nem volatile compartilhado no mesmo bloco.
+#define RING_FRAMES		8192			// 186 ms, potencia de 2
+#define RING_MASK		(RING_FRAMES - 1)
+
+// O XAudio2 processa em passos de 10 ms: um pedaco por passo, dois na fila
+#define CHUNK_FRAMES	441
+#define CHUNK_COUNT		3
+#define CHUNK_QUEUED	2
+
+// O SPU entrega ~LATENCY ms por vez; o anel fica em volta de duas entregas
+// (alvo) e o mixer para ao passar de tres
+#define FILL_TARGET		(44 * LATENCY * 2)
+#define FILL_HIGH		(44 * LATENCY * 3)
+
+static __declspec(align(128)) unsigned long	sndRing[RING_FRAMES];
+static volatile __declspec(align(128)) unsigned int	iWritePos = 0;	// so o produtor escreve
+static volatile __declspec(align(128)) unsigned int	iReadPos = 0;	// so o consumidor escreve
+
+// estatisticas (escritas pelo consumidor, lidas pelo profiler)
+static volatile unsigned int	iFillAvg = 0;		// media do nivel, frames * 16
+static volatile unsigned long	ulUnderruns = 0;	// vezes que o anel secou tocando
+static volatile unsigned long	ulDropped = 0;		// frames perdidos com o anel cheio
+
+// Reamostragem dinamica: a voz toca ate +-0.5% mais rapido/lento para
+// manter o anel perto do alvo (inaudivel). O relogio do limitador de
+// frames (SoundGetClock) tira esse ajuste, senao os dois se reforcam:
+// anel cheio -> voz mais rapida -> jogo mais rapido -> anel mais cheio
+#define RESAMPLE_MAX	0.005f
+#define RESAMPLE_STEP	0.0005f
+
+static float fFreqRatio = 1.0f;
+static UINT64 ulLastPlayed = 0;		// SamplesPlayed na ultima leitura do relogio
+static double dClock = 0.0;			// amostras em tempo nominal
+
+static __declspec(align(128)) unsigned long xaudio_buffer[CHUNK_COUNT][CHUNK_FRAMES];
+static int iChunk = 0;
+static int bPlaying = 0;	// ultimo pedaco saiu inteiro do anel
 
 static IXAudio2 *lpXAudio2 = NULL;
 static IXAudio2MasteringVoice *lpMasterVoice = NULL;
@@ -127,82 +158,146 @@ extern "C" void SetupSound(void)
 	memset( xaudio_buffer, 0, sizeof(xaudio_buffer) );	
 
 	lpSourceVoice->FlushSourceBuffers();
-	lpSourceVoice->Start( 0, 0 );
-
-	iBufSize = BUFFER_SIZE;
-	//if (iDisStereo) iBufSize /= 2;
 
-	if (pSndBuffer == NULL) {
-		pSndBuffer = (short *)malloc(iBufSize * sizeof(short));
+	fFreqRatio = 1.0f;
+	ulLastPlayed = 0;
+	dClock = 0.0;
+
+	iReadPos = iWritePos = 0;
+	iFillAvg = 0;
+	ulUnderruns = ulDropped = 0;
+	iChunk = 0;
+	bPlaying = 0;
+
+	// pedacos de silencio para comecar; cada OnBufferEnd repoe um
+	for (int i = 0; i < CHUNK_QUEUED; i++) {
+		XAUDIO2_BUFFER buf = {0};
+		buf.AudioBytes = CHUNK_FRAMES * output_samplesize;
+		buf.pAudioData = (BYTE *)xaudio_buffer[iChunk];
+		lpSourceVoice->SubmitSourceBuffer( &buf );
+		iChunk = (iChunk + 1) % CHUNK_COUNT;
 	}
 
-	// submit fake buffer for starting
-	XAUDIO2_BUFFER buf = {0};
-	buf.AudioBytes = 2048;
-	buf.pAudioData = xaudio_buffer;
-
-	lpSourceVoice->SubmitSourceBuffer( &buf );
+	lpSourceVoice->Start( 0, 0 );
 }
 
+// Consumidor (thread do XAudio2): um pedaco do anel, silencio no que faltar
 static void SOUND_FillAudio() {
-	int len = SOUNDSIZE;
-	int byte_size = len = byte_per_sample*2;
-	short *p = (short *)xaudio_buffer;
-
+	unsigned long *p = xaudio_buffer[iChunk];
+	unsigned int r = iReadPos;
+	unsigned int avail = iWritePos - r;
+	unsigned int n, i;
 	XAUDIO2_BUFFER buf = {0};
 
-	len /= sizeof(short);
+	if (lpSourceVoice == NULL) return;
 
-	while (iReadPos != iWritePos && len > 0) {
-		*p++ = pSndBuffer[iReadPos++];
-		if (iReadPos >= iBufSize) iReadPos = 0;
-		--len;
-	}
+	__lwsync();		// indice lido antes dos dados
+
+	iFillAvg += avail - (iFillAvg >> 4);
 
-	// Fill remaining space with zero
-	while (len > 0) {
-		*p++ = 0;
-		--len;
+	n = avail < CHUNK_FRAMES ? avail : CHUNK_FRAMES;
+	for (i = 0; i < n; i++)
+		p[i] = sndRing[(r + i) & RING_MASK];
+
+	if (n < CHUNK_FRAMES) {
+		memset(p + n, 0, (CHUNK_FRAMES - n) * sizeof(unsigned long));
+		if (bPlaying) ulUnderruns++;		// conta a queda, nao cada pedaco de silencio (pausa, menu)
+		bPlaying = 0;
 	}
+	else bPlaying = 1;
 
-	// submit to xaudio
-	buf.AudioBytes = byte_size;
-	buf.pAudioData = xaudio_buffer;
+	__lwsync();		// dados lidos antes de liberar o espaco
+	iReadPos = r + n;
 
+	buf.AudioBytes = CHUNK_FRAMES * output_samplesize;
+	buf.pAudioData = (BYTE *)p;
 	lpSourceVoice->SubmitSourceBuffer( &buf );
+
+	iChunk = (iChunk + 1) % CHUNK_COUNT;
 }
 
+// Acima do limite o mixer do SPU espera (ou pula o bloco no modo SPUasync)
 extern "C"  unsigned long SoundGetBytesBuffered(void) {
-	int size;
+	if (lpSourceVoice == NULL) return SOUNDSIZE;
 
-	if (pSndBuffer == NULL) return SOUNDSIZE;
+	if (iWritePos - iReadPos >= FILL_HIGH) return SOUNDSIZE;
 
-	size = iReadPos - iWritePos;
-	if (size <= 0) size += iBufSize;
+	return 0;
+}
 
-	if (size < iBufSize / 2) return SOUNDSIZE;
+// Amostras ja tocadas pela voz em tempo nominal (SamplesPlayed / fFreqRatio):
+// relogio mestre do FrameCap (gpu fps.c). So a reamostragem corrige o
+// nivel do anel, o jogo segue a taxa nominal do audio
+extern "C" int SoundGetClock(unsigned long *pulSamples) {
+	XAUDIO2_VOICE_STATE state;
 
-	return 0;
+	if (lpSourceVoice == NULL) return 0;
+
+	lpSourceVoice->GetState(&state);
+
+	if (state.SamplesPlayed < ulLastPlayed)		// voz reiniciada
+		ulLastPlayed = state.SamplesPlayed;
+
+	dClock += (double)(state.SamplesPlayed - ulLastPlayed) / fFreqRatio;
+	ulLastPlayed = state.SamplesPlayed;
+	if (dClock >= 4294967296.0) dClock -= 4294967296.0;	// o FrameCap usa so a diferenca
+
+	*pulSamples = (unsigned long)dClock;
+
+	return 1;
 }
 
-extern "C" void SoundFeedStreamData(unsigned char *pSound, long lBytes) {
-	short *p = (short *)pSound;
+// Nivel do anel para o profiler: media em frames, quedas e frames perdidos
+extern "C" int SoundGetStats(unsigned long *pulFill, unsigned long *pulUnderruns, unsigned long *pulDropped) {
+	if (lpSourceVoice == NULL) return 0;
 
-	if (pSndBuffer == NULL) return;
+	*pulFill = iFillAvg >> 4;
+	*pulUnderruns = ulUnderruns;
+	*pulDropped = ulDropped;
 
-	if (1) {
-		// audio sync
-		//WaitForSingleObject(voiceContext.hBufferEndEvent, INFINITE);
-	}
+	return 1;
+}
+
+// Controle proporcional sobre a media do nivel (vista pelo consumidor,
+// sem o pico de cada entrega do SPU)
+static void SOUND_AdjustRatio() {
+	int fill;
+	float ratio;
+
+	if (lpSourceVoice == NULL) return;
 
-	while (lBytes > 0) {
-		if (((iWritePos + 1) % iBufSize) == iReadPos) break;
+	fill = (int)(iFillAvg >> 4);
 
-		pSndBuffer[iWritePos] = *p++;
+	ratio = 1.0f + RESAMPLE_MAX * (float)(fill - FILL_TARGET) / (float)FILL_TARGET;
+	if (ratio > 1.0f + RESAMPLE_MAX) ratio = 1.0f + RESAMPLE_MAX;
+	if (ratio < 1.0f - RESAMPLE_MAX) ratio = 1.0f - RESAMPLE_MAX;
 
-		++iWritePos;
-		if (iWritePos >= iBufSize) iWritePos = 0;
+	if (ratio - fFreqRatio < RESAMPLE_STEP && fFreqRatio - ratio < RESAMPLE_STEP) return;
 
-		lBytes -= sizeof(short);
+	fFreqRatio = ratio;
+	lpSourceVoice->SetFrequencyRatio(ratio);
+}
+
+// Produtor (thread do SPU)
+extern "C" void SoundFeedStreamData(unsigned char *pSound, long lBytes) {
+	const unsigned long *p = (const unsigned long *)pSound;
+	unsigned int w = iWritePos;
+	unsigned int n = (unsigned int)lBytes / output_samplesize;
+	unsigned int room = RING_FRAMES - (w - iReadPos);
+	unsigned int i;
+
+	if (lpSourceVoice == NULL) return;
+
+	if (n > room) {
+		ulDropped += n - room;
+		n = room;
 	}
+
+	for (i = 0; i < n; i++)
+		sndRing[(w + i) & RING_MASK] = p[i];
+
+	__lwsync();		// dados visiveis antes do indice
+	iWritePos = w + n;
+
+	SOUND_AdjustRatio();
 }
@@ -0,0 +1,305 @@
+/***************************************************************************
+                          blit.c  -  description
+                             -------------------
+ VRAM -> 32 bit framebuffer line converters used by BlitScreen32
+
+ Each line kernel exists in one SIMD flavour picked at compile time
+ (VMX128 on the 360, SSE2/SSSE3 or NEON on host builds) plus a scalar
+ reference. The VRAM byte swap is folded into the permute/shuffle, so
+ the 24 bit (MDEC) path does a single permute per 4 pixels.
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "blit.h"
+
+#if defined(_XBOX)
+#include <xtl.h>
+#define BLIT_VMX128
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#define BLIT_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__BIG_ENDIAN__) && !defined(__ARMEB__)
+#include <arm_neon.h>
+#define BLIT_NEON
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// scalar reference
+////////////////////////////////////////////////////////////////////////
+
+// xBBBBBGGGGGRRRRR (little endian in VRAM) -> 0xffRRGGBB, no low bit fill
+#define BLIT_15TO32(s) \
+ (0xff000000 | (((s) << 19) & 0xf80000) | (((s) << 6) & 0xf800) | (((s) >> 7) & 0xf8))
+
+void BlitLine15To32_C(uint32_t * dst, const unsigned short * src, int count)
+{
+ const unsigned char * p = (const unsigned char *)src;
+ uint32_t s;
+ int i;
+
+ for(i = 0; i < count; i++, p += 2)
+  {
+   s = p[0] | (p[1] << 8);
+   dst[i] = BLIT_15TO32(s);
+  }
+}
+
+void BlitLine24To32_C(uint32_t * dst, const unsigned char * src, int count)
+{
+ int i;
+
+ for(i = 0; i < count; i++, src += 3)
+  dst[i] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+}
+
+////////////////////////////////////////////////////////////////////////
+// VMX128 (xbox 360, big endian)
+////////////////////////////////////////////////////////////////////////
+
+#if defined(BLIT_VMX128)
+
+// halfword -> word zero extension with the LE->BE swap (0x10 = zero vector)
+static const __declspec(align(16)) unsigned char perm15lo[16] =
+ {0x10,0x10,0x01,0x00, 0x10,0x10,0x03,0x02, 0x10,0x10,0x05,0x04, 0x10,0x10,0x07,0x06};
+static const __declspec(align(16)) unsigned char perm15hi[16] =
+ {0x10,0x10,0x09,0x08, 0x10,0x10,0x0b,0x0a, 0x10,0x10,0x0d,0x0c, 0x10,0x10,0x0f,0x0e};
+
+// packed RGB -> xRGB, the x byte is forced to 0xff afterwards
+static const __declspec(align(16)) unsigned char perm24a[16] =
+ {0x00,0x00,0x01,0x02, 0x00,0x03,0x04,0x05, 0x00,0x06,0x07,0x08, 0x00,0x09,0x0a,0x0b};
+static const __declspec(align(16)) unsigned char perm24b[16] =
+ {0x00,0x0c,0x0d,0x0e, 0x00,0x0f,0x10,0x11, 0x00,0x12,0x13,0x14, 0x00,0x15,0x16,0x17};
+static const __declspec(align(16)) unsigned char perm24c[16] =
+ {0x00,0x08,0x09,0x0a, 0x00,0x0b,0x0c,0x0d, 0x00,0x0e,0x0f,0x10, 0x00,0x11,0x12,0x13};
+static const __declspec(align(16)) unsigned char perm24d[16] =
+ {0x00,0x04,0x05,0x06, 0x00,0x07,0x08,0x09, 0x00,0x0a,0x0b,0x0c, 0x00,0x0d,0x0e,0x0f};
+
+static const __declspec(align(16)) uint32_t vAlpha[4] = {0xff000000,0xff000000,0xff000000,0xff000000};
+static const __declspec(align(16)) uint32_t vMaskR[4] = {0x00f80000,0x00f80000,0x00f80000,0x00f80000};
+static const __declspec(align(16)) uint32_t vMaskG[4] = {0x0000f800,0x0000f800,0x0000f800,0x0000f800};
+static const __declspec(align(16)) uint32_t vMaskB[4] = {0x000000f8,0x000000f8,0x000000f8,0x000000f8};
+static const __declspec(align(16)) uint32_t vShR[4]   = {19,19,19,19};
+static const __declspec(align(16)) uint32_t vShG[4]   = {6,6,6,6};
+static const __declspec(align(16)) uint32_t vShB[4]   = {7,7,7,7};
+
+// unaligned load/store (lvlx/lvrx, stvlx/stvrx pairs)
+#define VLOADU(p)     __vor(__lvlx((void *)(p), 0), __lvrx((void *)(p), 16))
+#define VSTOREU(v, p) { __stvlx((v), (void *)(p), 0); __stvrx((v), (void *)(p), 16); }
+
+__inline static __vector4 Conv15(__vector4 s, __vector4 a, __vector4 mr, __vector4 mg, __vector4 mb,
+                                 __vector4 shr, __vector4 shg, __vector4 shb)
+{
+ __vector4 r = __vand(__vslw(s, shr), mr);
+ __vector4 g = __vand(__vslw(s, shg), mg);
+ __vector4 b = __vand(__vsrw(s, shb), mb);
+ return __vor(__vor(r, g), __vor(b, a));
+}
+
+void BlitLine15To32(uint32_t * dst, const unsigned short * src, int count)
+{
+ __vector4 zero = __vspltisw(0);
+ __vector4 plo  = __lvx(perm15lo, 0);
+ __vector4 phi  = __lvx(perm15hi, 0);
+ __vector4 a    = __lvx(vAlpha, 0);
+ __vector4 mr   = __lvx(vMaskR, 0);
+ __vector4 mg   = __lvx(vMaskG, 0);
+ __vector4 mb   = __lvx(vMaskB, 0);
+ __vector4 shr  = __lvx(vShR, 0);
+ __vector4 shg  = __lvx(vShG, 0);
+ __vector4 shb  = __lvx(vShB, 0);
+ __vector4 v;
+ int i = 0;
+
+ for(; i + 8 <= count; i += 8, src += 8, dst += 8)
+  {
+   __dcbt(256, (void *)src);
+   v = VLOADU(src);
+   VSTOREU(Conv15(__vperm(v, zero, plo), a, mr, mg, mb, shr, shg, shb), dst);
+   VSTOREU(Conv15(__vperm(v, zero, phi), a, mr, mg, mb, shr, shg, shb), dst + 4);
+  }
+
+ if(i < count) BlitLine15To32_C(dst, src, count - i);
+}
+
+void BlitLine24To32(uint32_t * dst, const unsigned char * src, int count)
+{
+ __vector4 pa = __lvx(perm24a, 0);
+ __vector4 pb = __lvx(perm24b, 0);
+ __vector4 pc = __lvx(perm24c, 0);
+ __vector4 pd = __lvx(perm24d, 0);
+ __vector4 a  = __lvx(vAlpha, 0);
+ __vector4 v0, v1, v2;
+ int i = 0;
+
+ // 16 pixels = 48 source bytes = 3 vectors -> 4 permutes
+ for(; i + 16 <= count; i += 16, src += 48, dst += 16)
+  {
+   __dcbt(256, (void *)src);
+   v0 = VLOADU(src);
+   v1 = VLOADU(src + 16);
+   v2 = VLOADU(src + 32);
+   VSTOREU(__vor(__vperm(v0, v0, pa), a), dst);
+   VSTOREU(__vor(__vperm(v0, v1, pb), a), dst + 4);
+   VSTOREU(__vor(__vperm(v1, v2, pc), a), dst + 8);
+   VSTOREU(__vor(__vperm(v2, v2, pd), a), dst + 12);
+  }
+
+ if(i < count) BlitLine24To32_C(dst, src, count - i);
+}
+
+const char * BlitKernelName(void) { return "vmx128"; }
+
+////////////////////////////////////////////////////////////////////////
+// SSE2 / SSSE3 (little endian hosts)
+////////////////////////////////////////////////////////////////////////
+
+#elif defined(BLIT_SSE2)
+
+void BlitLine15To32(uint32_t * dst, const unsigned short * src, int count)
+{
+ const __m128i zero = _mm_setzero_si128();
+ const __m128i a  = _mm_set1_epi32((int)0xff000000);
+ const __m128i mr = _mm_set1_epi32(0x00f80000);
+ const __m128i mg = _mm_set1_epi32(0x0000f800);
+ const __m128i mb = _mm_set1_epi32(0x000000f8);
+ __m128i v, s, d;
+ int i = 0;
+
+ for(; i + 8 <= count; i += 8, src += 8, dst += 8)
+  {
+   v = _mm_loadu_si128((const __m128i *)src);
+
+   s = _mm_unpacklo_epi16(v, zero);
+   d = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(s, 19), mr),
+                                 _mm_and_si128(_mm_slli_epi32(s, 6), mg)),
+                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(s, 7), mb), a));
+   _mm_storeu_si128((__m128i *)dst, d);
+
+   s = _mm_unpackhi_epi16(v, zero);
+   d = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(s, 19), mr),
+                                 _mm_and_si128(_mm_slli_epi32(s, 6), mg)),
+                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(s, 7), mb), a));
+   _mm_storeu_si128((__m128i *)(dst + 4), d);
+  }
+
+ if(i < count) BlitLine15To32_C(dst, src, count - i);
+}
+
+void BlitLine24To32(uint32_t * dst, const unsigned char * src, int count)
+{
+ int i = 0;
+#ifdef __SSSE3__
+ const __m128i a   = _mm_set1_epi32((int)0xff000000);
+ const __m128i shf = _mm_setr_epi8(2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1);
+
+ // each 16 byte load covers 4 pixels (+4 spare bytes), so keep 2 pixels
+ // of slack at the end of the line to never read past the source
+ for(; i + 18 <= count; i += 16, src += 48, dst += 16)
+  {
+   _mm_storeu_si128((__m128i *)dst,
+    _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), shf), a));
+   _mm_storeu_si128((__m128i *)(dst + 4),
+    _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 12)), shf), a));
+   _mm_storeu_si128((__m128i *)(dst + 8),
+    _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 24)), shf), a));
+   _mm_storeu_si128((__m128i *)(dst + 12),
+    _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 36)), shf), a));
+  }
+#endif
+
+ if(i < count) BlitLine24To32_C(dst, src, count - i);
+}
+
+#ifdef __SSSE3__
+const char * BlitKernelName(void) { return "ssse3"; }
+#else
+const char * BlitKernelName(void) { return "sse2"; }
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// NEON (little endian hosts)
+////////////////////////////////////////////////////////////////////////
+
+#elif defined(BLIT_NEON)
+
+void BlitLine15To32(uint32_t * dst, const unsigned short * src, int count)
+{
+ const uint32x4_t a  = vdupq_n_u32(0xff000000);
+ const uint32x4_t mr = vdupq_n_u32(0x00f80000);
+ const uint32x4_t mg = vdupq_n_u32(0x0000f800);
+ const uint32x4_t mb = vdupq_n_u32(0x000000f8);
+ uint16x8_t v;
+ uint32x4_t s;
+ int i = 0;
+
+ for(; i + 8 <= count; i += 8, src += 8, dst += 8)
+  {
+   v = vld1q_u16(src);
+
+   s = vmovl_u16(vget_low_u16(v));
+   vst1q_u32(dst, vorrq_u32(vorrq_u32(vandq_u32(vshlq_n_u32(s, 19), mr),
+                                      vandq_u32(vshlq_n_u32(s, 6), mg)),
+                            vorrq_u32(vandq_u32(vshrq_n_u32(s, 7), mb), a)));
+
+   s = vmovl_u16(vget_high_u16(v));
+   vst1q_u32(dst + 4, vorrq_u32(vorrq_u32(vandq_u32(vshlq_n_u32(s, 19), mr),
+                                          vandq_u32(vshlq_n_u32(s, 6), mg)),
+                                vorrq_u32(vandq_u32(vshrq_n_u32(s, 7), mb), a)));
+  }
+
+ if(i < count) BlitLine15To32_C(dst, src, count - i);
+}
+
+void BlitLine24To32(uint32_t * dst, const unsigned char * src, int count)
+{
+ uint8x8x3_t rgb;
+ uint8x8x4_t bgra;
+ int i = 0;
+
+ bgra.val[3] = vdup_n_u8(0xff);
+
+ // de-interleaving load/interleaving store do the whole swizzle
+ for(; i + 8 <= count; i += 8, src += 24, dst += 8)
+  {
+   rgb = vld3_u8(src);
+   bgra.val[0] = rgb.val[2];
+   bgra.val[1] = rgb.val[1];
+   bgra.val[2] = rgb.val[0];
+   vst4_u8((uint8_t *)dst, bgra);
+  }
+
+ if(i < count) BlitLine24To32_C(dst, src, count - i);
+}
+
+const char * BlitKernelName(void) { return "neon"; }
+
+////////////////////////////////////////////////////////////////////////
+// no SIMD available
+////////////////////////////////////////////////////////////////////////
+
+#else
+
+void BlitLine15To32(uint32_t * dst, const unsigned short * src, int count)
+{
+ BlitLine15To32_C(dst, src, count);
+}
+
+void BlitLine24To32(uint32_t * dst, const unsigned char * src, int count)
+{
+ BlitLine24To32_C(dst, src, count);
+}
+
+const char * BlitKernelName(void) { return "scalar"; }
+
+#endif
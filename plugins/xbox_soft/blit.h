@@ -0,0 +1,45 @@
+/***************************************************************************
+                          blit.h  -  description
+                             -------------------
+ VRAM -> 32 bit framebuffer line converters used by BlitScreen32
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef _GPU_BLIT_H_
+#define _GPU_BLIT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output pixels are host uint32_t values 0xffRRGGBB (A8R8G8B8), the same
+// layout BlitScreen32 always produced. Source VRAM is little endian on
+// every host, byte swapping is done inside the kernels.
+
+// 15 bit: 'count' psx pixels from 'src' (VRAM halfwords)
+void BlitLine15To32(uint32_t * dst, const unsigned short * src, int count);
+// 24 bit: 'count' psx pixels from 'src' (packed R,G,B bytes, MDEC FMV mode)
+void BlitLine24To32(uint32_t * dst, const unsigned char * src, int count);
+
+// scalar reference versions, always compiled (verification / fallback)
+void BlitLine15To32_C(uint32_t * dst, const unsigned short * src, int count);
+void BlitLine24To32_C(uint32_t * dst, const unsigned char * src, int count);
+
+// name of the kernel set selected at compile time ("vmx128", "sse2", ...)
+const char * BlitKernelName(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _GPU_BLIT_H_
@@ -24,6 +24,7 @@ email                : BlackDove@addcom.de
 #include "menu.h"
 #include "interp.h"
 #include "swap.h"
+#include "blit.h"
 #include <xtl.h>
 #include "xb_video.h"
 #include "../../libpcsxcore/psxcommon.h"
@@ -105,20 +106,12 @@ __inline void TexZero(void * buf, int len) {
 static void BlitScreen32(unsigned char * surf, int32_t x, int32_t y)
 {
 	uint32_t * destpix;
-	uint32_t * __restrict rdest;
-
-	unsigned char *pD;
 	unsigned int startxy;
-	uint32_t lu;
-	
-	unsigned short s, s1, s2, s3, s4, s5, s6, s7;
-	uint32_t d, d1, d2, d3, d4, d5, d6, d7;
-	unsigned short row, column;
+	unsigned short column;
 	unsigned short dx = PreviousPSXDisplay.Range.x1;
 	unsigned short dy = PreviousPSXDisplay.DisplayMode.y;
 
 	int loop = 0;
-	int offset = 0;
 	int32_t lPitch = g_pPitch;
 
 	for(loop=0; loop < 1024; loop += 128)
@@ -145,27 +138,15 @@ static void BlitScreen32(unsigned char * surf, int32_t x, int32_t y)
 		surf += PreviousPSXDisplay.Range.x0 << 2;
 	}
 
+	// line kernels (blit.c) do the byte swap + expansion in SIMD
 	if (PSXDisplay.RGB24)
 	{
 		for (column = 0; column < dy; column++)
 		{
 			startxy = ((1024) * (column + y)) + x;
-			pD = (unsigned char *)&psxVuw[startxy];
 			destpix = (uint32_t *)(surf + (column * lPitch));
-			
-			for (row = 0; row < dx; row++)
-			{
-				rdest = &destpix[row];
-				
-				lu = *((uint32_t *)pD);
-
-				d = 0xff000000 | (RED(lu) << 16) | (GREEN(lu) << 8) | (BLUE(lu));
-				
-				// destpix[row] = d;
-				rdest[0] = d;
-
-				pD += 3;
-			}
+
+			BlitLine24To32(destpix, (unsigned char *)&psxVuw[startxy], dx);
 		}
 	}
 	else
@@ -173,41 +154,9 @@ static void BlitScreen32(unsigned char * surf, int32_t x, int32_t y)
 		for (column = 0;column<dy;column++)
 		{
 			startxy = (1024 * (column + y)) + x;
-			destpix = (uint32_t *)(surf + (column * lPitch));			
-
-			for (row = 0; row < dx; row+=8)
-			{					
-				rdest = &destpix[row];
-
-				s =    __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s1 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s2 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s3 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s4 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s5 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s6 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-				s7 =   __loadshortbytereverse(0,&psxVuw[startxy++]);
-
-			
-				d =  (((s << 19) & 0xf80000) | ((s << 6) & 0xf800) | ((s >> 7) & 0xf8)) | 0xff000000;
-				d1 = (((s1 << 19) & 0xf80000) | ((s1 << 6) & 0xf800) | ((s1 >> 7) & 0xf8)) | 0xff000000;
-				d2 = (((s2 << 19) & 0xf80000) | ((s2 << 6) & 0xf800) | ((s2 >> 7) & 0xf8)) | 0xff000000;
-				d3 = (((s3 << 19) & 0xf80000) | ((s3 << 6) & 0xf800) | ((s3 >> 7) & 0xf8)) | 0xff000000;
-				d4 = (((s4 << 19) & 0xf80000) | ((s4 << 6) & 0xf800) | ((s4 >> 7) & 0xf8)) | 0xff000000;
-				d5 = (((s5 << 19) & 0xf80000) | ((s5 << 6) & 0xf800) | ((s5 >> 7) & 0xf8)) | 0xff000000;
-				d6 = (((s6 << 19) & 0xf80000) | ((s6 << 6) & 0xf800) | ((s6 >> 7) & 0xf8)) | 0xff000000;
-				d7 = (((s7 << 19) & 0xf80000) | ((s7 << 6) & 0xf800) | ((s7 >> 7) & 0xf8)) | 0xff000000; 
-
-				rdest[0] = d;
-				rdest[1] = d1;
-				rdest[2] = d2;
-				rdest[3] = d3;
-				rdest[4] = d4;
-				rdest[5] = d5;
-				rdest[6] = d6;
-				rdest[7] = d7;
-
-			}
+			destpix = (uint32_t *)(surf + (column * lPitch));
+
+			BlitLine15To32(destpix, &psxVuw[startxy], dx);
 		}
 	}
 }
@@ -90,6 +90,7 @@
 //X11 render
 #ifndef _XBOX
 #define __inline inline
+#define __dcbt(offset,base)                            // no cache hints off the 360
 #endif
 #define CALLBACK
 
@@ -40,44 +40,15 @@ float  fps_cur  = 0;
 
 #define MAXLACE 16
 
-// Estatisticas para frame limiter adaptativo (Xbox 360)
-static unsigned long s_adaptive_lastcheck = 0;
-static int s_frames_since_check = 0;
-int s_adaptive_skip_enabled = 0;  // Global para acesso externo
+// Frame skip preditivo (Xbox 360), ver AutoFrameSkip()
+int s_adaptive_skip_enabled = 0;  // Global para acesso externo (gameprofile)
+unsigned long ulAutoSkipped = 0;  // Total de frames pulados (estatistica)
+
+static DWORD s_framecap_wait = 0; // Ticks esperando no FrameCap desde o ultimo frame
 
 void CheckFrameRate(void)
 {
-	// Modo adaptativo Xbox 360: se FPS muito acima do target, limita
-	// Se FPS abaixo do target, ativa frame skip automatico
-	if(UseFrameLimit && iFrameLimit==2)  // Auto mode
-	{
-		unsigned long now = timeGetTime();
-		s_frames_since_check++;
-		
-		// A cada 1 segundo (100000 ticks), avalia performance
-		if((now - s_adaptive_lastcheck) >= 100000)
-		{
-			float current_fps = (float)s_frames_since_check;
-			float target_fps = PSXDisplay.PAL ? 50.0f : 60.0f;
-			
-			// Se FPS > 120% do target (ex: 80 FPS em NTSC), precisa limitar mais
-			if(current_fps > (target_fps * 1.2f))
-			{
-				// FPS muito alto - frame limiter trabalhando bem
-				s_adaptive_skip_enabled = 0;
-			}
-			// Se FPS < 90% do target (ex: 45 FPS em NTSC), ativa frame skip
-			else if(current_fps < (target_fps * 0.9f))
-			{
-				s_adaptive_skip_enabled = 1;
-			}
-			
-			s_frames_since_check = 0;
-			s_adaptive_lastcheck = now;
-		}
-	}
-	
-	if(UseFrameSkip || s_adaptive_skip_enabled)           // skipping mode?
+	if(UseFrameSkip)                                      // skipping mode?
 	{
 		if(!(dwActFixes&0x80))                              // not old skipping mode?
 		{
@@ -93,6 +64,7 @@ void CheckFrameRate(void)
 	}
 	else                                                  // non-skipping mode:
 	{
+		if(s_adaptive_skip_enabled) dwLaceCnt++;            // -> vsyncs do frame atual (orcamento do auto skip)
 		if(UseFrameLimit) FrameCap();                       // -> do it
 		if(ulKeybits&KEY_SHOWFPS) calcfps();                // -> and calc fps display
 	}
@@ -107,54 +79,151 @@ unsigned long timeGetTime()
 	return tv.tv_sec * 100000 + tv.tv_usec/10;            // to do that, but at least it works
 }
 
-// Otimizado para Xbox 360 - Remove busy-wait, usa timing eficiente
+// Limitador de frames (Xbox 360)
+// Prazo absoluto no timer: cada frame soma dwFrameRateTicks ao prazo e a
+// espera e feita so com Sleep (o resto < 1ms fica para o proximo frame,
+// entao nao acumula erro). O relogio mestre de longo prazo e o audio: as
+// amostras ja tocadas pelo XAudio2 (pAudioClock, em tempo nominal, sem a
+// reamostragem que corrige o nivel do anel) corrigem aos poucos o prazo,
+// assim o jogo roda na velocidade do relogio de audio e nao na do timer.
+// Sem audio (som desligado, voz parada) fica so o timer.
+
+#define AUDIO_RATE   44100
+#define AUDIO_STALL  4                                // frames sem o relogio andar -> voz parada
+#define AUDIO_GAIN   32                               // fracao do desvio corrigida por frame
+
+int (*pAudioClock)(unsigned long * pulSamples) = NULL;
+
+static BOOL bAudioResync = TRUE;
+
+// Retorna quantos ticks somar ao proximo prazo (negativo: audio na frente)
+static long AudioClockCorrection(void)
+{
+	static unsigned long firstclock = 0, lastclock = 0;
+	static DWORD dwFrames = 0;                            // frames desde a sincronizacao
+	static int   iStall = 0;
+	unsigned long clock;
+	double dExpected;
+	long lDrift, lMax;
+
+	if(!pAudioClock || !pAudioClock(&clock)) return 0;
+
+	if(clock == lastclock)                                // atualiza em blocos de ~10ms,
+	{                                                    // so conta como parada depois de alguns frames
+		if(iStall < AUDIO_STALL) iStall++;
+		else bAudioResync = TRUE;
+	}
+	else iStall = 0;
+	lastclock = clock;
+
+	if(bAudioResync)
+	{
+		if(iStall) return 0;                                // espera a voz voltar a andar
+		bAudioResync = FALSE;
+		firstclock = clock;
+		dwFrames = 0;
+		return 0;
+	}
+
+	dwFrames++;
+	dExpected = (double)dwFrames * AUDIO_RATE / fFrameRateHz;
+	lDrift = (long)(((double)(clock - firstclock) - dExpected) * TIMEBASE / AUDIO_RATE);
+
+	if(lDrift > (long)(2 * dwFrameRateTicks) ||           // jogo lento demais ou voz reiniciada:
+	   lDrift < -(long)(2 * dwFrameRateTicks))            // nao tenta recuperar, sincroniza de novo
+	{
+		bAudioResync = TRUE;
+		return 0;
+	}
+
+	lMax = dwFrameRateTicks / 32;
+	lDrift = -lDrift / AUDIO_GAIN;
+	if(lDrift >  lMax) lDrift =  lMax;
+	if(lDrift < -lMax) lDrift = -lMax;
+	return lDrift;
+}
+
 void FrameCap (void)
 {
-	static unsigned long curticks, lastticks, _ticks_since_last_update;
-	static unsigned int TicksToWait = 0;
-	int overslept=0, tickstogo=0;
-	
+	static DWORD deadline = 0;
+	DWORD curticks;
+	long  lWait;
+
 	curticks = timeGetTime();
-	_ticks_since_last_update = curticks - lastticks;
+	deadline += dwFrameRateTicks + AudioClockCorrection();
+	lWait = (long)(deadline - curticks);
 
-	// Se já passou do tempo alvo, calcula oversleep para compensar no próximo frame
-	if((_ticks_since_last_update > TicksToWait) || (curticks < lastticks))
+	// Muito atrasado (load, pausa, menu) ou prazo absurdo: recomeca a partir de agora
+	if(lWait < -(long)(2 * dwFrameRateTicks) || lWait > (long)(2 * dwFrameRateTicks))
 	{
-		lastticks = curticks;
-		overslept = _ticks_since_last_update - TicksToWait;
-		if((_ticks_since_last_update - TicksToWait) > dwFrameRateTicks)
-			TicksToWait = 0;
-		else
-			TicksToWait = dwFrameRateTicks - overslept;
-		return;  // Frame atrasado, não espera
+		deadline = curticks;
+		bAudioResync = TRUE;
+		return;
 	}
-	
-	// Precisa esperar - usa Sleep eficiente ao invés de busy-wait
-	tickstogo = TicksToWait - _ticks_since_last_update;
-	
-	if(tickstogo > 0)
+
+	if(lWait >= TIMEBASE / 1000)                          // dorme os ms inteiros, sem loop ativo
 	{
-		// Xbox 360: Sleep com granularidade menor (1ms ao invés de só quando >200)
-		// Isso libera a CPU para outros threads (SPU, GPU, etc)
-		unsigned int sleepTime = (tickstogo >= 100) ? (tickstogo / 100) : 1;
-		Sleep(sleepTime);
-		
-		// Atualiza tempo após sleep
-		curticks = timeGetTime();
-		_ticks_since_last_update = curticks - lastticks;
-		
-		// Se ainda precisa esperar um pouco, faz busy-wait curto (microssegundos)
-		while(_ticks_since_last_update < TicksToWait)
-		{
-			curticks = timeGetTime();
-			_ticks_since_last_update = curticks - lastticks;
-		}
+		Sleep(lWait / (TIMEBASE / 1000));
+		s_framecap_wait += timeGetTime() - curticks;        // Nao conta como custo do frame (AutoFrameSkip)
+	}
+}
+
+// Frame skip preditivo: chamado a cada frame apresentado no modo auto.
+// Mede o custo real de cada frame (tempo entre apresentacoes, sem a espera
+// do FrameCap), mantem uma media dos frames desenhados e o atraso acumulado
+// em relacao ao tempo do PSX. Se o proximo frame desenhado nao couber no
+// orcamento, pula a rasterizacao dele (so a parte visivel, ver gpu.c).
+
+#define AUTOSKIP_MAX   2                              // no maximo 2 frames pulados seguidos
+#define AUTOSKIP_DEBT  4                              // atraso maximo guardado, em frames
+
+void AutoFrameSkip(void)
+{
+	static DWORD lastticks = 0;
+	static DWORD avgDrawn = 0;                            // media do custo de um frame desenhado
+	static long  debt = 0;                                // atraso acumulado (ticks)
+	static int   iRun = 0;                                // frames pulados seguidos
+	DWORD curticks, dwWork, dwBudget;
+
+	curticks = timeGetTime();
+	dwWork = curticks - lastticks;
+	if(dwWork > s_framecap_wait) dwWork -= s_framecap_wait;
+	else dwWork = 0;
+	lastticks = curticks;
+	s_framecap_wait = 0;
+
+	dwBudget = (dwLaceCnt ? dwLaceCnt : 1) * dwFrameRateTicks;
+	dwLaceCnt = 0;
+
+	if(bInitCap)                                          // primeiro frame ou apos load: sem historico
+	{
+		bInitCap = FALSE;
+		avgDrawn = dwBudget; debt = 0; iRun = 0;
+		bSkipNextFrame = FALSE;
+		return;
+	}
+
+	if(dwWork > 8 * dwBudget) dwWork = 8 * dwBudget;      // pausa/menu: nao deixa um frame dominar
+
+	if(!bSkipNextFrame)                                   // frame desenhado: atualiza a previsao
+		avgDrawn = (avgDrawn * 3 + dwWork) / 4;
+
+	debt += (long)dwWork - (long)dwBudget;
+	if(debt < 0) debt = 0;
+	if(debt > (long)(AUTOSKIP_DEBT * dwBudget)) debt = AUTOSKIP_DEBT * dwBudget;
+
+	// Pula o proximo se o custo previsto + atraso nao cabem no tempo do PSX
+	if(iRun < AUTOSKIP_MAX && (long)avgDrawn + debt > (long)dwBudget)
+	{
+		bSkipNextFrame = TRUE;
+		iRun++;
+		ulAutoSkipped++;
+	}
+	else
+	{
+		bSkipNextFrame = FALSE;
+		iRun = 0;
 	}
-	
-	lastticks = timeGetTime();
-	overslept = _ticks_since_last_update - TicksToWait;
-	if(overslept < 0) overslept = 0;
-	TicksToWait = dwFrameRateTicks - overslept;
 }
 
 #define MAXSKIP 120
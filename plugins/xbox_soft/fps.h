@@ -31,12 +31,17 @@ void SetAutoFrameCap(void);
 void SetFPSHandler(void);
 void InitFPS(void);
 void CheckFrameRate(void);
+void AutoFrameSkip(void);
 
 // Variáveis para acesso externo (Xbox 360)
 extern int iFrameLimit;
 extern int UseFrameLimit;
 extern int UseFrameSkip;
 extern int s_adaptive_skip_enabled;
+extern unsigned long ulAutoSkipped;
+
+// Relogio de audio do FrameCap: amostras tocadas (44100 Hz), 0 se sem som
+extern int (*pAudioClock)(unsigned long * pulSamples);
 
 #ifdef __cplusplus
 }
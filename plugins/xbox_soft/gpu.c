@@ -137,6 +137,7 @@
 #include "key.h"
 #include "fps.h"
 #include "swap.h"
+#include "gpucap.h"
 
 ////////////////////////////////////////////////////////////////////////
 // PPDK developer must change libraryName field and can change revision and build
@@ -181,8 +182,8 @@ signed   char  *psxVsb;
 unsigned short *psxVuw;
 unsigned short *psxVuw_eom;
 signed   short *psxVsw;
-unsigned long  *psxVul;
-signed   long  *psxVsl;
+uint32_t       *psxVul;
+int32_t        *psxVsl;
 
 ////////////////////////////////////////////////////////////////////////
 // GPU globals
@@ -193,9 +194,9 @@ long              lGPUstatusRet;
 char              szDispBuf[64];
 char              szMenuBuf[36];
 char              szDebugText[512];
-unsigned long     ulStatusControl[256];      
+uint32_t          ulStatusControl[256];      
 
-static unsigned   long gpuDataM[256];
+static uint32_t  gpuDataM[256];
 static unsigned   char gpuCommand = 0;
 static long       gpuDataC = 0;
 static long       gpuDataP = 0;
@@ -215,9 +216,9 @@ PSXDisplay_t      PreviousPSXDisplay;
 long              lSelectedSlot=0;
 BOOL              bChangeWinMode=FALSE;
 BOOL              bDoLazyUpdate=FALSE;
-unsigned long     lGPUInfoVals[16];
+uint32_t          lGPUInfoVals[16];
 int               iFakePrimBusy=0;
-unsigned long     vBlank=0;
+uint32_t          vBlank=0;
 int               iRumbleVal=0;
 int               iRumbleTime=0;
 
@@ -503,7 +504,7 @@ long CALLBACK GPUinit()                                // GPU INIT
 long PEOPS_GPUinit()                                // GPU INIT
 #endif
 {
- memset(ulStatusControl,0,256*sizeof(unsigned long));  // init save state scontrol field
+ memset(ulStatusControl,0,256*sizeof(uint32_t));  // init save state scontrol field
 
  szDebugText[0]=0;                                     // init debug text buffer
 
@@ -515,14 +516,14 @@ long PEOPS_GPUinit()                                // GPU INIT
 
  psxVsb=(signed char *)psxVub;                         // different ways of accessing PSX VRAM
  psxVsw=(signed short *)psxVub;
- psxVsl=(signed long *)psxVub;
+ psxVsl=(int32_t *)psxVub;
  psxVuw=(unsigned short *)psxVub;
- psxVul=(unsigned long *)psxVub;
+ psxVul=(uint32_t *)psxVub;
 
  psxVuw_eom=psxVuw+1024*iGPUHeight;                    // pre-calc of end of vram
                         
  memset(psxVSecure,0x00,(iGPUHeight*2)*1024 + (1024*1024));
- memset(lGPUInfoVals,0x00,16*sizeof(unsigned long));
+ memset(lGPUInfoVals,0x00,16*sizeof(uint32_t));
  
  SetFPSHandler();   
 
@@ -723,6 +724,12 @@ void updateDisplay(void)                               // UPDATE DISPLAY
     }
    else FrameSkip();
   }
+ else
+ if(s_adaptive_skip_enabled)                           // predictive auto skip ?
+  {
+   if(!bSkipNextFrame) DoBufferSwap();                 // -> skipped frames keep the old picture
+   AutoFrameSkip();                                    // -> decide about the next one
+  }
  else                                                  // no skip ?
   {
    DoBufferSwap();                                     // -> swap
@@ -975,6 +982,8 @@ if(RECORD_RECORDING)
 #endif
 
  bDoVSyncUpdate=FALSE;                                 // vsync done
+
+ GPUcapUpdateLace(DataWriteMode==DR_NORMAL && gpuDataC==0);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -982,11 +991,13 @@ if(RECORD_RECORDING)
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef _XBOX
-unsigned long CALLBACK GPUreadStatus(void)             // READ STATUS
+uint32_t CALLBACK GPUreadStatus(void)             // READ STATUS
 #else 
-unsigned long PEOPS_GPUreadStatus(void)
+uint32_t PEOPS_GPUreadStatus(void)
 #endif 
 {
+ if(iGPUCapture) GPUcapReadStatus();
+
  if(dwActFixes&1)
   {
    static int iNumRead=0;                              // odd/even hack
@@ -1025,12 +1036,14 @@ unsigned long PEOPS_GPUreadStatus(void)
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef _XBOX
-void CALLBACK GPUwriteStatus(unsigned long gdata)      // WRITE STATUS
+void CALLBACK GPUwriteStatus(uint32_t gdata)      // WRITE STATUS
 #else 
-void PEOPS_GPUwriteStatus(unsigned long gdata)
+void PEOPS_GPUwriteStatus(uint32_t gdata)
 #endif 
 {
- unsigned long lCommand=(gdata>>24)&0xff;
+ uint32_t lCommand=(gdata>>24)&0xff;
+
+ if(iGPUCapture) GPUcapWriteStatus(gdata);
 
  ulStatusControl[lCommand]=gdata;                      // store command for freezing
 
@@ -1039,7 +1052,7 @@ void PEOPS_GPUwriteStatus(unsigned long gdata)
    //--------------------------------------------------//
    // reset gpu
    case 0x00:
-    memset(lGPUInfoVals,0x00,16*sizeof(unsigned long));
+    memset(lGPUInfoVals,0x00,16*sizeof(uint32_t));
     lGPUstatusRet=0x14802000;
     PSXDisplay.Disabled=1;
     DataWriteMode=DataReadMode=DR_NORMAL;
@@ -1318,13 +1331,15 @@ __inline void FinishedVRAMRead(void)
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef _XBOX
-void CALLBACK GPUreadDataMem(unsigned long * pMem, int iSize)
+void CALLBACK GPUreadDataMem(uint32_t * pMem, int iSize)
 #else 
-void PEOPS_GPUreadDataMem(unsigned long * pMem, int iSize)
+void PEOPS_GPUreadDataMem(uint32_t * pMem, int iSize)
 #endif 
 {
  int i;
 
+ if(iGPUCapture) GPUcapReadData(iSize);
+
  if(DataReadMode!=DR_VRAMTRANSFER) return;
 
  GPUIsBusy;
@@ -1341,7 +1356,7 @@ void PEOPS_GPUreadDataMem(unsigned long * pMem, int iSize)
    if ((VRAMRead.ColsRemaining > 0) && (VRAMRead.RowsRemaining > 0))
     {
      // lower 16 bit
-     lGPUdataRet=(unsigned long)GETLE16(VRAMRead.ImagePtr);
+     lGPUdataRet=(uint32_t)GETLE16(VRAMRead.ImagePtr);
 
      VRAMRead.ImagePtr++;
      if(VRAMRead.ImagePtr>=psxVuw_eom) VRAMRead.ImagePtr-=iGPUHeight*1024;
@@ -1356,7 +1371,7 @@ void PEOPS_GPUreadDataMem(unsigned long * pMem, int iSize)
       }
 
      // higher 16 bit (always, even if it's an odd width)
-     lGPUdataRet|=(unsigned long)GETLE16(VRAMRead.ImagePtr)<<16;
+     lGPUdataRet|=(uint32_t)GETLE16(VRAMRead.ImagePtr)<<16;
      PUTLE32(pMem, lGPUdataRet); pMem++;
 
      if(VRAMRead.ColsRemaining <= 0)
@@ -1386,13 +1401,13 @@ ENDREAD:
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef _XBOX
-unsigned long CALLBACK GPUreadData(void)
+uint32_t CALLBACK GPUreadData(void)
 #else 
-unsigned long PEOPS_GPUreadData(void)
+uint32_t PEOPS_GPUreadData(void)
 #endif 
 {
- unsigned long l;
- PEOPS_GPUreadDataMem(&l,1);
+ uint32_t l;
+ GPUreadDataMem(&l,1);
  return lGPUdataRet;
 }
 
@@ -1401,6 +1416,27 @@ unsigned long PEOPS_GPUreadData(void)
 // extra table entries for fixing polyline troubles
 ////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////
+// frame skipping only drops primitives that end up on screen: the drawing
+// area overlaps the displayed buffer or the one shown before the last
+// flip (double buffering). Off-screen render targets are still drawn.
+////////////////////////////////////////////////////////////////////////
+
+__inline BOOL DrawAreaOnScreen(void)
+{
+ int dw=PSXDisplay.DisplayMode.x,dh=PSXDisplay.DisplayMode.y;
+
+ if(drawX<PSXDisplay.DisplayPosition.x+dw && drawW>=PSXDisplay.DisplayPosition.x &&
+    drawY<PSXDisplay.DisplayPosition.y+dh && drawH>=PSXDisplay.DisplayPosition.y)
+  return TRUE;
+ if(drawX<PreviousPSXDisplay.DisplayPosition.x+dw && drawW>=PreviousPSXDisplay.DisplayPosition.x &&
+    drawY<PreviousPSXDisplay.DisplayPosition.y+dh && drawH>=PreviousPSXDisplay.DisplayPosition.y)
+  return TRUE;
+ return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////
+
 const unsigned char primTableCX[256] =
 {
     // 00
@@ -1472,13 +1508,13 @@ const unsigned char primTableCX[256] =
 };
 
 #ifndef _XBOX
-void CALLBACK GPUwriteDataMem(unsigned long * pMem, int iSize)
+void CALLBACK GPUwriteDataMem(uint32_t * pMem, int iSize)
 #else 
-void PEOPS_GPUwriteDataMem(unsigned long * pMem, int iSize)
+void PEOPS_GPUwriteDataMem(uint32_t * pMem, int iSize)
 #endif
 {
  unsigned char command;
- unsigned long gdata=0;
+ uint32_t gdata=0;
  int i=0;
 
 #ifdef PEOPS_SDLOG
@@ -1489,6 +1525,8 @@ void PEOPS_GPUwriteDataMem(unsigned long * pMem, int iSize)
 	DEBUG_print("close",DBG_SDGECKOCLOSE);
 #endif //PEOPS_SDLOG
 
+ if(iGPUCapture) GPUcapWriteData(pMem,iSize);
+
  GPUIsBusy;
  GPUIsNotReadyForCommands;
 
@@ -1523,7 +1561,7 @@ STARTVRAM:
          VRAMWrite.ColsRemaining--;
          if (VRAMWrite.ColsRemaining <= 0)             // last pixel is odd width
           {
-           gdata=(gdata&0xFFFF)|(((unsigned long)GETLE16(VRAMWrite.ImagePtr))<<16);
+           gdata=(gdata&0xFFFF)|(((uint32_t)GETLE16(VRAMWrite.ImagePtr))<<16);
            FinishedVRAMWrite();
            bDoVSyncUpdate=TRUE;
            goto ENDVRAM;
@@ -1551,10 +1589,6 @@ ENDVRAM:
 
  if(DataWriteMode==DR_NORMAL)
   {
-   void (* *primFunc)(unsigned char *);
-   if(bSkipNextFrame) primFunc=primTableSkip;
-   else               primFunc=primTableJ;
-
    for(;i<iSize;)
     {
      if(DataWriteMode==DR_VRAMTRANSFER) goto STARTVRAM;
@@ -1608,7 +1642,12 @@ ENDVRAM:
 	DEBUG_print("close",DBG_SDGECKOCLOSE);
 #endif //PEOPS_SDLOG
        gpuDataC=gpuDataP=0;
-       primFunc[gpuCommand]((unsigned char *)gpuDataM);
+       if(bSkipNextFrame && DrawAreaOnScreen())        // skipping: uploads, copies and
+        {                                              // off-screen targets still happen
+         primTableSkip[gpuCommand]((unsigned char *)gpuDataM);
+         bDoVSyncUpdate=TRUE;                          // keep the vsync/skip logic running
+        }
+       else primTableJ[gpuCommand]((unsigned char *)gpuDataM);
 
 //       if(dwEmuFixes&0x0001 || dwActFixes&0x0400)      // hack for emulating "gpu busy" in some games
 //        iFakePrimBusy=4;
@@ -1625,13 +1664,13 @@ ENDVRAM:
 ////////////////////////////////////////////////////////////////////////
 
 #ifndef _XBOX
-void CALLBACK GPUwriteData(unsigned long gdata)
+void CALLBACK GPUwriteData(uint32_t gdata)
 #else 
-void PEOPS_GPUwriteData(unsigned long gdata)
+void PEOPS_GPUwriteData(uint32_t gdata)
 #endif 
 {
  PUTLE32(&gdata, gdata);
- PEOPS_GPUwriteDataMem(&gdata,1);
+ GPUwriteDataMem(&gdata,1);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -1697,28 +1736,55 @@ void SetFixes(void)
 // process gpu commands
 ////////////////////////////////////////////////////////////////////////
 
-unsigned long lUsedAddr[3];
+// The chain walker gathers the packets of the linked list into one
+// command buffer, so writeDataMem gets called once per batch instead
+// of once per (usually tiny) packet. The gpu sees the very same word
+// stream. A node reached twice means the list loops forever, a bitmap
+// over psx ram catches that (only the touched bitmap words get cleared
+// again, see the dirty map).
 
-__inline BOOL CheckForEndlessLoop(unsigned long laddr)
+#define DMA_RAMWORDS  (0x200000>>2)                     // one bit per word of the 2 MB ram
+#define DMA_BATCH     4096                              // words per writeDataMem call
+
+static uint32_t ulDmaVisited[DMA_RAMWORDS/32];
+static uint32_t ulDmaDirty[DMA_RAMWORDS/32/32];
+static uint32_t ulDmaBatch[DMA_BATCH];
+
+__inline BOOL CheckForEndlessLoop(uint32_t laddr)
 {
- if(laddr==lUsedAddr[1]) return TRUE;
- if(laddr==lUsedAddr[2]) return TRUE;
+ uint32_t n,w,b;
+
+ if(laddr>=0x200000) return FALSE;                     // zn ram above 2 MB: only the counter limit
 
- if(laddr<lUsedAddr[0]) lUsedAddr[1]=laddr;
- else                   lUsedAddr[2]=laddr;
- lUsedAddr[0]=laddr;
+ n=laddr>>2;w=n>>5;b=1u<<(n&31);
+ if(ulDmaVisited[w]&b) return TRUE;
+ ulDmaVisited[w]|=b;
+ ulDmaDirty[w>>5]|=1u<<(w&31);
  return FALSE;
 }
 
+static void ClearEndlessLoopCheck(void)
+{
+ int i,j;uint32_t d;
+
+ for(i=0;i<DMA_RAMWORDS/32/32;i++)
+  {
+   d=ulDmaDirty[i];
+   if(!d) continue;
+   ulDmaDirty[i]=0;
+   for(j=i<<5;d;j++,d>>=1)
+    if(d&1) ulDmaVisited[j]=0;
+  }
+}
+
 #ifndef _XBOX
-long CALLBACK GPUdmaChain(unsigned long * baseAddrL, unsigned long addr)
+long CALLBACK GPUdmaChain(uint32_t * baseAddrL, uint32_t addr)
 #else 
-long PEOPS_GPUdmaChain(unsigned long * baseAddrL, unsigned long addr)
+long PEOPS_GPUdmaChain(uint32_t * baseAddrL, uint32_t addr)
 #endif 
 {
- unsigned long dmaMem;
- unsigned char * baseAddrB;
- short count;unsigned int DMACommandCounter = 0;
+ uint32_t hdr,node;
+ int count,iBatch=0;unsigned int DMACommandCounter = 0;
 
  #ifdef PEOPS_SDLOG
 	DEBUG_print("append",DBG_SDGECKOAPPEND);
@@ -1729,26 +1795,37 @@ long PEOPS_GPUdmaChain(unsigned long * baseAddrL, unsigned long addr)
 
  GPUIsBusy;
 
- lUsedAddr[0]=lUsedAddr[1]=lUsedAddr[2]=0xffffff;
-
- baseAddrB = (unsigned char*) baseAddrL;
-
  do
   {
-   if(iGPUHeight==512) addr&=0x1FFFFC;
+   node=addr;
+   if(iGPUHeight==512) node&=0x1FFFFC;
    if(DMACommandCounter++ > 2000000) break;
-   if(CheckForEndlessLoop(addr)) break;
-
-   count = baseAddrB[addr+3];
+   if(CheckForEndlessLoop(node)) break;
 
-   dmaMem=addr+4;
+   hdr = GETLE32(&baseAddrL[node>>2]);
+   count = hdr>>24;
+   addr = hdr&0xffffff;
 
-   if(count>0) PEOPS_GPUwriteDataMem(&baseAddrL[dmaMem>>2],count);
+   if(addr!=0xffffff)                                  // next node: let the cache fetch it
+    __dcbt(0,&baseAddrL[(addr&0x1FFFFC)>>2]);          // while this packet gets copied
 
-   addr = GETLE32(&baseAddrL[addr>>2])&0xffffff;
+   if(count>0)
+    {
+     if(iBatch+count>DMA_BATCH)
+      {
+       GPUwriteDataMem(ulDmaBatch,iBatch);
+       iBatch=0;
+      }
+     memcpy(&ulDmaBatch[iBatch],&baseAddrL[(node>>2)+1],count<<2);
+     iBatch+=count;
+    }
   }
  while (addr != 0xffffff);
 
+ if(iBatch) GPUwriteDataMem(ulDmaBatch,iBatch);
+
+ ClearEndlessLoopCheck();
+
  GPUIsIdle;
 
  return 0;
@@ -1804,9 +1881,9 @@ long CALLBACK GPUtest(void)
 
 typedef struct GPUFREEZETAG
 {
- unsigned long ulFreezeVersion;      // should be always 1 for now (set by main emu)
- unsigned long ulStatus;             // current gpu status
- unsigned long ulControl[256];       // latest control register values
+ uint32_t      ulFreezeVersion;      // should be always 1 for now (set by main emu)
+ uint32_t      ulStatus;             // current gpu status
+ uint32_t      ulControl[256];       // latest control register values
  unsigned char psxVRam[1024*1024*2]; // current VRam image (full 2 MB for ZN)
 } GPUFreeze_t;
 
@@ -1835,7 +1912,7 @@ long PEOPS_GPUfreeze(unsigned long ulGetFreezeData,GPUFreeze_t * pF)
  if(ulGetFreezeData==1)                                // 1: get data (Save State)
   {
    pF->ulStatus=lGPUstatusRet;
-   memcpy(pF->ulControl,ulStatusControl,256*sizeof(unsigned long));
+   memcpy(pF->ulControl,ulStatusControl,256*sizeof(uint32_t));
    memcpy(pF->psxVRam,  psxVub,         1024*iGPUHeight*2); //done in Misc.c
 
    return 1;
@@ -1844,7 +1921,7 @@ long PEOPS_GPUfreeze(unsigned long ulGetFreezeData,GPUFreeze_t * pF)
  if(ulGetFreezeData!=0) return 0;                      // 0: set data (Load State)
 
  lGPUstatusRet=pF->ulStatus;
- memcpy(ulStatusControl,pF->ulControl,256*sizeof(unsigned long));
+ memcpy(ulStatusControl,pF->ulControl,256*sizeof(uint32_t));
  memcpy(psxVub,         pF->psxVRam,  1024*iGPUHeight*2); //done in Misc.c
 
 // RESET TEXTURE STORE HERE, IF YOU USE SOMETHING LIKE THAT
@@ -2555,6 +2632,7 @@ void CALLBACK GPUsetfix(unsigned long dwFixBits)
 
 void CALLBACK GPUvBlank( int val )
 {
+	if(iGPUCapture) GPUcapVBlank(val);
 	vBlank = val;
 }
 
@@ -2565,7 +2643,7 @@ void CALLBACK GPUsetframelimit(unsigned long option)
 {
  bInitCap = TRUE;
 
-#ifdef _XBOX
+#if defined(_XBOX) || !defined(FRAMELIMIT_AUTO)         // wii frontend globals only
  if(option==1)
   {
    UseFrameLimit=1;UseFrameSkip=0;iFrameLimit=2;
@@ -0,0 +1,186 @@
+/***************************************************************************
+                          gpucap.c  -  description
+                             -------------------
+ GPU command-stream capture (plugin boundary recorder)
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "externals.h"
+#include "gpucap.h"
+
+////////////////////////////////////////////////////////////////////////
+// Everything crossing the plugin interface is appended to a file, see
+// gpucap.h for the layout. The frontend only sets a request, the file
+// itself is opened/closed by the gpu thread on vsync.
+////////////////////////////////////////////////////////////////////////
+
+#define CAPBUFSIZE (256*1024)
+
+int                  iGPUCapture=0;
+
+static FILE *        fCap=NULL;
+static volatile int  iCapRequest=0;                    // 1: start, 2: stop
+static char          szCapFile[260];
+static uint32_t      ulStatusReads=0;                  // merged readStatus calls
+
+////////////////////////////////////////////////////////////////////////
+
+static void CapPut8(unsigned char c)
+{
+ fputc(c,fCap);
+}
+
+static void CapPut32(uint32_t l)
+{
+ unsigned char b[4];
+
+ b[0]=(unsigned char)l;                                // always little endian
+ b[1]=(unsigned char)(l>>8);
+ b[2]=(unsigned char)(l>>16);
+ b[3]=(unsigned char)(l>>24);
+ fwrite(b,4,1,fCap);
+}
+
+static void CapFlushStatusReads(void)
+{
+ if(!ulStatusReads) return;
+ CapPut8(GPUCAP_READSTATUS);
+ CapPut32(ulStatusReads);
+ ulStatusReads=0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// header: current gpu state, so the replay can start mid game
+////////////////////////////////////////////////////////////////////////
+
+static void CapWriteHeader(void)
+{
+ int i;
+
+ fwrite(GPUCAP_MAGIC,8,1,fCap);
+ CapPut32(GPUCAP_VERSION);
+ CapPut32((uint32_t)iGPUHeight);
+ CapPut32((uint32_t)lGPUstatusRet);
+ CapPut32(dwActFixes);
+
+ for(i=0;i<256;i++) CapPut32(ulStatusControl[i]);
+
+ // e1..e6 are not kept anywhere, rebuild them from the decoded state
+ CapPut32(0xe1000000|(lGPUstatusRet&0x7ff)|((GlobalTextREST<<9)&0xfffe00));
+ CapPut32(0xe2000000|lGPUInfoVals[INFO_TW]);
+ CapPut32(0xe3000000|lGPUInfoVals[INFO_DRAWSTART]);
+ CapPut32(0xe4000000|lGPUInfoVals[INFO_DRAWEND]);
+ CapPut32(0xe5000000|lGPUInfoVals[INFO_DRAWOFF]);
+ CapPut32(0xe6000000|((lGPUstatusRet>>11)&3));
+
+ fwrite(psxVub,1024*iGPUHeight*2,1,fCap);              // vram is le already
+}
+
+static void CapOpen(void)
+{
+ fCap=fopen(szCapFile,"wb");
+ if(!fCap) return;
+
+ setvbuf(fCap,NULL,_IOFBF,CAPBUFSIZE);
+
+ ulStatusReads=0;
+ CapWriteHeader();
+ iGPUCapture=1;
+}
+
+static void CapClose(void)
+{
+ CapFlushStatusReads();
+ CapPut8(GPUCAP_END);
+ fclose(fCap);
+ fCap=NULL;
+ iGPUCapture=0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// frontend interface
+////////////////////////////////////////////////////////////////////////
+
+void GPUcaptureStart(const char * pFileName)
+{
+ if(iGPUCapture || iCapRequest) return;
+
+ strncpy(szCapFile,pFileName,sizeof(szCapFile)-1);
+ szCapFile[sizeof(szCapFile)-1]=0;
+ iCapRequest=1;
+}
+
+void GPUcaptureStop(void)
+{
+ if(iGPUCapture) iCapRequest=2;
+ else            iCapRequest=0;                        // cancel a pending start
+}
+
+int GPUcaptureActive(void)
+{
+ return iGPUCapture || iCapRequest==1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// gpu.c hooks
+////////////////////////////////////////////////////////////////////////
+
+void GPUcapWriteStatus(uint32_t gdata)
+{
+ CapFlushStatusReads();
+ CapPut8(GPUCAP_WRITESTATUS);
+ CapPut32(gdata);
+}
+
+void GPUcapWriteData(const uint32_t * pMem, int iSize)
+{
+ if(iSize<=0) return;
+ CapFlushStatusReads();
+ CapPut8(GPUCAP_WRITEDATA);
+ CapPut32((uint32_t)iSize);
+ fwrite(pMem,4,iSize,fCap);                            // raw psx words
+}
+
+void GPUcapReadData(int iSize)
+{
+ CapFlushStatusReads();
+ CapPut8(GPUCAP_READDATA);
+ CapPut32((uint32_t)iSize);
+}
+
+void GPUcapReadStatus(void)
+{
+ ulStatusReads++;
+}
+
+void GPUcapVBlank(int val)
+{
+ CapFlushStatusReads();
+ CapPut8(GPUCAP_VBLANK);
+ CapPut32((uint32_t)val);
+}
+
+void GPUcapUpdateLace(int bIdle)
+{
+ if(iGPUCapture)
+  {
+   CapFlushStatusReads();
+   CapPut8(GPUCAP_UPDATELACE);
+  }
+
+ if(!iCapRequest || !bIdle) return;                    // start/stop on a clean state only
+
+ if(iCapRequest==2 && iGPUCapture) CapClose();
+ else
+ if(iCapRequest==1 && !iGPUCapture) CapOpen();
+
+ iCapRequest=0;
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+                          gpucap.h  -  description
+                             -------------------
+ GPU command-stream capture (plugin boundary recorder)
+ ***************************************************************************/
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version. See also the license.txt file for *
+ *   additional informations.                                              *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef _GPU_CAPTURE_H_
+#define _GPU_CAPTURE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// file layout (every integer is little endian)
+//
+// header:
+//  char     magic[8]             "PSXGPCAP"
+//  uint32   version              GPUCAP_VERSION
+//  uint32   iGPUHeight           512 (psx) or 1024 (zn)
+//  uint32   lGPUstatusRet
+//  uint32   dwActFixes
+//  uint32   ulStatusControl[256]
+//  uint32   env[6]               rebuilt e1..e6 draw environment
+//  uint8    vram[1024*iGPUHeight*2]
+//
+// records, one type byte followed by the payload:
+//  GPUCAP_WRITESTATUS  uint32 value
+//  GPUCAP_WRITEDATA    uint32 count, count raw psx words (dma chains
+//                      are flattened to one record per walker batch)
+//  GPUCAP_READDATA     uint32 count
+//  GPUCAP_READSTATUS   uint32 count (consecutive reads are merged)
+//  GPUCAP_VBLANK       uint32 value
+//  GPUCAP_UPDATELACE   -
+//  GPUCAP_END          -
+//
+// capture always starts and stops on a vsync, with no primitive or
+// vram transfer in flight, so a replay only needs the header state.
+////////////////////////////////////////////////////////////////////////
+
+#define GPUCAP_MAGIC        "PSXGPCAP"
+#define GPUCAP_VERSION      1
+
+#define GPUCAP_WRITESTATUS  0x01
+#define GPUCAP_WRITEDATA    0x02
+#define GPUCAP_READDATA     0x03
+#define GPUCAP_READSTATUS   0x04
+#define GPUCAP_VBLANK       0x05
+#define GPUCAP_UPDATELACE   0x06
+#define GPUCAP_END          0xff
+
+// frontend side (any thread): the request is served on the next vsync
+void GPUcaptureStart(const char * pFileName);
+void GPUcaptureStop(void);
+int  GPUcaptureActive(void);
+
+// plugin side (gpu.c), only called while iGPUCapture is set
+extern int iGPUCapture;
+
+void GPUcapWriteStatus(uint32_t gdata);
+void GPUcapWriteData(const uint32_t * pMem, int iSize);
+void GPUcapReadData(int iSize);
+void GPUcapReadStatus(void);
+void GPUcapVBlank(int val);
+
+// called at the end of every updateLace, bIdle: no command pending
+void GPUcapUpdateLace(int bIdle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _GPU_CAPTURE_H_
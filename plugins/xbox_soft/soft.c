@@ -26,7 +26,9 @@ email                : BlackDove@addcom.de
 #include "menu.h"
 #include "swap.h"
 
+#ifdef _XBOX
 #include <xtl.h>
+#endif
 
 #ifdef _WINDOWS
 #pragma warning (disable:4244)
@@ -1177,7 +1179,6 @@ void FillSoftwareArea(short x0,short y0,short x1,      // FILL AREA (BLK FILL)
 		uint32_t * __restrict DSTPtr;
 		unsigned short LineOffset;
 		
-		int vOffset = 0;
 		uint32_t lcol=(((int32_t)col)<<16)|col;
 		dx>>=1;
 		DSTPtr = (uint32_t *)(psxVuw + (1024*y0) + x0);
@@ -0,0 +1,239 @@
+/***************************************************************************
+                        cdzpack.c  -  description
+                             -------------------
+ Converts a disc image to the compressed CDZ format (libpcsxcore/cdz.h)
+ and back
+
+ The image is cut in hunks of n sectors that are deflated one by one,
+ hunks that don't get smaller are stored. After writing, the whole file
+ is read back through the emulator's reader (cdz.c, with its hunk cache)
+ and compared with the image.
+
+ usage: cdzpack [-s sectors] [-l level] image.cue|image.bin [out.cdz]
+        cdzpack -x image.cdz [out.bin]
+
+   -s n   sectors per hunk (default 16), the unit of every read
+   -l n   zlib level 1..9 (default 9)
+   -x     unpack a cdz file
+
+ A .cue is only used to find its data file. The .cdz gets the name of
+ the .cue (or of the image), so cdriso.c still finds the .cue/.toc/.ccd
+ and .sub files next to it.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "cdz.h"
+
+static void Put32(unsigned char * p, unsigned int l)
+{
+ p[0] = (unsigned char)l;         p[1] = (unsigned char)(l >> 8);
+ p[2] = (unsigned char)(l >> 16); p[3] = (unsigned char)(l >> 24);
+}
+
+// name with the extension replaced
+static void NewExt(char * dst, const char * name, const char * ext)
+{
+ char * dot;
+
+ strcpy(dst, name);
+ dot = strrchr(dst, '.');
+ if(dot && !strchr(dot, '/') && !strchr(dot, '\\')) *dot = 0;
+ strcat(dst, ext);
+}
+
+// the data file of a .cue: the first FILE line, relative to the .cue
+static int CueDataFile(const char * cue, char * bin)
+{
+ FILE * f = fopen(cue, "r");
+ char line[1024], name[1024];
+ const char * slash;
+
+ if(!f) return 0;
+ while(fgets(line, sizeof(line), f))
+  {
+   if(sscanf(line, " FILE \"%1023[^\"]\"", name) == 1 || sscanf(line, " FILE %1023s", name) == 1)
+    {
+     fclose(f);
+     slash = strrchr(cue, '/');
+     if(!slash) slash = strrchr(cue, '\\');
+     if(name[0] == '/' || !slash) strcpy(bin, name);
+     else { memcpy(bin, cue, slash + 1 - cue); strcpy(bin + (slash + 1 - cue), name); }
+     return 1;
+    }
+  }
+ fclose(f);
+ return 0;
+}
+
+static unsigned char * LoadFile(const char * name, unsigned int * size)
+{
+ FILE * f = fopen(name, "rb");
+ unsigned char * buf;
+ long n;
+
+ if(!f) { fprintf(stderr, "can't open %s\n", name); return NULL; }
+ fseek(f, 0, SEEK_END); n = ftell(f); fseek(f, 0, SEEK_SET);
+ buf = (unsigned char *)malloc(n + 1);
+ if(!buf || fread(buf, 1, n, f) != (size_t)n) { fclose(f); free(buf); return NULL; }
+ fclose(f);
+ *size = (unsigned int)n;
+ return buf;
+}
+
+static int Pack(const char * in, const char * out, int sectors, int level)
+{
+ unsigned int size, sector, hunkBytes, hunks, i, raw, pos, stored = 0;
+ unsigned char * img, * idx, * tmp, * back;
+ unsigned char h[CDZ_HEADER_BYTES];
+ uLongf packed;
+ CdzFile * cdz;
+ FILE * f;
+ int ok;
+
+ img = LoadFile(in, &size);
+ if(!img) return 0;
+
+ // hunks of whole sectors of the image layout
+ if(size % 2352 == 0)      sector = 2352;
+ else if(size % 2448 == 0) sector = 2448;              // subchannel mixed in
+ else if(size % 2048 == 0) sector = 2048;
+ else                      sector = 2352;
+ hunkBytes = sectors * sector;
+ hunks = (size + hunkBytes - 1) / hunkBytes;
+
+ idx = (unsigned char *)malloc((hunks + 1) * 4);
+ tmp = (unsigned char *)malloc(compressBound(hunkBytes));
+ f = fopen(out, "wb");
+ if(!idx || !tmp || !f) { fprintf(stderr, "can't write %s\n", out); return 0; }
+
+ memcpy(h, CDZ_MAGIC, 8);
+ Put32(h + 8, CDZ_VERSION);
+ Put32(h + 12, hunkBytes);
+ Put32(h + 16, size);
+ Put32(h + 20, hunks);
+ fwrite(h, 1, CDZ_HEADER_BYTES, f);
+ fwrite(idx, 4, hunks + 1, f);                          // filled in below
+
+ pos = CDZ_HEADER_BYTES + (hunks + 1) * 4;
+ for(i = 0; i < hunks; i++)
+  {
+   raw = size - i * hunkBytes;
+   if(raw > hunkBytes) raw = hunkBytes;
+
+   Put32(idx + i * 4, pos);
+   packed = compressBound(hunkBytes);
+   if(compress2(tmp, &packed, img + i * hunkBytes, raw, level) != Z_OK || packed >= raw)
+    {
+     fwrite(img + i * hunkBytes, 1, raw, f);            // stored
+     pos += raw;
+     stored++;
+    }
+   else
+    {
+     fwrite(tmp, 1, packed, f);
+     pos += packed;
+    }
+  }
+ Put32(idx + hunks * 4, pos);
+ fseek(f, CDZ_HEADER_BYTES, SEEK_SET);
+ fwrite(idx, 4, hunks + 1, f);
+ fclose(f);
+
+ printf("%s: %u bytes, %u byte sectors, %u hunks of %u bytes (%u stored)\n",
+        in, size, sector, hunks, hunkBytes, stored);
+ printf("%s: %u bytes, %.1f%%\n", out, pos, pos * 100.0 / (size ? size : 1));
+
+ // read back through the emulator's reader, one sector at a time
+ f = fopen(out, "rb");
+ cdz = f ? CdzOpen(f) : NULL;
+ back = (unsigned char *)malloc(sector);
+ ok = cdz && back && CdzSize(cdz) == size;
+ for(i = 0; ok && i < size; i += sector)
+  {
+   raw = size - i < sector ? size - i : sector;
+   ok = CdzRead(cdz, back, i, raw) == raw && !memcmp(back, img + i, raw);
+  }
+ if(ok) printf("verified\n");
+ else   fprintf(stderr, "%s: read back differs at byte %u\n", out, i);
+
+ CdzClose(cdz);
+ if(f) fclose(f);
+ free(back); free(img); free(idx); free(tmp);
+ return ok;
+}
+
+static int Unpack(const char * in, const char * out)
+{
+ FILE * f = fopen(in, "rb"), * o;
+ unsigned char * buf;
+ unsigned int size, pos, n;
+ CdzFile * cdz = f ? CdzOpen(f) : NULL;
+
+ if(!cdz) { fprintf(stderr, "%s: not a cdz file\n", in); return 0; }
+
+ o = fopen(out, "wb");
+ buf = (unsigned char *)malloc(1024 * 1024);
+ if(!o || !buf) { fprintf(stderr, "can't write %s\n", out); return 0; }
+
+ size = CdzSize(cdz);
+ for(pos = 0; pos < size; pos += n)
+  {
+   n = CdzRead(cdz, buf, pos, 1024 * 1024);
+   if(!n) { fprintf(stderr, "%s: damaged hunk near byte %u\n", in, pos); break; }
+   fwrite(buf, 1, n, o);
+  }
+ fclose(o);
+ CdzClose(cdz);
+ fclose(f);
+ free(buf);
+
+ printf("%s: %u bytes\n", out, pos);
+ return pos == size;
+}
+
+int main(int argc, char ** argv)
+{
+ const char * in = NULL, * out = NULL;
+ char bin[1024], name[1024];
+ int sectors = CDZ_HUNK_SECTORS, level = 9, unpack = 0, i;
+ size_t len;
+
+ for(i = 1; i < argc; i++)
+  {
+   if(!strcmp(argv[i], "-s") && i + 1 < argc)      sectors = atoi(argv[++i]);
+   else if(!strcmp(argv[i], "-l") && i + 1 < argc) level = atoi(argv[++i]);
+   else if(!strcmp(argv[i], "-x"))                 unpack = 1;
+   else if(argv[i][0] != '-' && !in)               in = argv[i];
+   else if(argv[i][0] != '-' && !out)              out = argv[i];
+   else { in = NULL; break; }
+  }
+ if(!in || sectors < 1 || sectors > CDZ_MAX_HUNK_SECTORS || level < 1 || level > 9)
+  {
+   fprintf(stderr, "usage: cdzpack [-s sectors] [-l level] image.cue|image.bin [out.cdz]\n"
+                   "       cdzpack -x image.cdz [out.bin]\n");
+   return 2;
+  }
+
+ if(strlen(in) >= sizeof(name) - 8) return 2;
+
+ if(unpack)
+  {
+   if(!out) { NewExt(name, in, ".bin"); out = name; }
+   return Unpack(in, out) ? 0 : 1;
+  }
+
+ if(!out) { NewExt(name, in, ".cdz"); out = name; }
+
+ len = strlen(in);
+ if(len > 4 && !strcmp(in + len - 4, ".cue"))
+  {
+   if(!CueDataFile(in, bin)) { fprintf(stderr, "%s: no FILE line\n", in); return 2; }
+   in = bin;
+  }
+
+ return Pack(in, out, sectors, level) ? 0 : 1;
+}
@@ -0,0 +1,427 @@
+/***************************************************************************
+                        gpureplay.c  -  description
+                             -------------------
+ Headless replay of a GPU command-stream capture (plugins/xbox_soft/gpucap.c)
+
+ The capture is loaded and decoded up front, then fed through the real
+ soft gpu plugin (gpu.c, prim.c, soft.c, zn.c) with display, fps and menu
+ stubbed out. Prints primitives/s, pixels/s and a crc32 of the vram at
+ every vsync, which can be stored and checked again later to catch
+ rasterizer regressions.
+
+ usage: gpureplay [-r runs] [-v] [-w crcfile] [-c crcfile] capture.gpc
+
+   -r n   replay the capture n times, timing is the best run
+   -v     print one line per frame
+   -w f   write the per frame vram crcs to f
+   -c f   compare the per frame vram crcs with f, exit code 1 on mismatch
+
+ The pixel count is an estimate: the area of every primitive as sent,
+ before clipping against the drawing area.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "gpucap.h"
+
+// plugin entry points (linux names, see gpu.c)
+
+long     GPUinit(void);
+long     GPUopen(unsigned long * disp,char * CapText,char * CfgFile);
+void     GPUwriteStatus(uint32_t gdata);
+void     GPUwriteDataMem(uint32_t * pMem, int iSize);
+uint32_t GPUreadStatus(void);
+void     GPUreadDataMem(uint32_t * pMem, int iSize);
+void     GPUupdateLace(void);
+void     GPUvBlank(int val);
+
+typedef struct
+{
+ uint32_t ulFreezeVersion;
+ uint32_t ulStatus;
+ uint32_t ulControl[256];
+ unsigned char psxVRam[1024*1024*2];
+} GPUFreeze_t;
+
+long     GPUfreeze(uint32_t ulGetFreezeData,GPUFreeze_t * pF);
+
+// plugin globals
+
+extern int            iGPUHeight;
+extern uint32_t       dwActFixes;
+extern long           lGPUstatusRet;
+extern unsigned char *psxVub;
+extern void         (*primTableJ[256])(unsigned char *);
+
+////////////////////////////////////////////////////////////////////////
+// decoded capture
+////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+ unsigned char type;
+ uint32_t      val;                                    // value or word count
+ uint32_t *    data;                                   // GPUCAP_WRITEDATA only
+} CapEvent;
+
+static GPUFreeze_t *  pState;
+static uint32_t       env[6];
+static uint32_t       ulHeight;
+static uint32_t       ulStatus;
+static uint32_t       ulFixes;
+
+static CapEvent *     events;
+static int            nEvents;
+static int            nFrames;
+
+static uint32_t       readBuf[1024*1024/2];           // sink for vram reads
+
+static uint32_t Get32(const unsigned char * p)
+{
+ return p[0]|(p[1]<<8)|(p[2]<<16)|((uint32_t)p[3]<<24);
+}
+
+static int LoadCapture(const char * name)
+{
+ FILE * f;
+ long size,pos;
+ unsigned char * buf;
+ int i,maxEvents;
+
+ f=fopen(name,"rb");
+ if(!f) {fprintf(stderr,"can't open %s\n",name);return 0;}
+ fseek(f,0,SEEK_END);size=ftell(f);fseek(f,0,SEEK_SET);
+ buf=(unsigned char *)malloc(size);
+ if(!buf || fread(buf,1,size,f)!=(size_t)size) {fclose(f);return 0;}
+ fclose(f);
+
+ if(size<8+4*4+256*4+6*4 || memcmp(buf,GPUCAP_MAGIC,8))
+  {fprintf(stderr,"%s: not a gpu capture\n",name);return 0;}
+ if(Get32(buf+8)!=GPUCAP_VERSION)
+  {fprintf(stderr,"%s: unsupported version %u\n",name,Get32(buf+8));return 0;}
+
+ ulHeight=Get32(buf+12);
+ ulStatus=Get32(buf+16);
+ ulFixes =Get32(buf+20);
+ if(ulHeight!=512 && ulHeight!=1024)
+  {fprintf(stderr,"%s: bad vram height %u\n",name,ulHeight);return 0;}
+
+ pState=(GPUFreeze_t *)calloc(1,sizeof(GPUFreeze_t));
+ pState->ulFreezeVersion=1;
+ pState->ulStatus=ulStatus;
+ pos=24;
+ for(i=0;i<256;i++,pos+=4) pState->ulControl[i]=Get32(buf+pos);
+ for(i=0;i<6;i++,pos+=4)   env[i]=Get32(buf+pos);
+ if(pos+1024*(long)ulHeight*2>size)
+  {fprintf(stderr,"%s: truncated header\n",name);return 0;}
+ memcpy(pState->psxVRam,buf+pos,1024*ulHeight*2);
+ pos+=1024*ulHeight*2;
+
+ // records: every one is at least 1 byte, so this is an upper bound
+ maxEvents=(int)(size-pos)+1;
+ events=(CapEvent *)malloc(maxEvents*sizeof(CapEvent));
+
+ while(pos<size)
+  {
+   CapEvent * e=&events[nEvents];
+   e->type=buf[pos++];
+   e->val=0;e->data=NULL;
+   if(e->type==GPUCAP_END) break;
+   if(e->type!=GPUCAP_UPDATELACE)
+    {
+     if(pos+4>size) break;
+     e->val=Get32(buf+pos);pos+=4;
+    }
+   switch(e->type)
+    {
+     case GPUCAP_WRITEDATA:
+      if(pos+4*(long)e->val>size) {pos=size;continue;}
+      e->data=(uint32_t *)malloc(e->val*4);           // aligned copy, raw le words
+      memcpy(e->data,buf+pos,e->val*4);
+      pos+=e->val*4;
+      break;
+     case GPUCAP_READDATA:
+      if(e->val>sizeof(readBuf)/4) e->val=sizeof(readBuf)/4;
+      break;
+     case GPUCAP_UPDATELACE:
+      nFrames++;
+      break;
+     case GPUCAP_WRITESTATUS:
+     case GPUCAP_READSTATUS:
+     case GPUCAP_VBLANK:
+      break;
+     default:
+      fprintf(stderr,"%s: bad record %02x at %ld\n",name,e->type,pos-1);
+      return 0;
+    }
+   nEvents++;
+  }
+
+ free(buf);
+ return 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// primitive / pixel counting: every primTableJ entry is wrapped
+////////////////////////////////////////////////////////////////////////
+
+static void (*primOrg[256])(unsigned char *);
+static uint64_t       nPrims;
+static uint64_t       nPixels;
+
+static int PX(uint32_t w) {return ((int)(w<<21))>>21;}  // signed 11 bit
+static int PY(uint32_t w) {return ((int)(w<<5))>>21;}
+
+static int64_t TriArea(uint32_t a,uint32_t b,uint32_t c)
+{
+ int64_t s=(int64_t)(PX(b)-PX(a))*(PY(c)-PY(a))-
+           (int64_t)(PX(c)-PX(a))*(PY(b)-PY(a));
+ return (s<0?-s:s)/2;
+}
+
+static int Span(uint32_t a,uint32_t b)                  // prim.c rejects these
+{
+ return abs(PX(a)-PX(b))>1024 || abs(PY(a)-PY(b))>512;
+}
+
+static uint64_t LinePixels(uint32_t a,uint32_t b)
+{
+ int dx=abs(PX(b)-PX(a)),dy=abs(PY(b)-PY(a));
+ if(Span(a,b)) return 0;
+ return (dx>dy?dx:dy)+1;
+}
+
+#define W(i) Get32(b+(i)*4)
+
+static uint64_t PrimPixels(const unsigned char * b)
+{
+ unsigned char cmd=b[3];                               // le word 0, top byte
+ uint64_t n;
+ int i;
+
+ if(cmd>=0x20 && cmd<0x40)                             // polys
+  {
+   int st=1+((cmd&0x04)?1:0)+((cmd&0x10)?1:0);
+   uint32_t v0=W(1),v1=W(1+st),v2=W(1+2*st);
+   if(Span(v0,v1)||Span(v1,v2)||Span(v0,v2)) return 0;
+   n=TriArea(v0,v1,v2);
+   if(cmd&0x08)
+    {
+     uint32_t v3=W(1+3*st);
+     if(Span(v1,v3)||Span(v2,v3)) return 0;
+     n+=TriArea(v1,v2,v3);
+    }
+   return n;
+  }
+ if(cmd>=0x40 && cmd<0x60)                             // lines and polylines
+  {
+   if(!(cmd&0x10))                                     // flat: v0 v1 v2 ...
+    {
+     n=LinePixels(W(1),W(2));
+     if(cmd&0x08)
+      for(i=3;i<256 && (W(i)&0xf000f000)!=0x50005000;i++)
+       n+=LinePixels(W(i-1),W(i));
+    }
+   else                                                // gouraud: v0 c1 v1 c2 v2 ...
+    {
+     n=LinePixels(W(1),W(3));
+     if(cmd&0x08)
+      for(i=4;i<255 && (W(i)&0xf000f000)!=0x50005000;i+=2)
+       n+=LinePixels(W(i-1),W(i+1));
+    }
+   return n;
+  }
+ if(cmd>=0x60 && cmd<0x80)                             // tiles and sprites
+  {
+   static const int iSize[4]={0,1,8,16};
+   uint32_t wh;
+   if(iSize[(cmd>>3)&3]) return iSize[(cmd>>3)&3]*iSize[(cmd>>3)&3];
+   wh=W(2+((cmd&0x04)?1:0));
+   return (uint64_t)(wh&0x3ff)*((wh>>16)&0x1ff);
+  }
+ switch(cmd)
+  {
+   case 0x02:                                          // fill
+    return (uint64_t)(W(2)&0x3ff)*((W(2)>>16)&0x1ff);
+   case 0x80:                                          // vram copy
+    return (uint64_t)(W(3)&0xffff)*(W(3)>>16);
+   case 0xa0:                                          // vram upload
+    return (uint64_t)(W(2)&0xffff)*(W(2)>>16);
+  }
+ return 0;
+}
+
+#undef W
+
+static void CountPrim(unsigned char * baseAddr)
+{
+ nPrims++;
+ nPixels+=PrimPixels(baseAddr);
+ primOrg[baseAddr[3]](baseAddr);
+}
+
+////////////////////////////////////////////////////////////////////////
+// replay
+////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+ uint64_t prims;
+ uint64_t pixels;
+ uint32_t crc;
+} FrameInfo;
+
+static FrameInfo * frames;
+
+static double Now(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ResetState(void)
+{
+ GPUwriteStatus(0x00000000);                           // full reset first
+ GPUfreeze(0,pState);                                  // then like a load state
+ GPUwriteDataMem(env,6);                               // draw environment
+ lGPUstatusRet=(long)ulStatus;
+ dwActFixes=ulFixes;
+}
+
+static double Replay(void)
+{
+ double t=0,t0;
+ int i,f=0;
+ uint64_t p0=nPrims,x0=nPixels;
+
+ ResetState();
+
+ t0=Now();
+ for(i=0;i<nEvents;i++)
+  {
+   CapEvent * e=&events[i];
+   switch(e->type)
+    {
+     case GPUCAP_WRITESTATUS: GPUwriteStatus(e->val);           break;
+     case GPUCAP_WRITEDATA:   GPUwriteDataMem(e->data,e->val);  break;
+     case GPUCAP_READDATA:    GPUreadDataMem(readBuf,e->val);   break;
+     case GPUCAP_VBLANK:      GPUvBlank(e->val);                break;
+     case GPUCAP_READSTATUS:
+      {
+       uint32_t n;
+       for(n=0;n<e->val;n++) GPUreadStatus();
+      }
+      break;
+     case GPUCAP_UPDATELACE:
+      GPUupdateLace();
+      t+=Now()-t0;                                     // hashing is not timed
+      frames[f].prims =nPrims-p0;
+      frames[f].pixels=nPixels-x0;
+      frames[f].crc   =crc32(0,psxVub,1024*iGPUHeight*2);
+      p0=nPrims;x0=nPixels;
+      f++;
+      t0=Now();
+      break;
+    }
+  }
+ t+=Now()-t0;
+ return t;
+}
+
+static int CheckCrcs(const char * name)
+{
+ FILE * f=fopen(name,"r");
+ int i,n,bad=0;
+ unsigned int crc;
+
+ if(!f) {fprintf(stderr,"can't open %s\n",name);return 0;}
+ for(i=0;i<nFrames;i++)
+  {
+   if(fscanf(f,"%d %x",&n,&crc)!=2)
+    {fprintf(stderr,"%s: only %d of %d frames\n",name,i,nFrames);bad=1;break;}
+   if(n!=i || crc!=frames[i].crc)
+    {
+     if(!bad) fprintf(stderr,"first mismatch at frame %d: %08x, expected %08x\n",
+                      i,frames[i].crc,crc);
+     bad++;
+    }
+  }
+ fclose(f);
+ if(bad) fprintf(stderr,"%d frame(s) differ\n",bad);
+ else    printf("all %d frame crcs match\n",nFrames);
+ return !bad;
+}
+
+int main(int argc, char ** argv)
+{
+ const char * pWrite=NULL,* pCheck=NULL,* pName=NULL;
+ int runs=1,verbose=0,i,ok=1;
+ double best=0;
+ uint64_t prims=0,pixels=0;
+
+ for(i=1;i<argc;i++)
+  {
+   if(!strcmp(argv[i],"-r") && i+1<argc)      runs=atoi(argv[++i]);
+   else if(!strcmp(argv[i],"-v"))             verbose=1;
+   else if(!strcmp(argv[i],"-w") && i+1<argc) pWrite=argv[++i];
+   else if(!strcmp(argv[i],"-c") && i+1<argc) pCheck=argv[++i];
+   else if(argv[i][0]!='-')                   pName=argv[i];
+   else pName=NULL,i=argc;
+  }
+ if(!pName || runs<1)
+  {
+   fprintf(stderr,"usage: gpureplay [-r runs] [-v] [-w crcfile] [-c crcfile] capture.gpc\n");
+   return 2;
+  }
+
+ if(!LoadCapture(pName)) return 2;
+
+ iGPUHeight=(int)ulHeight;                             // before init: sizes the vram
+ if(GPUinit()!=0) return 2;
+ GPUopen(NULL,"gpureplay",NULL);
+
+ memcpy(primOrg,primTableJ,sizeof(primOrg));
+ for(i=0;i<256;i++) primTableJ[i]=CountPrim;
+
+ frames=(FrameInfo *)calloc(nFrames+1,sizeof(FrameInfo));
+
+ for(i=0;i<runs;i++)
+  {
+   uint64_t p0=nPrims,x0=nPixels;
+   double t=Replay();
+   if(!i || t<best) best=t;
+   prims=nPrims-p0;pixels=nPixels-x0;
+  }
+
+ if(verbose)
+  for(i=0;i<nFrames;i++)
+   printf("frame %5d  prims %7llu  pixels %10llu  crc %08x\n",i,
+          (unsigned long long)frames[i].prims,
+          (unsigned long long)frames[i].pixels,frames[i].crc);
+
+ printf("%s: %d frames, %d records, vram 1024x%u\n",pName,nFrames,nEvents,ulHeight);
+ printf("  %llu prims, %llu pixels (est.) per run\n",
+        (unsigned long long)prims,(unsigned long long)pixels);
+ printf("  %.3f ms total, %.3f ms/frame, %.1f fps (best of %d)\n",
+        best*1e3,nFrames?best*1e3/nFrames:0,best>0?nFrames/best:0,runs);
+ printf("  %.2f Mprims/s, %.2f Mpixels/s\n",
+        best>0?prims/best/1e6:0,best>0?pixels/best/1e6:0);
+
+ if(pWrite)
+  {
+   FILE * f=fopen(pWrite,"w");
+   if(!f) {fprintf(stderr,"can't write %s\n",pWrite);return 2;}
+   for(i=0;i<nFrames;i++) fprintf(f,"%d %08x\n",i,frames[i].crc);
+   fclose(f);
+  }
+
+ if(pCheck) ok=CheckCrcs(pCheck);
+
+ return ok?0:1;
+}
@@ -0,0 +1,77 @@
+/***************************************************************************
+                        headless.c  -  description
+                             -------------------
+ Display, fps, menu, key and config parts of the soft gpu plugin replaced
+ by no-ops, so gpu.c/prim.c/soft.c/zn.c link on a host without a window.
+ Globals mirror draw_ok.c, fps.c, menu.c, key.c and cfg.c.
+ ***************************************************************************/
+
+#include "externals.h"
+#include "draw.h"
+#include "cfg.h"
+#include "key.h"
+#include "menu.h"
+#include "fps.h"
+
+// draw_ok.c
+
+int            iResX=640;
+int            iResY=480;
+long           lLowerpart;
+BOOL           bIsFirstFrame = TRUE;
+BOOL           bCheckMask = FALSE;
+unsigned short sSetMask = 0;
+unsigned long  lSetMask = 0;
+int            iDesktopCol = 16;
+int            iShowFPS = 0;
+int            iWinSize;
+int            iUseNoStretchBlt = 0;
+int            iFastFwd = 0;
+PSXPoint_t     ptCursorPoint[8];
+unsigned short usCursorActive = 0;
+char *         pCaptionText;
+
+int            iBufferSwaps = 0;                        // read by the replayer
+
+void DoBufferSwap(void)          { iBufferSwaps++; }
+void DoClearScreenBuffer(void)   {}
+void DoClearFrontBuffer(void)    {}
+unsigned long ulInitDisplay(void){ bIsFirstFrame=FALSE; return 1; }
+void CloseDisplay(void)          {}
+void CreatePic(unsigned char * pMem) {}
+void DestroyPic(void)            {}
+
+// fps.c: no pacing and no skipping, every frame is rendered
+
+float          fFrameRateHz=0;
+float          fFrameRate;
+int            iFrameLimit;
+int            UseFrameLimit=0;
+int            UseFrameSkip=0;
+int            s_adaptive_skip_enabled=0;
+BOOL           bInitCap = TRUE;
+float          fps_skip = 0;
+float          fps_cur  = 0;
+
+void FrameSkip(void)             {}
+void PCFrameCap(void)            {}
+void PCcalcfps(void)             {}
+void SetAutoFrameCap(void)       {}
+void SetFPSHandler(void)         {}
+void InitFPS(void)               {}
+void CheckFrameRate(void)        {}
+void AutoFrameSkip(void)         {}
+unsigned long  ulAutoSkipped=0;
+
+// menu.c, key.c, cfg.c
+
+uint32_t       dwCoreFlags = 0;
+unsigned long  ulKeybits = 0;
+char *         pConfigFile = NULL;
+
+void BuildDispMenu(int iInc)     {}
+void ReleaseKeyHandler(void)     {}
+void CALLBACK GPUkeypressed(int keycode) {}
+void ReadConfig(void)            {}
+void SoftDlgProc(void)           {}
+void AboutDlgProc(void)          {}
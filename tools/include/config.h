@@ -0,0 +1,14 @@
+/***************************************************************************
+                          config.h  -  description
+                             -------------------
+ Host build configuration for the tools in this directory. The 360 build
+ uses 360/common/config.h, which only works with the XDK headers.
+ ***************************************************************************/
+
+#ifndef _TOOLS_CONFIG_H_
+#define _TOOLS_CONFIG_H_
+
+#define MAXPATHLEN 4096
+#define PACKAGE_VERSION "Pcsx-r"
+
+#endif // _TOOLS_CONFIG_H_
@@ -0,0 +1,57 @@
+/***************************************************************************
+                        headless.c  -  description
+                             -------------------
+ Sound output and config parts of the dfsound plugin replaced by a pcm
+ collector, so spu.c/registers.c/dma.c/freeze.c link on a host without
+ an audio device. Settings mirror cfg.c, except the mixer is driven by
+ SPUasync (timer mode 2) instead of its own thread.
+ ***************************************************************************/
+
+#include "stdafx.h"
+
+#define _IN_OSS
+
+#include "externals.h"
+#include "cfg.h"
+
+// cfg.c
+
+BOOL           tombraider2fix = 0;
+
+void ReadConfig(void)
+{
+ iVolume=2;
+ iXAPitch=0;
+ iSPUIRQWait=0;                                        // nobody to wait for
+ iUseTimer=2;
+ iUseReverb=1;
+ iUseInterpolation=2;
+ iXAResample=2;
+ iDisStereo=0;
+ iFreqResponse=0;
+}
+
+void StartCfgTool(char * pCmdLine) {}
+
+// xaudio_2.cpp: everything fed is appended to pPCMOut, read by spubench.c
+
+short *        pPCMOut=NULL;
+long           lPCMOut=0;                              // in shorts
+static long    lPCMSize=0;
+
+void SetupSound(void)            { lPCMOut=0; }
+void RemoveSound(void)           {}
+unsigned long SoundGetBytesBuffered(void) { return 0; }
+
+void SoundFeedStreamData(unsigned char * pSound,long lBytes)
+{
+ long n=lBytes/2;
+
+ if(lPCMOut+n>lPCMSize)
+  {
+   lPCMSize=(lPCMOut+n)*2+65536;
+   pPCMOut=(short *)realloc(pPCMOut,lPCMSize*sizeof(short));
+  }
+ memcpy(pPCMOut+lPCMOut,pSound,n*sizeof(short));
+ lPCMOut+=n;
+}
@@ -0,0 +1,550 @@
+/***************************************************************************
+                        spubench.c  -  description
+                             -------------------
+ Offline render of an SPU capture (plugins/dfsound/spucap.c)
+
+ The capture is loaded up front, then every record is handed to the real
+ dfsound plugin (spu.c, registers.c, dma.c) with the sound output replaced
+ by a pcm collector (headless.c). Prints the mixing speed and can store
+ the rendered pcm, or compare it with a stored one to check mixer changes
+ against the previous output. The cost per voice sample (one sample of
+ one playing voice) is the number to watch for changes to the per voice
+ work, it doesn't depend on how busy the capture is.
+
+ Version 2 captures are replayed with the emu timing: the recorded
+ SPUasync ticks drive the mixer and the register reads are redone and
+ compared with the values the emu got (envelope, status and transfer
+ reads, a difference there means the mixer ran out of step). Version 1
+ captures, or -s, apply every record at its output sample instead, the
+ mixer driven block by block.
+
+ usage: spubench [-r runs] [-v] [-s] [-t] [-w pcmfile] [-o wavfile]
+                 [-c pcmfile] capture.spc
+
+   -r n   render the capture n times, timing is the best run
+   -v     print one line per run
+   -s     replay by output sample stamps, even with SPUasync records
+   -t     timing report: time every mixer block and record of the runs,
+          prints the block time spread and the slowest block of the best
+   -w f   write the rendered pcm to f (raw 16 bit le stereo, 44.1 kHz)
+   -o f   write the rendered pcm to f as a wav file
+   -c f   compare the rendered pcm with f, exit code 1 on mismatch
+
+ Only the first run is written/compared: SPUinit doesn't reset all of
+ the mixer statics (xa and reverb history), so later runs are close but
+ not bit exact. -t adds two clock reads per block, compare speeds with
+ the same setting.
+
+ Voices already playing when the capture was started are not part of the
+ file, they only come back with their next key on.
+ ***************************************************************************/
+
+#include "stdafx.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#include "externals.h"
+#include "registers.h"
+#include "spucap.h"
+#include "voiceblk.h"
+
+// plugin entry points (linux names, see spu.c)
+
+long           SPUinit(void);
+long           SPUopen(void);
+long           SPUshutdown(void);
+void           SPUasync(unsigned long cycle);
+void           SPUwriteRegister(unsigned long reg, unsigned short val);
+unsigned short SPUreadRegister(unsigned long reg);
+void           SPUwriteDMA(unsigned short val);
+void           SPUwriteDMAMem(unsigned short * pusPSXMem,int iSize);
+unsigned short SPUreadDMA(void);
+void           SPUreadDMAMem(unsigned short * pusPSXMem,int iSize);
+void           SPUplayADPCMchannel(xa_decode_t *xap);
+void           SPUplayCDDAchannel(short *pcm, int nbytes);
+
+// headless.c
+
+extern short * pPCMOut;
+extern long    lPCMOut;
+
+extern long    cpu_cycles;                             // spu.c
+
+#define BLOCKCYCLES (CPU_CLOCK/44100*NSSIZE)           // one mixer block
+
+////////////////////////////////////////////////////////////////////////
+// decoded capture
+////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+ unsigned char type;
+ uint32_t      stamp;                                  // output sample
+ uint32_t      reg;                                    // WRITEREG/READREG only
+ uint32_t      val;                                    // value, count or cycles
+ void *        data;                                   // dma, xa and cdda payloads
+} CapEvent;
+
+static unsigned short regs[256];
+static unsigned char  ram[512*1024];
+
+static CapEvent *     events;
+static int            nEvents;
+static uint32_t       dwEndStamp;
+static uint32_t       dwEndCycle;
+static int            iVersion;
+static int            nTicks;                          // SPUCAP_ASYNC records
+
+static unsigned short readBuf[256*1024];              // sink for dma reads
+
+static uint32_t Get16(const unsigned char * p)
+{
+ return p[0]|(p[1]<<8);
+}
+
+static uint32_t Get32(const unsigned char * p)
+{
+ return p[0]|(p[1]<<8)|(p[2]<<16)|((uint32_t)p[3]<<24);
+}
+
+static int LoadCapture(const char * name)
+{
+ FILE * f;
+ long size,pos;
+ unsigned char * buf;
+ int i,maxEvents,hdr;
+
+ f=fopen(name,"rb");
+ if(!f) {fprintf(stderr,"can't open %s\n",name);return 0;}
+ fseek(f,0,SEEK_END);size=ftell(f);fseek(f,0,SEEK_SET);
+ buf=(unsigned char *)malloc(size);
+ if(!buf || fread(buf,1,size,f)!=(size_t)size) {fclose(f);return 0;}
+ fclose(f);
+
+ if(size<8+4+256*2+512*1024 || memcmp(buf,SPUCAP_MAGIC,8))
+  {fprintf(stderr,"%s: not a spu capture\n",name);return 0;}
+ iVersion=(int)Get32(buf+8);
+ if(iVersion<1 || iVersion>SPUCAP_VERSION)
+  {fprintf(stderr,"%s: unsupported version %d\n",name,iVersion);return 0;}
+ hdr=iVersion>=2?9:5;                                  // type, stamp (, cycle)
+
+ pos=12;
+ for(i=0;i<256;i++,pos+=2) regs[i]=(unsigned short)Get16(buf+pos);
+ memcpy(ram,buf+pos,512*1024);
+ pos+=512*1024;
+
+ // records: every one is at least hdr bytes, so this is an upper bound
+ maxEvents=(int)((size-pos)/hdr)+1;
+ events=(CapEvent *)malloc(maxEvents*sizeof(CapEvent));
+
+ while(pos+hdr<=size)
+  {
+   CapEvent * e=&events[nEvents];
+   e->type=buf[pos];
+   e->stamp=Get32(buf+pos+1);
+   e->reg=e->val=0;e->data=NULL;
+   if(hdr>5) dwEndCycle=Get32(buf+pos+5);
+   pos+=hdr;
+   dwEndStamp=e->stamp;
+   if(e->type==SPUCAP_END) break;
+   switch(e->type)
+    {
+     case SPUCAP_WRITEREG:
+     case SPUCAP_READREG:
+      if(pos+6>size) {pos=size;continue;}
+      e->reg=Get32(buf+pos);e->val=Get16(buf+pos+4);
+      pos+=6;
+      break;
+     case SPUCAP_ASYNC:
+      if(pos+4>size) {pos=size;continue;}
+      e->val=Get32(buf+pos);
+      pos+=4;
+      nTicks++;
+      break;
+     case SPUCAP_WRITEDMA:
+      if(pos+2>size) {pos=size;continue;}
+      e->val=Get16(buf+pos);
+      pos+=2;
+      break;
+     case SPUCAP_WRITEDMAMEM:
+      if(pos+4>size) {pos=size;continue;}
+      e->val=Get32(buf+pos);pos+=4;
+      if(pos+2*(long)e->val>size) {pos=size;continue;}
+      e->data=malloc(e->val*2);                        // aligned copy, raw le halfwords
+      memcpy(e->data,buf+pos,e->val*2);
+      pos+=e->val*2;
+      break;
+     case SPUCAP_READDMA:
+      break;
+     case SPUCAP_READDMAMEM:
+      if(pos+4>size) {pos=size;continue;}
+      e->val=Get32(buf+pos);pos+=4;
+      if(e->val>sizeof(readBuf)/2) e->val=sizeof(readBuf)/2;
+      break;
+     case SPUCAP_XA:
+      {
+       xa_decode_t * xap;
+       int n;
+       if(pos+16>size) {pos=size;continue;}
+       xap=(xa_decode_t *)calloc(1,sizeof(xa_decode_t));
+       xap->freq    =(int)Get32(buf+pos);
+       xap->nbits   =(int)Get32(buf+pos+4);
+       xap->stereo  =(int)Get32(buf+pos+8);
+       xap->nsamples=(int)Get32(buf+pos+12);
+       pos+=16;
+       n=xap->nsamples*(xap->stereo?2:1);
+       if(n<0 || n>16384 || pos+2*(long)n>size) {free(xap);pos=size;continue;}
+       for(i=0;i<n;i++,pos+=2) xap->pcm[i]=(short)Get16(buf+pos);
+       e->data=xap;
+      }
+      break;
+     case SPUCAP_CDDA:
+      if(pos+4>size) {pos=size;continue;}
+      e->val=Get32(buf+pos);pos+=4;
+      if(pos+(long)e->val>size) {pos=size;continue;}
+      e->data=malloc(e->val+4);
+      memcpy(e->data,buf+pos,e->val);
+      pos+=e->val;
+      break;
+     default:
+      fprintf(stderr,"%s: bad record %02x at %ld\n",name,e->type,pos-hdr);
+      return 0;
+    }
+   nEvents++;
+  }
+
+ free(buf);
+ return 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// render
+////////////////////////////////////////////////////////////////////////
+
+static double Now(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ResetState(void)
+{
+ int i;
+
+ SPUinit();
+ SPUopen();
+ cpu_cycles=0;
+ iCycle=0;
+
+ // like a state of unknown format (freeze.c): ram and port as stored,
+ // voice registers rewritten, then the globals without key on/off,
+ // the status bits and the transfer fifo
+ memcpy(spuMem,ram,512*1024);
+ memcpy(regArea,regs,sizeof(regs));
+
+ for(i=0;i<0xc0;i++)
+  SPUwriteRegister(0x1f801c00+i*2,regs[i]);
+ for(i=0xc0;i<0x100;i++)
+  {
+   int r=0xc00+i*2;
+   if(r>=H_SPUon1 && r<=H_SPUoff2) continue;
+   if(r==H_SPUMute1 || r==H_SPUMute2 || r==H_SPUdata) continue;
+   SPUwriteRegister(0x1f801000+r,regs[i]);
+  }
+}
+
+static uint32_t dwBlocks;
+
+////////////////////////////////////////////////////////////////////////
+// timing (-t): every block and record of a run, the tmBest run is kept
+////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+ float *       block;                                  // us per mixer block
+ uint32_t      n,size;
+ double        records;                                // s in record handlers
+ double        recordMax;
+ unsigned char recordMaxType;
+ uint32_t      recordMaxAt;                            // output sample
+} Timing;
+
+static int            iTiming;
+static Timing         tmCur,tmBest;
+
+static int            nReads,nReadDiff;                // READREG replay
+static uint32_t       dwReadDiffAt;
+
+static void TimeBlocks(double t,int n)
+{
+ int i;
+
+ if(tmCur.n+n>tmCur.size)
+  {
+   tmCur.size=(tmCur.n+n)*2+1024;
+   tmCur.block=(float *)realloc(tmCur.block,tmCur.size*sizeof(float));
+  }
+ for(i=0;i<n;i++) tmCur.block[tmCur.n++]=(float)(t*1e6/n); // a tick that mixed several blocks: even share
+}
+
+static void Async(unsigned long cycles)
+{
+ uint32_t before=dwMixedSamples;
+ double t0;
+
+ if(!iTiming) {SPUasync(cycles);return;}
+
+ t0=Now();
+ SPUasync(cycles);
+ t0=Now()-t0;
+ if(dwMixedSamples!=before) TimeBlocks(t0,(dwMixedSamples-before)/NSSIZE);
+}
+
+static void MixUntil(uint32_t stamp)
+{
+ while(dwMixedSamples<stamp)
+  {
+   Async(BLOCKCYCLES);
+   dwBlocks++;
+  }
+}
+
+static void Apply(const CapEvent * e)
+{
+ switch(e->type)
+  {
+   case SPUCAP_WRITEREG:    SPUwriteRegister(e->reg,(unsigned short)e->val);          break;
+   case SPUCAP_WRITEDMA:    SPUwriteDMA((unsigned short)e->val);                      break;
+   case SPUCAP_WRITEDMAMEM: SPUwriteDMAMem((unsigned short *)e->data,(int)e->val);    break;
+   case SPUCAP_READDMA:     SPUreadDMA();                                             break;
+   case SPUCAP_READDMAMEM:  SPUreadDMAMem(readBuf,(int)e->val);                       break;
+   case SPUCAP_XA:          SPUplayADPCMchannel((xa_decode_t *)e->data);              break;
+   case SPUCAP_CDDA:        SPUplayCDDAchannel((short *)e->data,(int)e->val);         break;
+   case SPUCAP_READREG:
+    nReads++;
+    if(SPUreadRegister(e->reg)!=e->val)
+     {
+      if(!nReadDiff) dwReadDiffAt=dwMixedSamples;
+      nReadDiff++;
+     }
+    break;
+  }
+}
+
+static void ApplyTimed(const CapEvent * e)
+{
+ double t0=Now();
+
+ Apply(e);
+ t0=Now()-t0;
+ tmCur.records+=t0;
+ if(t0>tmCur.recordMax)
+  {
+   tmCur.recordMax=t0;
+   tmCur.recordMaxType=e->type;
+   tmCur.recordMaxAt=dwMixedSamples;
+  }
+}
+
+// bTicks: mixer driven by the recorded SPUasync calls, else block by
+// block up to the sample stamp of every record
+static double Render(int bTicks)
+{
+ double t0;
+ int i;
+
+ ResetState();
+ dwMixedSamples=0;
+ dwVoiceSamples=0;
+ dwBlocks=0;
+ nReads=nReadDiff=0;
+ tmCur.n=0;tmCur.records=tmCur.recordMax=0;
+
+ t0=Now();
+ for(i=0;i<nEvents;i++)
+  {
+   CapEvent * e=&events[i];
+
+   if(e->type==SPUCAP_ASYNC)
+    {
+     if(bTicks) Async(e->val);
+     continue;
+    }
+
+   if(!bTicks) MixUntil(e->stamp);
+
+   if(iTiming) ApplyTimed(e);
+   else        Apply(e);
+  }
+ if(!bTicks) MixUntil(dwEndStamp);
+ t0=Now()-t0;
+
+ if(bTicks) dwBlocks=dwMixedSamples/NSSIZE;
+
+ SPUshutdown();
+ return t0;
+}
+
+static int CmpFloat(const void * a,const void * b)
+{
+ const float x=*(const float *)a,y=*(const float *)b;
+ return x<y?-1:x>y;
+}
+
+static void TimingReport(void)
+{
+ const double budget=NSSIZE*1e6/44100.0;                // us of audio per block
+ float * s;
+ uint32_t i,worst=0;
+
+ if(!tmBest.n) return;
+
+ for(i=1;i<tmBest.n;i++) if(tmBest.block[i]>tmBest.block[worst]) worst=i;
+
+ s=(float *)malloc(tmBest.n*sizeof(float));
+ memcpy(s,tmBest.block,tmBest.n*sizeof(float));
+ qsort(s,tmBest.n,sizeof(float),CmpFloat);
+
+ printf("block: min %.1f, median %.1f, p99 %.1f, max %.1f us (%.0f%% of %.0f us realtime) at %.2f s\n",
+        s[0],s[tmBest.n/2],s[(uint32_t)(tmBest.n*0.99)],s[tmBest.n-1],
+        s[tmBest.n-1]*100.0/budget,budget,(double)worst*NSSIZE/44100.0);
+ printf("records: %.3f ms, slowest %.1f us (type %02x) at %.2f s\n",
+        tmBest.records*1000.0,tmBest.recordMax*1e6,tmBest.recordMaxType,tmBest.recordMaxAt/44100.0);
+ free(s);
+}
+
+static short *       pPCM;                             // first run output
+static long          lPCM;
+
+static int CheckPCM(const char * name)
+{
+ FILE * f=fopen(name,"rb");
+ long size,n,i,first=-1,bad=0;
+ int maxd=0;
+ short * ref;
+
+ if(!f) {fprintf(stderr,"can't open %s\n",name);return 0;}
+ fseek(f,0,SEEK_END);size=ftell(f)/2;fseek(f,0,SEEK_SET);
+ ref=(short *)malloc(size*sizeof(short)+1);
+ if(fread(ref,2,size,f)!=(size_t)size) size=0;
+ fclose(f);
+
+ n=size<lPCM?size:lPCM;
+ for(i=0;i<n;i++)
+  {
+   int d=abs(ref[i]-pPCM[i]);
+   if(!d) continue;
+   if(first<0) first=i;
+   if(d>maxd) maxd=d;
+   bad++;
+  }
+ free(ref);
+
+ if(size!=lPCM)
+  fprintf(stderr,"length differs: %ld samples, expected %ld\n",lPCM/2,size/2);
+ if(bad)
+  fprintf(stderr,"first mismatch at sample %ld (%s), %ld value(s) differ, max %d\n",
+          first/2,(first&1)?"right":"left",bad,maxd);
+ if(!bad && size==lPCM) printf("all %ld samples match\n",n/2);
+ return !bad && size==lPCM;
+}
+
+static void Put32(unsigned char * p,uint32_t l)
+{
+ p[0]=(unsigned char)l;p[1]=(unsigned char)(l>>8);
+ p[2]=(unsigned char)(l>>16);p[3]=(unsigned char)(l>>24);
+}
+
+static int WriteWAV(const char * name)
+{
+ unsigned char h[44];
+ const uint32_t bytes=(uint32_t)lPCM*2;
+ FILE * f=fopen(name,"wb");
+
+ if(!f) return 0;
+
+ memcpy(h,"RIFF",4);     Put32(h+4,36+bytes);
+ memcpy(h+8,"WAVEfmt ",8);Put32(h+16,16);
+ Put32(h+20,1|(2<<16));                                // pcm, stereo
+ Put32(h+24,44100);      Put32(h+28,44100*4);
+ Put32(h+32,4|(16<<16));                               // block align, bits
+ memcpy(h+36,"data",4);  Put32(h+40,bytes);
+ fwrite(h,1,44,f);
+ fwrite(pPCM,2,lPCM,f);                                // le host, like -w
+ fclose(f);
+ return 1;
+}
+
+int main(int argc, char ** argv)
+{
+ const char * pWrite=NULL,* pWav=NULL,* pCheck=NULL,* pName=NULL;
+ int runs=1,verbose=0,samples=0,bTicks,i,ok=1;
+ double best=0,secs;
+
+ for(i=1;i<argc;i++)
+  {
+   if(!strcmp(argv[i],"-r") && i+1<argc)      runs=atoi(argv[++i]);
+   else if(!strcmp(argv[i],"-v"))             verbose=1;
+   else if(!strcmp(argv[i],"-s"))             samples=1;
+   else if(!strcmp(argv[i],"-t"))             iTiming=1;
+   else if(!strcmp(argv[i],"-w") && i+1<argc) pWrite=argv[++i];
+   else if(!strcmp(argv[i],"-o") && i+1<argc) pWav=argv[++i];
+   else if(!strcmp(argv[i],"-c") && i+1<argc) pCheck=argv[++i];
+   else if(argv[i][0]!='-')                   pName=argv[i];
+   else pName=NULL,i=argc;
+  }
+ if(!pName || runs<1)
+  {
+   fprintf(stderr,"usage: spubench [-r runs] [-v] [-s] [-t] [-w pcmfile] [-o wavfile] [-c pcmfile] capture.spc\n");
+   return 2;
+  }
+
+ if(!LoadCapture(pName)) return 2;
+
+ bTicks=nTicks && !samples;
+
+ for(i=0;i<runs;i++)
+  {
+   double t=Render(bTicks);
+   if(verbose) printf("run %d: %.3f ms\n",i+1,t*1000.0);
+   if(!i)
+    {
+     lPCM=lPCMOut;
+     pPCM=(short *)malloc(lPCM*sizeof(short)+1);
+     memcpy(pPCM,pPCMOut,lPCM*sizeof(short));
+     if(nReadDiff)
+      printf("%d of %d register reads differ, first at %.2f s\n",
+             nReadDiff,nReads,dwReadDiffAt/44100.0);
+    }
+   if(!i || t<best)
+    {
+     Timing tm=tmBest;tmBest=tmCur;tmCur=tm;           // keep the arrays of the best run
+     best=t;
+    }
+  }
+
+ secs=(double)dwMixedSamples/44100.0;
+ printf("version %d capture, %d records, %u blocks, %.2f s of audio, replay by %s\n",
+        iVersion,nEvents,dwBlocks,secs,bTicks?"SPUasync ticks":"sample stamps");
+ if(bTicks)
+  printf("%u psx cycles in %d ticks\n",dwEndCycle,nTicks);
+ printf("best of %d: %.3f ms, %.1f us/block, %.1fx realtime\n",
+        runs,best*1000.0,best*1e6/(dwBlocks?dwBlocks:1),best>0?secs/best:0.0);
+ printf("%u voice samples, %.1f ns each (%s kernels)\n",
+        dwVoiceSamples,best*1e9/(dwVoiceSamples?dwVoiceSamples:1),VoiceKernelName());
+ if(iTiming) TimingReport();
+
+ if(pWrite)
+  {
+   FILE * f=fopen(pWrite,"wb");
+   if(!f) {fprintf(stderr,"can't write %s\n",pWrite);return 2;}
+   fwrite(pPCM,2,lPCM,f);
+   fclose(f);
+  }
+ if(pWav && !WriteWAV(pWav)) {fprintf(stderr,"can't write %s\n",pWav);return 2;}
+ if(pCheck) ok=CheckPCM(pCheck);
+
+ return ok?0:1;
+}
@@ -0,0 +1,166 @@
+/***************************************************************************
+                         xabench.c  -  description
+                             -------------------
+ Host test and benchmark for the CD-XA decoder (libpcsxcore/decode_xa.c)
+
+ Decodes XA audio sectors with the fused kernel (in place nibble
+ expansion, interleave and cd attenuation in one pass) and with the
+ scalar reference (gathered blocks, strided writes, separate attenuation
+ pass), checks that pcm and filter history are the same for every sector
+ and prints the throughput.
+
+ Without a file the sectors are random, every coding (mono/stereo, 4 bit
+ at 37800/18900 Hz, 8 bit) is run with a few attenuation settings. With
+ a raw disc image (2352 byte sectors) its audio sectors are decoded as
+ one stream each per coding found, as the cdrom would play them.
+
+ usage: xabench [passes] [image.bin]
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "decode_xa.h"
+#include "adpcm.h"
+
+#define SECTOR_RAW    2352
+#define SUBHEADER     16                               // raw offset of the xa subheader
+#define XA_BYTES      (8 + 18 * 128)
+#define RANDOM_COUNT  256
+
+typedef s32 (*xadec_t)(xa_decode_t *, unsigned char *, int, const xa_atten_t *);
+
+static unsigned char * sectors;                        // XA_BYTES each, subheader first
+static int count;
+
+static const xa_atten_t atts[] =
+{
+ { 0x80, 0x00, 0x00, 0x80 },                           // unity (no pass)
+ { 0x40, 0x40, 0x40, 0x40 },                           // mono mix
+ { 0x60, 0x10, 0x20, 0x70 },
+ { 0xff, 0x80, 0xff, 0x90 },                           // saturating
+ { 0x00, 0x00, 0x00, 0x00 }                            // muted
+};
+#define ATTS (int)(sizeof(atts) / sizeof(atts[0]))
+
+static double Now(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// n sectors from first as one stream, pcm compared after every sector
+// when ref is given
+static int Stream(xadec_t f, xa_decode_t * xa, xadec_t fref, xa_decode_t * xref,
+                  int first, int n, const xa_atten_t * att)
+{
+ int i, a, b;
+
+ for(i = 0; i < n; i++)
+  {
+   unsigned char * p = sectors + (first + i) * XA_BYTES;
+   a = f(xa, p, i == 0, att);
+   if(!fref) continue;
+   b = fref(xref, p, i == 0, att);
+   if(a != b || memcmp(xa->pcm, xref->pcm, sizeof(xa->pcm)) ||
+      xa->left.y0 != xref->left.y0 || xa->left.y1 != xref->left.y1 ||
+      xa->right.y0 != xref->right.y0 || xa->right.y1 != xref->right.y1)
+    {
+     printf("  MISMATCH sector %d coding %02x att %02x %02x %02x %02x\n", first + i, p[3],
+            att ? att->ll : 0, att ? att->lr : 0, att ? att->rl : 0, att ? att->rr : 0);
+     return 1;
+    }
+  }
+ return 0;
+}
+
+static void RandomSectors(void)
+{
+ static const unsigned char codings[6] = { 0x00, 0x01, 0x04, 0x05, 0x10, 0x11 };
+ int i, j;
+
+ count = RANDOM_COUNT * 6;
+ sectors = malloc(count * XA_BYTES);
+ srand(4321);
+ for(i = 0; i < count * XA_BYTES; i++) sectors[i] = (unsigned char)rand();
+ for(i = 0; i < count; i++)
+  {
+   unsigned char * p = sectors + i * XA_BYTES;
+   p[2] = 0x64;                                        // real time, form 2, audio
+   p[3] = codings[i / RANDOM_COUNT];
+   for(j = 0; j < 18; j++) p[8 + j * 128] &= 0x3f;     // filters 0..3 in the first header
+  }
+}
+
+// audio sectors of a raw image, grouped by coding so every run is a stream
+static int ImageSectors(const char * name)
+{
+ FILE * f = fopen(name, "rb");
+ unsigned char raw[SECTOR_RAW];
+ int cap = 0, pass, c;
+
+ if(!f) { perror(name); return -1; }
+
+ for(pass = 0; pass < 2; pass++)                       // count, then copy
+  {
+   int n = 0;
+   if(pass) sectors = malloc((cap ? cap : 1) * XA_BYTES);
+   for(c = 0; c < 0x40; c++)
+    {
+     fseek(f, 0, SEEK_SET);
+     while(fread(raw, 1, SECTOR_RAW, f) == SECTOR_RAW)
+      {
+       unsigned char * sub = raw + SUBHEADER;
+       if(!(sub[2] & 0x04) || (sub[3] & 0x3f) != c) continue;
+       if(pass) memcpy(sectors + n * XA_BYTES, sub, XA_BYTES);
+       n++;
+      }
+    }
+   cap = count = n;
+  }
+
+ fclose(f);
+ return count;
+}
+
+int main(int argc, char * argv[])
+{
+ int passes = argc > 1 ? atoi(argv[1]) : 20;
+ static xa_decode_t xa, xref;
+ double t0, tFused, tRef;
+ int i, a, start, fail = 0;
+
+ if(passes <= 0) passes = 20;
+
+ if(argc > 2) { if(ImageSectors(argv[2]) <= 0) { printf("xabench: no xa audio in %s\n", argv[2]); return 1; } }
+ else RandomSectors();
+
+ printf("xabench: %d sectors, %d iterations, kernel: %s / %s\n",
+        count, passes, xa_kernel_name(), ADPCM_KernelName());
+
+ // streams of one coding each (a new stream restarts at a coding change)
+ for(a = -1; a < ATTS && !fail; a++)
+  {
+   const xa_atten_t * att = a < 0 ? NULL : &atts[a];
+   memset(&xa, 0, sizeof(xa));
+   memset(&xref, 0, sizeof(xref));
+   for(start = 0; start < count && !fail; start = i)
+    {
+     for(i = start; i < count && sectors[i * XA_BYTES + 3] == sectors[start * XA_BYTES + 3]; i++);
+     fail = Stream(xa_decode_sector_att, &xa, xa_decode_sector_C, &xref, start, i - start, att);
+    }
+  }
+ if(!fail) printf("  fused == reference over %d attenuation settings\n", ATTS + 1);
+
+ t0 = Now(); for(i = 0; i < passes; i++) Stream(xa_decode_sector_att, &xa, NULL, NULL, 0, count, &atts[2]); tFused = Now() - t0;
+ t0 = Now(); for(i = 0; i < passes; i++) Stream(xa_decode_sector_C, &xa, NULL, NULL, 0, count, &atts[2]);   tRef = Now() - t0;
+ printf("  %-14s %8.3f us/sector\n", "fused", tFused * 1e6 / passes / count);
+ printf("  %-14s %8.3f us/sector\n", "reference", tRef * 1e6 / passes / count);
+ printf("  speedup        %8.2fx\n", tRef / tFused);
+
+ free(sectors);
+ return fail;
+}